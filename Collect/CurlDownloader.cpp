@@ -17,6 +17,10 @@
  */
 
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <unistd.h>
 #include <string.h>
 #include <strings.h>
 #include <stdarg.h>
@@ -24,20 +28,39 @@
 #include <regex.h>
 #endif
 #include <stdlib.h>
+#include <pthread.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <curl/curl.h>
 
+#include "Memory.h"
 #include "StringManip.h"
 #include "Url.h"
 #include "CurlDownloader.h"
 
 using namespace std;
 
+#define CONTENT_CHUNK_SIZE 65536
+#define CONTENT_MAX_PREALLOCATED_SIZE 8388608
+#define MAX_CACHED_HANDLES 16
+#define MAX_REDIRECTIONS 10
+
 struct ContentInfo
 {
+	ContentInfo() :
+		m_pHandler(NULL),
+		m_pContent(NULL),
+		m_contentSize(0),
+		m_contentLen(0)
+	{
+	}
+
+	void *m_pHandler;
 	char *m_pContent;
+	size_t m_contentSize;
+	vector<string> m_chunks;
 	size_t m_contentLen;
 	string m_lastModified;
 	map<string, string> m_headers;
@@ -53,10 +76,66 @@ static void freeContentInfo(struct ContentInfo *pInfo)
 
 	if (pInfo->m_pContent != NULL)
 	{
-		free(pInfo->m_pContent);
+		Memory::freeBuffer(pInfo->m_pContent, (off_t)pInfo->m_contentSize + 1);
 		pInfo->m_pContent = NULL;
-		pInfo->m_contentLen = 0;
 	}
+	pInfo->m_contentSize = 0;
+	pInfo->m_chunks.clear();
+	pInfo->m_contentLen = 0;
+	pInfo->m_lastModified.clear();
+	pInfo->m_headers.clear();
+}
+
+static char *assembleContent(struct ContentInfo *pInfo)
+{
+	if ((pInfo == NULL) ||
+		(pInfo->m_contentLen == 0))
+	{
+		return NULL;
+	}
+
+	// Was everything written to a buffer of the announced size ?
+	if ((pInfo->m_pContent != NULL) &&
+		(pInfo->m_contentLen == pInfo->m_contentSize))
+	{
+		char *pContent = pInfo->m_pContent;
+
+		pContent[pInfo->m_contentLen] = '\0';
+		pInfo->m_pContent = NULL;
+		pInfo->m_contentSize = 0;
+
+		return pContent;
+	}
+
+	// This is the only copy made of the content
+	char *pContent = Memory::allocateBuffer((off_t)pInfo->m_contentLen + 1);
+	if (pContent != NULL)
+	{
+		size_t offset = 0;
+
+		if (pInfo->m_pContent != NULL)
+		{
+			// The transfer was cut short
+			memcpy(pContent, pInfo->m_pContent, pInfo->m_contentLen);
+			offset = pInfo->m_contentLen;
+		}
+		for (vector<string>::const_iterator chunkIter = pInfo->m_chunks.begin();
+			chunkIter != pInfo->m_chunks.end(); ++chunkIter)
+		{
+			memcpy(pContent + offset, chunkIter->c_str(), chunkIter->length());
+			offset += chunkIter->length();
+		}
+		pContent[offset] = '\0';
+	}
+	pInfo->m_chunks.clear();
+	if (pInfo->m_pContent != NULL)
+	{
+		Memory::freeBuffer(pInfo->m_pContent, (off_t)pInfo->m_contentSize + 1);
+		pInfo->m_pContent = NULL;
+		pInfo->m_contentSize = 0;
+	}
+
+	return pContent;
 }
 
 static size_t writeCallback(void *pData, size_t dataSize, size_t elementsCount, void *pStream)
@@ -70,35 +149,54 @@ static size_t writeCallback(void *pData, size_t dataSize, size_t elementsCount,
 	}
 	pInfo = (ContentInfo *)pStream;
 
-	char *pNewContent = (char*)realloc(pInfo->m_pContent, pInfo->m_contentLen + totalSize + 1);
-	if (pNewContent == NULL)
+	// If the length is announced, write straight to a buffer that can be handed over as is
+	// Servers may announce anything, larger contents go to chunks as they come
+	if ((pInfo->m_contentLen == 0) &&
+		(pInfo->m_pContent == NULL) &&
+		(pInfo->m_pHandler != NULL))
 	{
-#ifdef DEBUG
-		clog << "writeCallback: failed to enlarge buffer" << endl;
-#endif
-		freeContentInfo(pInfo);
-		return 0;
-	}
+		double contentLength = -1;
 
-	pInfo->m_pContent = pNewContent;
-	memcpy(pInfo->m_pContent + pInfo->m_contentLen, pData, totalSize);
-	pInfo->m_contentLen += totalSize;
-	pInfo->m_pContent[pInfo->m_contentLen] = '\0';
-
-	if (totalSize < strlen((const char*)pData))
+		if ((curl_easy_getinfo((CURL *)pInfo->m_pHandler, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+			&contentLength) == CURLE_OK) &&
+			(contentLength > 0) &&
+			(contentLength <= CONTENT_MAX_PREALLOCATED_SIZE))
+		{
+			pInfo->m_contentSize = (size_t)contentLength;
+			pInfo->m_pContent = Memory::allocateBuffer((off_t)pInfo->m_contentSize + 1);
+			if (pInfo->m_pContent == NULL)
+			{
+				pInfo->m_contentSize = 0;
+			}
+		}
+	}
+	if (pInfo->m_pContent != NULL)
 	{
-		void *pBadChar = NULL;
-
-		// There's a NULL character in the buffer ? Replace it
-		while ((pBadChar = memchr((void*)pInfo->m_pContent, '\0', pInfo->m_contentLen)) != NULL)
+		if (pInfo->m_contentLen + totalSize <= pInfo->m_contentSize)
 		{
-			((char*)pBadChar)[0] = ' ';
-#ifdef DEBUG
-			clog << "writeCallback: bad character" << endl;
-#endif
+			memcpy(pInfo->m_pContent + pInfo->m_contentLen, pData, totalSize);
+			pInfo->m_contentLen += totalSize;
+
+			return totalSize;
 		}
+
+		// More than announced, switch to chunks
+		pInfo->m_chunks.push_back(string(pInfo->m_pContent, pInfo->m_contentLen));
+		Memory::freeBuffer(pInfo->m_pContent, (off_t)pInfo->m_contentSize + 1);
+		pInfo->m_pContent = NULL;
+		pInfo->m_contentSize = 0;
 	}
 
+	// Content is kept as is, binary or not, in a list of chunks
+	if ((pInfo->m_chunks.empty() == true) ||
+		(pInfo->m_chunks.back().length() + totalSize > pInfo->m_chunks.back().capacity()))
+	{
+		pInfo->m_chunks.push_back(string());
+		pInfo->m_chunks.back().reserve(max((size_t)CONTENT_CHUNK_SIZE, totalSize));
+	}
+	pInfo->m_chunks.back().append((const char*)pData, totalSize);
+	pInfo->m_contentLen += totalSize;
+
 	return totalSize;
 }
 
@@ -148,29 +246,182 @@ static size_t headerCallback(void *pData, size_t dataSize, size_t elementsCount,
 }
 
 unsigned int CurlDownloader::m_initialized = 0;
+pthread_mutex_t CurlDownloader::m_initMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t CurlDownloader::m_handleKey;
+pthread_once_t CurlDownloader::m_handleKeyOnce = PTHREAD_ONCE_INIT;
 
 CurlDownloader::CurlDownloader() :
 	DownloaderInterface()
 {
-	if (m_initialized == 0)
-	{
-		// Initialize
-		curl_global_init(CURL_GLOBAL_ALL);
+	initializeLibrary();
+}
 
+CurlDownloader::~CurlDownloader()
+{
+	cleanupLibrary();
+}
+
+void CurlDownloader::initializeLibrary(void)
+{
+	if (pthread_mutex_lock(&m_initMutex) == 0)
+	{
+		if (m_initialized == 0)
+		{
+			// Initialize
+			curl_global_init(CURL_GLOBAL_ALL);
+		}
 		++m_initialized;
+
+		pthread_mutex_unlock(&m_initMutex);
 	}
 }
 
-CurlDownloader::~CurlDownloader()
+void CurlDownloader::cleanupLibrary(void)
+{
+	if (pthread_mutex_lock(&m_initMutex) == 0)
+	{
+		--m_initialized;
+		if (m_initialized == 0)
+		{
+			// Shutdown
+			curl_global_cleanup();
+		}
+
+		pthread_mutex_unlock(&m_initMutex);
+	}
+}
+
+void CurlDownloader::createHandleKey(void)
+{
+	pthread_key_create(&m_handleKey, CurlDownloader::deleteHandles);
+}
+
+void CurlDownloader::deleteHandles(void *pHandlers)
 {
-	--m_initialized;
-	if (m_initialized == 0)
+	vector<void *> *pHandlersCache = (vector<void *> *)pHandlers;
+
+	if (pHandlersCache == NULL)
+	{
+		return;
+	}
+
+	for (vector<void *>::iterator handlerIter = pHandlersCache->begin();
+		handlerIter != pHandlersCache->end(); ++handlerIter)
+	{
+		curl_easy_cleanup((CURL *)*handlerIter);
+		// Cached handles hold a reference on the library
+		cleanupLibrary();
+	}
+	delete pHandlersCache;
+}
+
+void *CurlDownloader::getHandle(void)
+{
+	pthread_once(&m_handleKeyOnce, CurlDownloader::createHandleKey);
+
+	// Each thread keeps its handles so that connections and sessions are reused
+	vector<void *> *pHandlersCache = (vector<void *> *)pthread_getspecific(m_handleKey);
+	if ((pHandlersCache != NULL) &&
+		(pHandlersCache->empty() == false))
+	{
+		CURL *pCurlHandler = (CURL *)pHandlersCache->back();
+
+		pHandlersCache->pop_back();
+
+		// Options are reset but live connections and the session cache are kept
+		curl_easy_reset(pCurlHandler);
+#if LIBCURL_VERSION_NUM >= 0x070e01
+		// Cookies aren't, they belong to the previous request
+		curl_easy_setopt(pCurlHandler, CURLOPT_COOKIELIST, "ALL");
+#endif
+
+		return (void *)pCurlHandler;
+	}
+
+	CURL *pCurlHandler = curl_easy_init();
+	if (pCurlHandler != NULL)
+	{
+		initializeLibrary();
+	}
+
+	return (void *)pCurlHandler;
+}
+
+void CurlDownloader::releaseHandle(void *pHandler)
+{
+	if (pHandler == NULL)
+	{
+		return;
+	}
+
+	vector<void *> *pHandlersCache = (vector<void *> *)pthread_getspecific(m_handleKey);
+	if (pHandlersCache == NULL)
+	{
+		pHandlersCache = new vector<void *>;
+		if (pthread_setspecific(m_handleKey, (void *)pHandlersCache) != 0)
+		{
+			delete pHandlersCache;
+			pHandlersCache = NULL;
+		}
+	}
+
+	if ((pHandlersCache != NULL) &&
+		(pHandlersCache->size() < MAX_CACHED_HANDLES))
+	{
+		pHandlersCache->push_back(pHandler);
+	}
+	else
 	{
-		// Shutdown
-		curl_global_cleanup();
+		curl_easy_cleanup((CURL *)pHandler);
+		cleanupLibrary();
 	}
 }
 
+bool CurlDownloader::getRefreshUrl(const Document *pDocument, string &url)
+{
+	bool redirected = false;
+
+#ifdef HAVE_REGEX_H
+	regex_t refreshRegex;
+	regmatch_t pMatches[3];
+	off_t contentLen = 0;
+	const char *pContent = NULL;
+
+	if (pDocument != NULL)
+	{
+		pContent = pDocument->getData(contentLen);
+	}
+
+	// Any REFRESH META tag ?
+	// Look for <meta http-equiv="refresh" content="SECS;url=URL">
+	if ((pContent != NULL) &&
+		(contentLen > 0) &&
+		(regcomp(&refreshRegex,
+		"<meta http-equiv=\"refresh\" content=\"([0-9]*);url=([^\"]*)\">",
+		REG_EXTENDED|REG_ICASE) == 0))
+	{
+		if ((regexec(&refreshRegex, pContent, 3,
+			pMatches, REG_NOTBOL|REG_NOTEOL) == 0) &&
+			(pMatches[2].rm_so >= 0) &&
+			(pMatches[2].rm_eo > pMatches[2].rm_so))
+		{
+			url = string(pContent + pMatches[2].rm_so, pMatches[2].rm_eo - pMatches[2].rm_so);
+			redirected = true;
+		}
+#ifdef DEBUG
+		else clog << "CurlDownloader::getRefreshUrl: no REFRESH META tag" << endl;
+#endif
+
+		regfree(&refreshRegex);
+	}
+#ifdef DEBUG
+	else clog << "CurlDownloader::getRefreshUrl: couldn't look for a REFRESH META tag" << endl;
+#endif
+#endif
+
+	return redirected;
+}
+
 Document *CurlDownloader::populateDocument(const DocumentInfo &docInfo,
 	const string &url, void *pHandler, void *pInfo)
 {
@@ -184,11 +435,16 @@ Document *CurlDownloader::populateDocument(const DocumentInfo &docInfo,
 	ContentInfo *pContentInfo = (ContentInfo *)pInfo;
 	char *pContentType = NULL;
 	long responseCode = 200;
+	off_t contentLen = (off_t)pContentInfo->m_contentLen;
 
-	// Copy the document content
-	pDocument->setData(pContentInfo->m_pContent, pContentInfo->m_contentLen);
+	// Hand the document content over
+	char *pContent = assembleContent(pContentInfo);
+	if (pContent != NULL)
+	{
+		pDocument->adoptData(pContent, contentLen);
+	}
 	pDocument->setLocation(url);
-	pDocument->setSize((off_t )pContentInfo->m_contentLen);
+	pDocument->setSize(contentLen);
 
 	// What's the Content-Type ?
 	CURLcode res = curl_easy_getinfo((CURL *)pHandler, CURLINFO_CONTENT_TYPE, &pContentType);
@@ -222,6 +478,62 @@ Document *CurlDownloader::populateDocument(const DocumentInfo &docInfo,
 	return pDocument;
 }
 
+void CurlDownloader::setOptions(void *pHandler, void *pInfo, void *pHeaders)
+{
+	CURL *pCurlHandler = (CURL *)pHandler;
+
+	// The write callback looks up the announced length
+	((ContentInfo *)pInfo)->m_pHandler = pHandler;
+
+	curl_easy_setopt(pCurlHandler, CURLOPT_AUTOREFERER, 1);
+	curl_easy_setopt(pCurlHandler, CURLOPT_FOLLOWLOCATION, 1);
+	curl_easy_setopt(pCurlHandler, CURLOPT_MAXREDIRS, 10);
+	curl_easy_setopt(pCurlHandler, CURLOPT_USERAGENT, m_userAgent.c_str());
+	curl_easy_setopt(pCurlHandler, CURLOPT_NOSIGNAL, (long)1);
+	curl_easy_setopt(pCurlHandler, CURLOPT_TIMEOUT, (long)m_timeout);
+#ifndef DEBUG
+	curl_easy_setopt(pCurlHandler, CURLOPT_NOPROGRESS, 1);
+#endif
+	curl_easy_setopt(pCurlHandler, CURLOPT_HTTPHEADER, (struct curl_slist *)pHeaders);
+	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEFUNCTION, writeCallback);
+	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEDATA, pInfo);
+	curl_easy_setopt(pCurlHandler, CURLOPT_HEADERFUNCTION, headerCallback);
+	curl_easy_setopt(pCurlHandler, CURLOPT_HEADERDATA, pInfo);
+
+	// Is a proxy defined ?
+	// Curl automatically checks and makes use of the *_proxy environment variables 
+	if ((m_proxyAddress.empty() == false) &&
+		(m_proxyPort > 0))
+	{
+		curl_proxytype proxyType = CURLPROXY_HTTP;
+
+		curl_easy_setopt(pCurlHandler, CURLOPT_PROXY, m_proxyAddress.c_str());
+		curl_easy_setopt(pCurlHandler, CURLOPT_PROXYPORT, m_proxyPort);
+		// Type defaults to HTTP
+		if (m_proxyType.empty() == false)
+		{
+			if (m_proxyType == "SOCKS4")
+			{
+				proxyType = CURLPROXY_SOCKS4;
+			}
+			else if (m_proxyType == "SOCKS5")
+			{
+				proxyType = CURLPROXY_SOCKS5;
+			}
+		}
+		curl_easy_setopt(pCurlHandler, CURLOPT_PROXYTYPE, proxyType);
+	}
+
+	if (m_method == "POST")
+	{
+		curl_easy_setopt(pCurlHandler, CURLOPT_POST, 1);
+		if (m_postFields.empty() == false)
+		{
+			curl_easy_setopt(pCurlHandler, CURLOPT_POSTFIELDS, m_postFields.c_str());
+		}
+	}
+}
+
 //
 // Implementation of DownloaderInterface
 //
@@ -258,8 +570,8 @@ Document *CurlDownloader::retrieveUrl(const DocumentInfo &docInfo,
 		url += ipath;
 	}
 
-	// Create a session
-	CURL *pCurlHandler = curl_easy_init();
+	// Get this thread's session
+	CURL *pCurlHandler = (CURL *)getHandle();
 	if (pCurlHandler == NULL)
 	{
 		return NULL;
@@ -268,9 +580,6 @@ Document *CurlDownloader::retrieveUrl(const DocumentInfo &docInfo,
 	struct curl_slist *pHeadersList = NULL;
 	ContentInfo *pContentInfo = new ContentInfo;
 
-	pContentInfo->m_pContent = NULL;
-	pContentInfo->m_contentLen = 0;
-
 	// Add headers
 	for (map<string, string>::const_iterator headerIter = headers.begin();
 			headerIter != headers.end(); ++headerIter)
@@ -282,102 +591,33 @@ Document *CurlDownloader::retrieveUrl(const DocumentInfo &docInfo,
 		pHeadersList = curl_slist_append(pHeadersList, pBuffer);
 	}
 
-	curl_easy_setopt(pCurlHandler, CURLOPT_AUTOREFERER, 1);
-	curl_easy_setopt(pCurlHandler, CURLOPT_FOLLOWLOCATION, 1);
-	curl_easy_setopt(pCurlHandler, CURLOPT_MAXREDIRS, 10);
-	curl_easy_setopt(pCurlHandler, CURLOPT_USERAGENT, m_userAgent.c_str());
-	curl_easy_setopt(pCurlHandler, CURLOPT_NOSIGNAL, (long)1);
-	curl_easy_setopt(pCurlHandler, CURLOPT_TIMEOUT, (long)m_timeout);
-#ifndef DEBUG
-	curl_easy_setopt(pCurlHandler, CURLOPT_NOPROGRESS, 1);
-#endif
-	curl_easy_setopt(pCurlHandler, CURLOPT_HTTPHEADER, pHeadersList);
-	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEFUNCTION, writeCallback);
-	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEDATA, pContentInfo);
-	curl_easy_setopt(pCurlHandler, CURLOPT_HEADERFUNCTION, headerCallback);
-	curl_easy_setopt(pCurlHandler, CURLOPT_HEADERDATA, pContentInfo);
-
-	// Is a proxy defined ?
-	// Curl automatically checks and makes use of the *_proxy environment variables 
-	if ((m_proxyAddress.empty() == false) &&
-		(m_proxyPort > 0))
-	{
-		curl_proxytype proxyType = CURLPROXY_HTTP;
-
-		curl_easy_setopt(pCurlHandler, CURLOPT_PROXY, m_proxyAddress.c_str());
-		curl_easy_setopt(pCurlHandler, CURLOPT_PROXYPORT, m_proxyPort);
-		// Type defaults to HTTP
-		if (m_proxyType.empty() == false)
-		{
-			if (m_proxyType == "SOCKS4")
-			{
-				proxyType = CURLPROXY_SOCKS4;
-			}
-			else if (m_proxyType == "SOCKS5")
-			{
-				proxyType = CURLPROXY_SOCKS5;
-			}
-		}
-		curl_easy_setopt(pCurlHandler, CURLOPT_PROXYTYPE, proxyType);
-	}
+	setOptions(pCurlHandler, pContentInfo, pHeadersList);
 
 #ifdef DEBUG
 	clog << "CurlDownloader::retrieveUrl: URL is " << url << endl;
 #endif
-	while (redirectionsCount < 10)
+	while (redirectionsCount < MAX_REDIRECTIONS)
 	{
 		curl_easy_setopt(pCurlHandler, CURLOPT_URL, Url::escapeUrl(url).c_str());
 
-		if (m_method == "POST")
-		{
-			curl_easy_setopt(pCurlHandler, CURLOPT_POST, 1);
-			if (m_postFields.empty() == false)
-			{
-				curl_easy_setopt(pCurlHandler, CURLOPT_POSTFIELDS, m_postFields.c_str());
-			}
-		}
-
 		CURLcode res = curl_easy_perform(pCurlHandler);
 		if ((res == CURLE_OK) &&
-			(pContentInfo->m_pContent != NULL) &&
 			(pContentInfo->m_contentLen > 0))
 		{
 			pDocument = populateDocument(docInfo, url,
 				pCurlHandler, pContentInfo);
 
-#ifdef HAVE_REGEX_H
-			regex_t refreshRegex;
-			regmatch_t pMatches[2];
-
-			// Any REFRESH META tag ?
-			// Look for <meta http-equiv="refresh" content="SECS;url=URL">
-			if (regcomp(&refreshRegex,
-				"<meta http-equiv=\"refresh\" content=\"([0-9]*);url=([^\"]*)\">"
-				REG_EXTENDED|REG_ICASE) == 0)
+			if (getRefreshUrl(pDocument, url) == true)
 			{
-				if (regexec(&refreshRegex, pContentInfo->m_pContent, 2,
-					pMatches, REG_NOTBOL|REG_NOTEOL) == 0)
-				{
-					url = pMatches[1];
-#ifdef DEBUG
-					clog << "CurlDownloader::retrieveUrl: redirected to URL " << url << endl;
-#endif
-					delete pDocument;
-					pDocument = NULL;
-					freeContentInfo(pContentInfo);
-					++redirectionsCount;
-					continue;
-				}
 #ifdef DEBUG
-				else clog << "CurlDownloader::retrieveUrl: no REFRESH META tag" << endl;
+				clog << "CurlDownloader::retrieveUrl: redirected to URL " << url << endl;
 #endif
-
-				regfree(&refreshRegex);
+				delete pDocument;
+				pDocument = NULL;
+				freeContentInfo(pContentInfo);
+				++redirectionsCount;
+				continue;
 			}
-#ifdef DEBUG
-			else clog << "CurlDownloader::retrieveUrl: couldn't look for a REFRESH META tag" << endl;
-#endif
-#endif
 		}
 		else
 		{
@@ -390,8 +630,10 @@ Document *CurlDownloader::retrieveUrl(const DocumentInfo &docInfo,
 	freeContentInfo(pContentInfo);
 	delete pContentInfo;
 
-	// Cleanup
-	curl_easy_cleanup(pCurlHandler);
+	// The handle is kept for the next download
+	curl_easy_setopt(pCurlHandler, CURLOPT_HTTPHEADER, NULL);
+	curl_slist_free_all(pHeadersList);
+	releaseHandle(pCurlHandler);
 
 	return pDocument;
 }
@@ -423,8 +665,8 @@ Document *CurlDownloader::putUrl(const DocumentInfo &docInfo,
 		return NULL;
 	}
 
-	// Create a session
-	CURL *pCurlHandler = curl_easy_init();
+	// Get this thread's session
+	CURL *pCurlHandler = (CURL *)getHandle();
 	if (pCurlHandler == NULL)
 	{
 		fclose(pFile);
@@ -434,9 +676,6 @@ Document *CurlDownloader::putUrl(const DocumentInfo &docInfo,
 
 	ContentInfo *pContentInfo = new ContentInfo;
 
-	pContentInfo->m_pContent = NULL;
-	pContentInfo->m_contentLen = 0;
-
 	// Add headers
 	for (map<string, string>::const_iterator headerIter = headers.begin();
 		headerIter != headers.end(); ++headerIter)
@@ -460,6 +699,7 @@ Document *CurlDownloader::putUrl(const DocumentInfo &docInfo,
 	// Use the default read function
 	curl_easy_setopt(pCurlHandler, CURLOPT_READFUNCTION, NULL);
 	curl_easy_setopt(pCurlHandler, CURLOPT_READDATA, pFile);
+	pContentInfo->m_pHandler = pCurlHandler;
 	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEFUNCTION, writeCallback);
 	curl_easy_setopt(pCurlHandler, CURLOPT_WRITEDATA, pContentInfo);
 	curl_easy_setopt(pCurlHandler, CURLOPT_HEADERFUNCTION, headerCallback);
@@ -482,11 +722,203 @@ Document *CurlDownloader::putUrl(const DocumentInfo &docInfo,
 		clog << "Couldn't upload to " << url << ": " << curl_easy_strerror(res) << endl;
 	}
 
+	curl_easy_setopt(pCurlHandler, CURLOPT_HTTPHEADER, NULL);
+	curl_easy_setopt(pCurlHandler, CURLOPT_READDATA, NULL);
 	curl_slist_free_all(pHeadersList);
-	curl_easy_cleanup(pCurlHandler);
+	releaseHandle(pCurlHandler);
 	fclose(pFile);
 	freeContentInfo(pContentInfo);
 	delete pContentInfo;
 
 	return pDocument;
 }
+
+/// Retrieves the specified documents; returns the number retrieved.
+unsigned int CurlDownloader::retrieveUrls(const vector<DocumentInfo> &docsInfo,
+	vector<Document *> &documents)
+{
+	map<CURL *, unsigned int> transfers;
+	vector<ContentInfo> contentInfos(docsInfo.size());
+	vector<string> urls(docsInfo.size());
+	vector<unsigned int> redirectionsCounts(docsInfo.size(), 0);
+	unsigned int nextDoc = 0, docsCount = 0;
+	int runningCount = 0;
+
+	documents.clear();
+	documents.resize(docsInfo.size(), NULL);
+	if (docsInfo.empty() == true)
+	{
+		return 0;
+	}
+
+	CURLM *pMultiHandler = curl_multi_init();
+	if (pMultiHandler == NULL)
+	{
+		return DownloaderInterface::retrieveUrls(docsInfo, documents);
+	}
+#if LIBCURL_VERSION_NUM >= 0x071e00
+	curl_multi_setopt(pMultiHandler, CURLMOPT_MAX_HOST_CONNECTIONS, (long)m_maxHostConnections);
+	curl_multi_setopt(pMultiHandler, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)m_maxConnections);
+#endif
+
+	while ((nextDoc < docsInfo.size()) ||
+		(transfers.empty() == false))
+	{
+		// Keep a bounded number of transfers going
+		while ((nextDoc < docsInfo.size()) &&
+			(transfers.size() < m_maxConnections))
+		{
+			unsigned int docNum = nextDoc;
+			string ipath(docsInfo[docNum].getInternalPath());
+
+			++nextDoc;
+			urls[docNum] = docsInfo[docNum].getLocation();
+			if (urls[docNum].empty() == true)
+			{
+				continue;
+			}
+			if (ipath.empty() == false)
+			{
+				urls[docNum] += "?";
+				urls[docNum] += ipath;
+			}
+
+			// Cached handles keep their connections alive
+			CURL *pCurlHandler = (CURL *)getHandle();
+			if (pCurlHandler == NULL)
+			{
+				continue;
+			}
+
+			contentInfos[docNum].m_contentLen = 0;
+			setOptions(pCurlHandler, &contentInfos[docNum], NULL);
+			curl_easy_setopt(pCurlHandler, CURLOPT_URL, Url::escapeUrl(urls[docNum]).c_str());
+
+			if (curl_multi_add_handle(pMultiHandler, pCurlHandler) != CURLM_OK)
+			{
+				releaseHandle(pCurlHandler);
+				continue;
+			}
+			transfers[pCurlHandler] = docNum;
+		}
+
+		if (curl_multi_perform(pMultiHandler, &runningCount) != CURLM_OK)
+		{
+			break;
+		}
+
+		// Collect finished transfers
+		int messagesCount = 0;
+		CURLMsg *pMessage = curl_multi_info_read(pMultiHandler, &messagesCount);
+		while (pMessage != NULL)
+		{
+			if (pMessage->msg == CURLMSG_DONE)
+			{
+				CURL *pCurlHandler = pMessage->easy_handle;
+				map<CURL *, unsigned int>::iterator transferIter = transfers.find(pCurlHandler);
+				bool redirected = false;
+
+				// The message doesn't outlive the handle's removal
+				CURLcode res = pMessage->data.result;
+				curl_multi_remove_handle(pMultiHandler, pCurlHandler);
+
+				if (transferIter != transfers.end())
+				{
+					unsigned int docNum = transferIter->second;
+
+					if ((res == CURLE_OK) &&
+						(contentInfos[docNum].m_contentLen > 0))
+					{
+						documents[docNum] = populateDocument(docsInfo[docNum], urls[docNum],
+							pCurlHandler, &contentInfos[docNum]);
+
+						// Follow REFRESH META tags like retrieveUrl() does
+						if (getRefreshUrl(documents[docNum], urls[docNum]) == true)
+						{
+#ifdef DEBUG
+							clog << "CurlDownloader::retrieveUrls: redirected to URL " << urls[docNum] << endl;
+#endif
+							delete documents[docNum];
+							documents[docNum] = NULL;
+							freeContentInfo(&contentInfos[docNum]);
+							++redirectionsCounts[docNum];
+
+							if (redirectionsCounts[docNum] < MAX_REDIRECTIONS)
+							{
+								curl_easy_setopt(pCurlHandler, CURLOPT_URL, Url::escapeUrl(urls[docNum]).c_str());
+								redirected = (curl_multi_add_handle(pMultiHandler, pCurlHandler) == CURLM_OK);
+							}
+						}
+						else if (documents[docNum] != NULL)
+						{
+							++docsCount;
+						}
+					}
+					else
+					{
+						clog << "Couldn't download " << urls[docNum] << ": "
+							<< curl_easy_strerror(res) << endl;
+					}
+
+					if (redirected == false)
+					{
+						freeContentInfo(&contentInfos[docNum]);
+						transfers.erase(transferIter);
+					}
+				}
+
+				if (redirected == false)
+				{
+					releaseHandle(pCurlHandler);
+				}
+			}
+
+			pMessage = curl_multi_info_read(pMultiHandler, &messagesCount);
+		}
+
+		if ((runningCount > 0) &&
+			(transfers.empty() == false))
+		{
+			// Wait for activity, at most a second
+#if LIBCURL_VERSION_NUM >= 0x071c00
+			curl_multi_wait(pMultiHandler, NULL, 0, 1000, NULL);
+#else
+			fd_set readSet, writeSet, exceptSet;
+			struct timeval selectTimeout;
+			int maxFd = -1;
+
+			FD_ZERO(&readSet);
+			FD_ZERO(&writeSet);
+			FD_ZERO(&exceptSet);
+			selectTimeout.tv_sec = 1;
+			selectTimeout.tv_usec = 0;
+			if ((curl_multi_fdset(pMultiHandler, &readSet, &writeSet, &exceptSet, &maxFd) == CURLM_OK) &&
+				(maxFd >= 0))
+			{
+				select(maxFd + 1, &readSet, &writeSet, &exceptSet, &selectTimeout);
+			}
+			else
+			{
+				// Nothing to wait on yet, try again shortly
+				usleep(100000);
+			}
+#endif
+		}
+	}
+
+	// Anything left was interrupted
+	for (map<CURL *, unsigned int>::iterator transferIter = transfers.begin();
+		transferIter != transfers.end(); ++transferIter)
+	{
+		curl_multi_remove_handle(pMultiHandler, transferIter->first);
+		curl_easy_cleanup(transferIter->first);
+		cleanupLibrary();
+		freeContentInfo(&contentInfos[transferIter->second]);
+	}
+	curl_multi_cleanup(pMultiHandler);
+#ifdef DEBUG
+	clog << "CurlDownloader::retrieveUrls: retrieved " << docsCount << "/" << docsInfo.size() << endl;
+#endif
+
+	return docsCount;
+}
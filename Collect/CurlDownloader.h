@@ -19,8 +19,10 @@
 #ifndef _CURL_DOWNLOADER_H
 #define _CURL_DOWNLOADER_H
 
+#include <pthread.h>
 #include <string>
 #include <map>
+#include <vector>
 
 #include "DownloaderInterface.h"
 
@@ -44,6 +46,14 @@ class CurlDownloader : public DownloaderInterface
 		virtual Document *retrieveUrl(const DocumentInfo &docInfo,
 			const std::map<std::string, std::string> &headers);
 
+		/**
+		  * Retrieves the specified documents, in parallel.
+		  * Documents are in the same order, NULL if error. Caller deletes.
+		  * Returns the number of documents retrieved.
+		  */
+		virtual unsigned int retrieveUrls(const std::vector<DocumentInfo> &docsInfo,
+			std::vector<Document *> &documents);
+
 		/**
 		  * Puts the specified document at the given URL.
 		  * NULL if error. Caller deletes.
@@ -54,6 +64,28 @@ class CurlDownloader : public DownloaderInterface
 
 	protected:
 		static unsigned int m_initialized;
+		static pthread_mutex_t m_initMutex;
+		static pthread_key_t m_handleKey;
+		static pthread_once_t m_handleKeyOnce;
+
+		static void initializeLibrary(void);
+
+		static void cleanupLibrary(void);
+
+		static void createHandleKey(void);
+
+		static void deleteHandles(void *pHandlers);
+
+		/// Returns one of the calling thread's handles, reset to default options.
+		static void *getHandle(void);
+
+		/// Gives a handle back to the calling thread's cache.
+		static void releaseHandle(void *pHandler);
+
+		/// Returns true and sets url if the document has a REFRESH META tag.
+		static bool getRefreshUrl(const Document *pDocument, std::string &url);
+
+		void setOptions(void *pHandler, void *pInfo, void *pHeaders);
 
 		static Document *populateDocument(const DocumentInfo &docInfo,
 			const std::string &url, void *pHandler,
@@ -114,7 +114,9 @@ DownloaderInterface::DownloaderInterface() :
 	m_userAgent("Mozilla/5.0 (X11; U; Linux i686; en-US; rv:1.7.3) Gecko/20041020"),
 	m_proxyPort(0),
 	m_timeout(60),
-	m_method("GET")
+	m_method("GET"),
+	m_maxConnections(8),
+	m_maxHostConnections(2)
 {
 }
 
@@ -160,6 +162,16 @@ bool DownloaderInterface::setSetting(const string &name, const string &value)
 	{
 		m_postFields = value;
 	}
+	else if ((name == "maxconnections") &&
+		(atoi(value.c_str()) > 0))
+	{
+		m_maxConnections = (unsigned int)atoi(value.c_str());
+	}
+	else if ((name == "maxhostconnections") &&
+		(atoi(value.c_str()) > 0))
+	{
+		m_maxHostConnections = (unsigned int)atoi(value.c_str());
+	}
 	else
 	{
 		goodSetting = false;
@@ -168,3 +180,25 @@ bool DownloaderInterface::setSetting(const string &name, const string &value)
 	return goodSetting;
 }
 
+/// Retrieves the specified documents; returns the number retrieved.
+unsigned int DownloaderInterface::retrieveUrls(const vector<DocumentInfo> &docsInfo,
+	vector<Document *> &documents)
+{
+	unsigned int docsCount = 0;
+
+	// One at a time
+	documents.clear();
+	for (vector<DocumentInfo>::const_iterator docIter = docsInfo.begin();
+		docIter != docsInfo.end(); ++docIter)
+	{
+		Document *pDocument = retrieveUrl(*docIter);
+
+		if (pDocument != NULL)
+		{
+			++docsCount;
+		}
+		documents.push_back(pDocument);
+	}
+
+	return docsCount;
+}
@@ -20,6 +20,8 @@
 #define _DOWNLOADER_INTERFACE_H
 
 #include <string>
+#include <map>
+#include <vector>
 
 #include "Document.h"
 
@@ -43,6 +45,8 @@ class DownloaderInterface
 		  * timeout - timeout in seconds 
 		  * method - GET or POST
 		  * postfields - data to post
+		  * maxconnections - how many documents retrieveUrls() may fetch at once
+		  * maxhostconnections - how many connections to a host retrieveUrls() may open
 		  * Returns true if success.
 		  */
 		virtual bool setSetting(const std::string &name, const std::string &value);
@@ -54,6 +58,14 @@ class DownloaderInterface
 		virtual Document *retrieveUrl(const DocumentInfo &docInfo,
 			const std::map<std::string, std::string> &headers) = 0;
 
+		/**
+		  * Retrieves the specified documents, in parallel if possible.
+		  * Documents are in the same order, NULL if error. Caller deletes.
+		  * Returns the number of documents retrieved.
+		  */
+		virtual unsigned int retrieveUrls(const std::vector<DocumentInfo> &docsInfo,
+			std::vector<Document *> &documents);
+
 	protected:
 		std::string m_userAgent;
 		std::string m_proxyAddress;
@@ -62,6 +74,8 @@ class DownloaderInterface
 		unsigned int m_timeout;
 		std::string m_method;
 		std::string m_postFields;
+		unsigned int m_maxConnections;
+		unsigned int m_maxHostConnections;
 
 		DownloaderInterface();
 
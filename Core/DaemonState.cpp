@@ -137,6 +137,44 @@ public:
 };
 
 #ifdef HAVE_DBUS
+// Methods that don't have to wait behind queries and updates
+static const char *g_interactiveMethods[] = { "GetStatistics", "GetLatencies", "HasDocument", "HasDocuments", "GetLabels",
+	"GetDocumentLabels", "GetDocumentInfo", "GetDocumentsInfo", "OpenQuery", "CloseQuery", "Reload",
+	"Stop", "Introspect", NULL };
+
+pthread_mutex_t DBusServletInfo::m_latenciesMutex = PTHREAD_MUTEX_INITIALIZER;
+map<string, DBusServletInfo::MethodLatency> DBusServletInfo::m_latencies;
+
+DBusServletInfo::MethodLatency::MethodLatency() :
+	m_callsCount(0),
+	m_totalTime(0),
+	m_maxTime(0)
+{
+}
+
+DBusServletInfo::MethodLatency::MethodLatency(const MethodLatency &other) :
+	m_callsCount(other.m_callsCount),
+	m_totalTime(other.m_totalTime),
+	m_maxTime(other.m_maxTime)
+{
+}
+
+DBusServletInfo::MethodLatency::~MethodLatency()
+{
+}
+
+DBusServletInfo::MethodLatency &DBusServletInfo::MethodLatency::operator=(const MethodLatency &other)
+{
+	if (this != &other)
+	{
+		m_callsCount = other.m_callsCount;
+		m_totalTime = other.m_totalTime;
+		m_maxTime = other.m_maxTime;
+	}
+
+	return *this;
+}
+
 DBusServletInfo::DBusServletInfo(DBusConnection *pConnection, DBusMessage *pRequest) :
 	m_pConnection(pConnection),
 	m_pRequest(pRequest),
@@ -144,8 +182,13 @@ DBusServletInfo::DBusServletInfo(DBusConnection *pConnection, DBusMessage *pRequ
 	m_pArray(NULL),
 	m_simpleQuery(true),
 	m_pThread(NULL),
+	m_cursorId(0),
+	m_cursorPosition(0),
+	m_cursorCount(0),
 	m_replied(false)
 {
+	// Time from the request's arrival to the reply
+	m_replyTimer.start();
 }
 
 DBusServletInfo::~DBusServletInfo()
@@ -268,7 +311,7 @@ bool DBusServletInfo::newQueryReply(const vector<DocumentInfo> &resultsList,
 		if (m_simpleQuery == false)
 		{
 			// The document ID isn't needed here
-			if (DBusIndex::documentInfoToDBus(&subIter, 0, *resultIter) == false)
+			if (DBusIndex::documentInfoToDBus(&subIter, 0, *resultIter, m_fields) == false)
 			{
 				newErrorReply("Query", "Unknown error");
 				return false;
@@ -310,11 +353,99 @@ bool DBusServletInfo::reply(void)
 		clog << "DBusServletInfo::reply: sent reply" << endl;
 #endif
 
+		const char *pMember = ((m_pRequest == NULL) ? NULL : dbus_message_get_member(m_pRequest));
+		long replyTime = m_replyTimer.stop();
+
+		if ((pMember != NULL) &&
+			(replyTime >= 0) &&
+			(pthread_mutex_lock(&m_latenciesMutex) == 0))
+		{
+			MethodLatency &latency = m_latencies[pMember];
+
+			++latency.m_callsCount;
+			latency.m_totalTime += (unsigned long)replyTime;
+			if ((unsigned long)replyTime > latency.m_maxTime)
+			{
+				latency.m_maxTime = (unsigned long)replyTime;
+			}
+
+			pthread_mutex_unlock(&m_latenciesMutex);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/// Returns true if the request is for a method that should be answered right away.
+bool DBusServletInfo::isInteractive(void) const
+{
+	const char *pMember = NULL;
+
+	if (m_pRequest != NULL)
+	{
+		pMember = dbus_message_get_member(m_pRequest);
+	}
+	if (pMember == NULL)
+	{
 		return true;
 	}
 
+	for (unsigned int methodNum = 0; g_interactiveMethods[methodNum] != NULL; ++methodNum)
+	{
+		if (strcmp(pMember, g_interactiveMethods[methodNum]) == 0)
+		{
+			return true;
+		}
+	}
+
 	return false;
 }
+
+/// Gets the latencies of methods replied to so far, in milliseconds.
+void DBusServletInfo::getLatencies(map<string, MethodLatency> &latencies)
+{
+	if (pthread_mutex_lock(&m_latenciesMutex) == 0)
+	{
+		latencies = m_latencies;
+
+		pthread_mutex_unlock(&m_latenciesMutex);
+	}
+}
+
+DBusQueryCursor::DBusQueryCursor() :
+	m_position(0),
+	m_accessTime(time(NULL))
+{
+}
+
+DBusQueryCursor::DBusQueryCursor(const DBusQueryCursor &other) :
+	m_engineType(other.m_engineType),
+	m_engineOption(other.m_engineOption),
+	m_queryProps(other.m_queryProps),
+	m_position(other.m_position),
+	m_accessTime(other.m_accessTime)
+{
+}
+
+DBusQueryCursor::~DBusQueryCursor()
+{
+}
+
+DBusQueryCursor &DBusQueryCursor::operator=(const DBusQueryCursor &other)
+{
+	if (this != &other)
+	{
+		m_engineType = other.m_engineType;
+		m_engineOption = other.m_engineOption;
+		m_queryProps = other.m_queryProps;
+		m_position = other.m_position;
+		m_accessTime = other.m_accessTime;
+	}
+
+	return *this;
+}
 #endif
 
 DaemonState::DaemonState() :
@@ -328,6 +459,13 @@ DaemonState::DaemonState() :
 	m_crawlers(0)
 {
 	FD_ZERO(&m_flagsSet);
+#ifdef HAVE_DBUS
+	// D-Bus requests have their own workers, cheap requests don't queue behind costly ones
+	m_pInteractivePool = new WorkerPool(2, 256);
+	m_pBulkPool = new WorkerPool(2, 256);
+	pthread_mutex_init(&m_cursorsMutex, NULL);
+	m_nextCursorId = 1;
+#endif
 
 	// Check disk usage every minute
 	m_timeoutConnection = Glib::signal_timeout().connect(sigc::mem_fun(*this,
@@ -340,8 +478,11 @@ DaemonState::DaemonState() :
 
 DaemonState::~DaemonState()
 {
-	// Don't delete m_pDiskMonitor and m_pDiskHandler, threads may need them
+	// Don't delete m_pDiskMonitor, m_pDiskHandler and the servlets pools, threads may need them
 	// Since DaemonState is destroyed when the program exits, it's a leak we can live with
+#ifdef HAVE_DBUS
+	pthread_mutex_destroy(&m_cursorsMutex);
+#endif
 }
 
 bool DaemonState::on_activity_timeout(void)
@@ -382,6 +523,19 @@ bool DaemonState::on_activity_timeout(void)
 #endif
 	}
 
+	// Limit how much of the queue would be lost if we were to crash
+	flush_queue();
+
+#ifdef HAVE_DBUS
+	// Close cursors that clients forgot about
+	if (pthread_mutex_lock(&m_cursorsMutex) == 0)
+	{
+		expire_query_cursors(time(NULL), 0);
+
+		pthread_mutex_unlock(&m_cursorsMutex);
+	}
+#endif
+
 	return true;
 }
 
@@ -480,6 +634,22 @@ bool DaemonState::crawl_location(const PinotSettings::IndexableLocation &locatio
 	return false;
 }
 
+bool DaemonState::pools_are_idle(void)
+{
+#ifdef HAVE_DBUS
+	// Servlets may still be queued on the pools
+	if (((m_pInteractivePool != NULL) &&
+		(m_pInteractivePool->getQueuedCount() > 0)) ||
+		((m_pBulkPool != NULL) &&
+		(m_pBulkPool->getQueuedCount() > 0)))
+	{
+		return false;
+	}
+#endif
+
+	return true;
+}
+
 void DaemonState::flush_and_reclaim(void)
 {
 	IndexInterface *pIndex = PinotSettings::getInstance().getIndex(PinotSettings::getInstance().m_daemonIndexLocation);
@@ -496,6 +666,47 @@ void DaemonState::flush_and_reclaim(void)
 	Memory::reclaim();
 }
 
+#ifdef HAVE_DBUS
+void DaemonState::expire_query_cursors(time_t timeNow, unsigned int maxCursors)
+{
+	// Call with m_cursorsMutex locked
+	map<unsigned int, DBusQueryCursor>::iterator cursorIter = m_queryCursors.begin();
+	while (cursorIter != m_queryCursors.end())
+	{
+		map<unsigned int, DBusQueryCursor>::iterator nextIter = cursorIter;
+		++nextIter;
+
+		// Idle for more than five minutes ?
+		if (cursorIter->second.m_accessTime + 300 < timeNow)
+		{
+#ifdef DEBUG
+			clog << "DaemonState::expire_query_cursors: cursor " << cursorIter->first << " expired" << endl;
+#endif
+			m_queryCursors.erase(cursorIter);
+		}
+
+		cursorIter = nextIter;
+	}
+
+	// Drop the least recently used
+	while ((maxCursors > 0) &&
+		(m_queryCursors.size() > maxCursors))
+	{
+		map<unsigned int, DBusQueryCursor>::iterator oldestIter = m_queryCursors.begin();
+
+		for (cursorIter = m_queryCursors.begin(); cursorIter != m_queryCursors.end(); ++cursorIter)
+		{
+			if (cursorIter->second.m_accessTime < oldestIter->second.m_accessTime)
+			{
+				oldestIter = cursorIter;
+			}
+		}
+
+		m_queryCursors.erase(oldestIter);
+	}
+}
+#endif
+
 void DaemonState::start(bool isReindex)
 {
 	// Disable implicit flushing after a change
@@ -690,7 +901,16 @@ void DaemonState::on_thread_end(WorkerThread *pThread)
 			{
 				m_servletsInfo.insert(pInfo);
 
-				start_thread(pInfo->m_pThread);
+				// Queries wait behind other costly requests
+				if (start_pooled_thread(pInfo->m_pThread, m_pBulkPool) == false)
+				{
+					m_servletsInfo.erase(pInfo);
+
+					pInfo->newErrorReply("Query", "Query failed");
+					pInfo->reply();
+
+					delete pInfo;
+				}
 			}
 			else
 			{
@@ -738,6 +958,14 @@ void DaemonState::on_thread_end(WorkerThread *pThread)
 #ifdef DEBUG
 				clog << "DaemonState::on_thread_end: ran query " << queryProps.getName() << endl;
 #endif
+				// Move the cursor on to the next page if this one was retrieved
+				if ((pInfo->m_cursorId > 0) &&
+					(pQueryThread->getErrorNum() == 0))
+				{
+					advance_query_cursor(pInfo->m_cursorId, pInfo->m_cursorPosition,
+						pInfo->m_cursorCount);
+				}
+
 				// Prepare and send the reply
 				pInfo->newQueryReply(resultsList, pQueryThread->getDocumentsCount());
 				pInfo->reply();
@@ -762,7 +990,8 @@ void DaemonState::on_thread_end(WorkerThread *pThread)
 	// Wait until there are no threads running (except background ones)
 	// to reload the configuration
 	if ((m_reload == true) &&
-		(get_threads_count() == 0))
+		(get_threads_count() == 0) &&
+		(pools_are_idle() == true))
 	{
 #ifdef DEBUG
 		clog << "DaemonState::on_thread_end: stopping all threads" << endl;
@@ -792,7 +1021,8 @@ void DaemonState::on_thread_end(WorkerThread *pThread)
 	// and the queue is empty to flush the index
 	if ((m_flush == true) &&
 		(emptyQueue == true) &&
-		(get_threads_count() == 0))
+		(get_threads_count() == 0) &&
+		(pools_are_idle() == true))
 	{
 		m_flush = false;
 
@@ -859,3 +1089,127 @@ void DaemonState::reset_flag(StatusFlag flag)
 	FD_CLR((int)flag, &m_flagsSet);
 }
 
+#ifdef HAVE_DBUS
+bool DaemonState::start_servlet(DBusServletInfo *pInfo)
+{
+	WorkerPool *pPool = m_pBulkPool;
+
+	if (pInfo == NULL)
+	{
+		return false;
+	}
+
+	if (pInfo->isInteractive() == true)
+	{
+		pPool = m_pInteractivePool;
+	}
+
+	if (start_pooled_thread(new DBusServletThread(this, pInfo), pPool) == false)
+	{
+		clog << "Couldn't start servlet, too many requests" << endl;
+
+		pInfo->newErrorReply("Busy", "Too many requests");
+		pInfo->reply();
+
+		delete pInfo;
+
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int DaemonState::open_query_cursor(const DBusQueryCursor &cursor)
+{
+	unsigned int cursorId = 0;
+
+	if (pthread_mutex_lock(&m_cursorsMutex) == 0)
+	{
+		cursorId = m_nextCursorId;
+		++m_nextCursorId;
+		if (m_nextCursorId == 0)
+		{
+			m_nextCursorId = 1;
+		}
+
+		m_queryCursors[cursorId] = cursor;
+		m_queryCursors[cursorId].m_position = 0;
+		m_queryCursors[cursorId].m_accessTime = time(NULL);
+
+		// Don't let clients open an unlimited number of cursors
+		expire_query_cursors(time(NULL), 64);
+		if (m_queryCursors.find(cursorId) == m_queryCursors.end())
+		{
+			cursorId = 0;
+		}
+
+		pthread_mutex_unlock(&m_cursorsMutex);
+	}
+
+	return cursorId;
+}
+
+bool DaemonState::fetch_query_cursor(unsigned int cursorId, DBusQueryCursor &cursor)
+{
+	bool foundCursor = false;
+
+	if (pthread_mutex_lock(&m_cursorsMutex) == 0)
+	{
+		map<unsigned int, DBusQueryCursor>::iterator cursorIter = m_queryCursors.find(cursorId);
+		if (cursorIter != m_queryCursors.end())
+		{
+			// The position only moves on once this page was retrieved
+			cursor = cursorIter->second;
+			cursorIter->second.m_accessTime = time(NULL);
+			foundCursor = true;
+		}
+
+		pthread_mutex_unlock(&m_cursorsMutex);
+	}
+
+	return foundCursor;
+}
+
+bool DaemonState::advance_query_cursor(unsigned int cursorId, unsigned int position,
+	unsigned int count)
+{
+	bool advancedCursor = false;
+
+	if (pthread_mutex_lock(&m_cursorsMutex) == 0)
+	{
+		map<unsigned int, DBusQueryCursor>::iterator cursorIter = m_queryCursors.find(cursorId);
+		// Another fetch of the same page may have moved it on already
+		if ((cursorIter != m_queryCursors.end()) &&
+			(cursorIter->second.m_position == position))
+		{
+			cursorIter->second.m_position += count;
+			cursorIter->second.m_accessTime = time(NULL);
+			advancedCursor = true;
+		}
+
+		pthread_mutex_unlock(&m_cursorsMutex);
+	}
+
+	return advancedCursor;
+}
+
+bool DaemonState::close_query_cursor(unsigned int cursorId)
+{
+	bool closedCursor = false;
+
+	if (pthread_mutex_lock(&m_cursorsMutex) == 0)
+	{
+		map<unsigned int, DBusQueryCursor>::iterator cursorIter = m_queryCursors.find(cursorId);
+		if (cursorIter != m_queryCursors.end())
+		{
+			m_queryCursors.erase(cursorIter);
+			closedCursor = true;
+		}
+
+		pthread_mutex_unlock(&m_cursorsMutex);
+	}
+
+	return closedCursor;
+}
+#endif
+
@@ -20,9 +20,12 @@
 #define _DAEMONSTATE_HH
 
 #include <sys/select.h>
+#include <time.h>
+#include <pthread.h>
 #include <string>
 #include <queue>
 #include <set>
+#include <map>
 #include <sigc++/sigc++.h>
 
 #include "CrawlHistory.h"
@@ -32,6 +35,9 @@
 #include "MonitorInterface.h"
 #include "MonitorHandler.h"
 #include "PinotSettings.h"
+#include "QueryProperties.h"
+#include "Timer.h"
+#include "WorkerPool.h"
 #include "WorkerThreads.h"
 
 #ifdef HAVE_DBUS
@@ -52,15 +58,62 @@ class DBusServletInfo
 
 		bool reply(void);
 
+		/// Returns true if the request is for a method that should be answered right away.
+		bool isInteractive(void) const;
+
+		/// Latencies of a method.
+		class MethodLatency
+		{
+			public:
+				MethodLatency();
+				MethodLatency(const MethodLatency &other);
+				~MethodLatency();
+
+				MethodLatency &operator=(const MethodLatency &other);
+
+				unsigned int m_callsCount;
+				unsigned long m_totalTime;
+				unsigned long m_maxTime;
+
+		};
+
+		/// Gets the latencies of methods replied to so far, in milliseconds.
+		static void getLatencies(std::map<std::string, MethodLatency> &latencies);
+
 		DBusConnection *m_pConnection;
 		DBusMessage *m_pRequest;
 		DBusMessage *m_pReply;
 		GPtrArray *m_pArray;
 		bool m_simpleQuery;
+		std::set<std::string> m_fields;
 		WorkerThread *m_pThread;
+		unsigned int m_cursorId;
+		unsigned int m_cursorPosition;
+		unsigned int m_cursorCount;
 
 	protected:
+		static pthread_mutex_t m_latenciesMutex;
+		static std::map<std::string, MethodLatency> m_latencies;
 		bool m_replied;
+		Timer m_replyTimer;
+
+};
+
+/// A query whose results are fetched a page at a time.
+class DBusQueryCursor
+{
+	public:
+		DBusQueryCursor();
+		DBusQueryCursor(const DBusQueryCursor &other);
+		~DBusQueryCursor();
+
+		DBusQueryCursor &operator=(const DBusQueryCursor &other);
+
+		std::string m_engineType;
+		std::string m_engineOption;
+		QueryProperties m_queryProps;
+		unsigned int m_position;
+		time_t m_accessTime;
 
 };
 #endif
@@ -93,6 +146,19 @@ class DaemonState : public QueueManager
 
 		void reset_flag(StatusFlag flag);
 
+#ifdef HAVE_DBUS
+		bool start_servlet(DBusServletInfo *pInfo);
+
+		unsigned int open_query_cursor(const DBusQueryCursor &cursor);
+
+		bool fetch_query_cursor(unsigned int cursorId, DBusQueryCursor &cursor);
+
+		bool advance_query_cursor(unsigned int cursorId, unsigned int position,
+			unsigned int count);
+
+		bool close_query_cursor(unsigned int cursorId);
+#endif
+
 	protected:
 		bool m_isReindex;
 		bool m_reload;
@@ -107,6 +173,11 @@ class DaemonState : public QueueManager
 		std::queue<PinotSettings::IndexableLocation> m_crawlQueue;
 #ifdef HAVE_DBUS
 		std::set<DBusServletInfo *> m_servletsInfo;
+		WorkerPool *m_pInteractivePool;
+		WorkerPool *m_pBulkPool;
+		pthread_mutex_t m_cursorsMutex;
+		std::map<unsigned int, DBusQueryCursor> m_queryCursors;
+		unsigned int m_nextCursorId;
 #endif
 
 		bool on_activity_timeout(void);
@@ -117,6 +188,12 @@ class DaemonState : public QueueManager
 
 		void flush_and_reclaim(void);
 
+		bool pools_are_idle(void);
+
+#ifdef HAVE_DBUS
+		void expire_query_cursors(time_t timeNow, unsigned int maxCursors);
+#endif
+
 };
 
 #endif // _DAEMONSTATE_HH
@@ -29,7 +29,6 @@
 #include "MIMEScanner.h"
 #include "StringManip.h"
 #include "Url.h"
-#include "FilterWrapper.h"
 #include "PinotSettings.h"
 #include "OnDiskHandler.h"
 
@@ -69,7 +68,8 @@ OnDiskHandler::~OnDiskHandler()
 bool OnDiskHandler::fileMoved(const string &fileName, const string &previousFileName,
 	IndexInterface::NameType type)
 {
-	set<unsigned int> docIdList;
+	string location(string("file://") + fileName);
+	string previousLocation(string("file://") + previousFileName);
 	bool handledEvent = false;
 
 #ifdef DEBUG
@@ -81,64 +81,18 @@ bool OnDiskHandler::fileMoved(const string &fileName, const string &previousFile
 	}
 
 	pthread_mutex_lock(&m_mutex);
-	// Get a list of documents in that directory/file
+	// Move the directory/file and all of its documents at once
 	if (type == IndexInterface::BY_FILE)
 	{
-		m_pIndex->listDocuments(string("file://") + previousFileName, docIdList, type);
+		handledEvent = m_pIndex->moveDocuments(previousLocation, location, type);
 	}
 	else
 	{
-		m_pIndex->listDocuments(previousFileName, docIdList, type);
+		handledEvent = m_pIndex->moveDocuments(previousFileName, fileName, type);
 	}
-	// ...and the directory/file itself
-	unsigned int baseDocId = m_pIndex->hasDocument(string("file://") + previousFileName);
-	if (baseDocId > 0)
-	{
-		docIdList.insert(baseDocId);
-	}
-	if (docIdList.empty() == false)
+	if (handledEvent == true)
 	{
-		for (set<unsigned int>::const_iterator iter = docIdList.begin();
-			iter != docIdList.end(); ++iter)
-		{
-			DocumentInfo docInfo;
-
-#ifdef DEBUG
-			clog << "OnDiskHandler::fileMoved: moving " << *iter << endl;
-#endif
-			if (m_pIndex->getDocumentInfo(*iter, docInfo) == true)
-			{
-				string newLocation(docInfo.getLocation());
-
-				if (baseDocId == *iter)
-				{
-					Url previousUrlObj(previousFileName), urlObj(fileName);
-
-					// Update the title if it was the directory/file name
-					if (docInfo.getTitle() == previousUrlObj.getFile())
-					{
-						docInfo.setTitle(urlObj.getFile());
-					}
-				}
-
-				string::size_type pos = newLocation.find(previousFileName);
-				if (pos != string::npos)
-				{
-					newLocation.replace(pos, previousFileName.length(), fileName);
-
-					// Change the location
-					docInfo.setLocation(newLocation);
-
-					handledEvent = replaceFile(*iter, docInfo);
-#ifdef DEBUG
-					clog << "OnDiskHandler::fileMoved: moved " << *iter << ", " << docInfo.getLocation() << endl;
-#endif
-				}
-#ifdef DEBUG
-				else clog << "OnDiskHandler::fileMoved: skipping " << newLocation << endl;
-#endif
-			}
-		}
+		m_history.moveItems(previousLocation, location);
 	}
 #ifdef DEBUG
 	else clog << "OnDiskHandler::fileMoved: no documents in " << previousFileName << endl;
@@ -241,21 +195,6 @@ bool OnDiskHandler::indexFile(const string &fileName, bool isDirectory, unsigned
 	return true;
 }
 
-bool OnDiskHandler::replaceFile(unsigned int docId, DocumentInfo &docInfo)
-{
-	if (m_pIndex == NULL)
-	{
-		return false;
-	}
-
-	// Unindex the destination file
-	FilterWrapper wrapFilter(m_pIndex);
-	wrapFilter.unindexDocument(docInfo.getLocation());
-
-	// Update the document info
-	return m_pIndex->updateDocumentInfo(docId, docInfo);
-}
-
 void OnDiskHandler::initialize(void)
 {
 	set<string> directories;
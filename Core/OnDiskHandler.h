@@ -84,8 +84,6 @@ class OnDiskHandler : public MonitorHandler
 
 		bool indexFile(const std::string &fileName, bool isDirectory, unsigned int &sourceId);
 
-		bool replaceFile(unsigned int docId, DocumentInfo &docInfo);
-
 	private:
 		OnDiskHandler(const OnDiskHandler &other);
 		OnDiskHandler &operator=(const OnDiskHandler &other);
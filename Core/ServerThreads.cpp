@@ -16,6 +16,7 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -41,6 +42,9 @@
 #include "PinotSettings.h"
 #include "ServerThreads.h"
 
+// Same as the largest number of results the UI lets users ask for
+#define MAX_FETCHED_RESULTS_COUNT 1000
+
 using namespace Glib;
 using namespace std;
 
@@ -170,6 +174,14 @@ string CrawlerThread::getType(void) const
 
 void CrawlerThread::recordCrawled(const string &location, time_t itemDate)
 {
+	// It may not have been inserted yet
+	map<string, CrawlItem>::iterator insertIter = m_insertCache.find(location);
+	if (insertIter != m_insertCache.end())
+	{
+		insertIter->second.m_itemStatus = CrawlHistory::CRAWLED;
+		return;
+	}
+
 	// It may still be in the cache
 	map<string, CrawlItem>::iterator updateIter = m_crawlCache.find(location);
 	if (updateIter != m_crawlCache.end())
@@ -223,16 +235,68 @@ bool CrawlerThread::wasCrawled(const string &location, time_t &itemDate)
 
 		return true;
 	}
+	// ...or about to be inserted ?
+	updateIter = m_insertCache.find(location);
+	if (updateIter != m_insertCache.end())
+	{
+		itemDate = updateIter->second.m_itemDate;
+
+		return true;
+	}
+
+	string::size_type slashPos = location.find_last_of("/");
+	if ((slashPos == string::npos) ||
+		(slashPos <= 7))
+	{
+		return m_crawlHistory.hasItem(location, itemStatus, itemDate);
+	}
+
+	// Load all of this directory's items in one go
+	string dirUrl(location.substr(0, slashPos));
+	map<string, map<string, CrawlItem> >::iterator dirIter = m_historyCache.find(dirUrl);
+	if (dirIter == m_historyCache.end())
+	{
+		// Forget about directories that aren't above this one
+		dirIter = m_historyCache.begin();
+		while (dirIter != m_historyCache.end())
+		{
+			if ((dirUrl.length() > dirIter->first.length()) &&
+				(dirUrl[dirIter->first.length()] == '/') &&
+				(dirUrl.compare(0, dirIter->first.length(), dirIter->first) == 0))
+			{
+				++dirIter;
+			}
+			else
+			{
+				m_historyCache.erase(dirIter++);
+			}
+		}
+
+		dirIter = m_historyCache.insert(pair<string, map<string, CrawlItem> >(dirUrl, map<string, CrawlItem>())).first;
+		m_crawlHistory.getDirectoryItems(dirUrl, dirIter->second);
+	}
+
+	map<string, CrawlItem>::const_iterator itemIter = dirIter->second.find(location);
+	if (itemIter != dirIter->second.end())
+	{
+		itemDate = itemIter->second.m_itemDate;
+
+		return true;
+	}
 
-	return m_crawlHistory.hasItem(location, itemStatus, itemDate);
+	return false;
 }
 
 void CrawlerThread::recordCrawling(const string &location, bool itemExists, time_t &itemDate)
 {
 	if (itemExists == false)
 	{
-		// Record it
-		m_crawlHistory.insertItem(location, CrawlHistory::CRAWLING, m_sourceId, itemDate);
+		// Record it with the next batch
+		m_insertCache[location] = CrawlItem(CrawlHistory::CRAWLING, itemDate, 0);
+		if (m_insertCache.size() > 500)
+		{
+			flushUpdates();
+		}
 	}
 	else
 	{
@@ -247,6 +311,16 @@ void CrawlerThread::recordCrawling(const string &location, bool itemExists, time
 
 void CrawlerThread::recordError(const string &location, int errorCode)
 {
+	// It may not have been inserted yet
+	map<string, CrawlItem>::iterator insertIter = m_insertCache.find(location);
+	if (insertIter != m_insertCache.end())
+	{
+		insertIter->second.m_itemStatus = CrawlHistory::CRAWL_ERROR;
+		insertIter->second.m_itemDate = time(NULL);
+		insertIter->second.m_errNum = errorCode;
+		return;
+	}
+
 	// It may still be in the cache
 	map<string, CrawlItem>::iterator updateIter = m_crawlCache.find(location);
 	if (updateIter != m_crawlCache.end())
@@ -267,7 +341,11 @@ void CrawlerThread::recordError(const string &location, int errorCode)
 
 void CrawlerThread::recordSymlink(const string &location, time_t itemDate)
 {
-	m_crawlHistory.insertItem(location, CrawlHistory::CRAWL_LINK, m_sourceId, itemDate);
+	m_insertCache[location] = CrawlItem(CrawlHistory::CRAWL_LINK, itemDate, 0);
+	if (m_insertCache.size() > 500)
+	{
+		flushUpdates();
+	}
 }
 
 bool CrawlerThread::monitorEntry(const string &entryName)
@@ -300,6 +378,30 @@ void CrawlerThread::flushUpdates(void)
 	clog << "CrawlerThread::flushUpdates: flushing updates" << endl;
 #endif
 
+	// Insert new records in one transaction
+	if (m_insertCache.empty() == false)
+	{
+		m_crawlHistory.insertItems(m_insertCache, m_sourceId);
+
+		// Directories already loaded have to know about these
+		for (map<string, CrawlItem>::const_iterator insertIter = m_insertCache.begin();
+			insertIter != m_insertCache.end(); ++insertIter)
+		{
+			string::size_type slashPos = insertIter->first.find_last_of("/");
+
+			if (slashPos != string::npos)
+			{
+				map<string, map<string, CrawlItem> >::iterator dirIter = m_historyCache.find(insertIter->first.substr(0, slashPos));
+
+				if (dirIter != m_historyCache.end())
+				{
+					dirIter->second[insertIter->first] = insertIter->second;
+				}
+			}
+		}
+		m_insertCache.clear();
+	}
+
 	// Update these records
 	m_crawlHistory.updateItems(m_crawlCache);
 	m_crawlCache.clear();
@@ -339,6 +441,7 @@ void CrawlerThread::doWork(void)
 		m_errorParam = m_dirName;
 	}
 	flushUpdates();
+	m_historyCache.clear();
 
 	clog << "Scanned " << m_dirName << " in " << scanTimer.stop() << " ms" << endl;
 
@@ -525,6 +628,49 @@ void DBusServletThread::doWork(void)
 				DBUS_TYPE_INVALID);
 		}
 	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "GetLatencies") == TRUE)
+	{
+#ifdef DEBUG
+		clog << "DBusServletThread::doWork: received GetLatencies" << endl;
+#endif
+		// Prepare the reply
+		if (m_pServletInfo->newReply() == true)
+		{
+			map<string, DBusServletInfo::MethodLatency> latencies;
+			DBusMessageIter iter, arrayIter, structIter;
+
+			DBusServletInfo::getLatencies(latencies);
+			dbus_message_iter_init_append(m_pServletInfo->m_pReply, &iter);
+			dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+				DBUS_STRUCT_BEGIN_CHAR_AS_STRING \
+				DBUS_TYPE_STRING_AS_STRING \
+				DBUS_TYPE_UINT32_AS_STRING \
+				DBUS_TYPE_UINT32_AS_STRING \
+				DBUS_TYPE_UINT32_AS_STRING \
+				DBUS_STRUCT_END_CHAR_AS_STRING, &arrayIter);
+			for (map<string, DBusServletInfo::MethodLatency>::const_iterator latencyIter = latencies.begin();
+				latencyIter != latencies.end(); ++latencyIter)
+			{
+				const char *pMethodName = latencyIter->first.c_str();
+				dbus_uint32_t callsCount = latencyIter->second.m_callsCount;
+				dbus_uint32_t averageTime = 0;
+				dbus_uint32_t maxTime = (dbus_uint32_t)latencyIter->second.m_maxTime;
+
+				if (callsCount > 0)
+				{
+					averageTime = (dbus_uint32_t)(latencyIter->second.m_totalTime / callsCount);
+				}
+
+				dbus_message_iter_open_container(&arrayIter, DBUS_TYPE_STRUCT, NULL, &structIter);
+				dbus_message_iter_append_basic(&structIter, DBUS_TYPE_STRING, &pMethodName);
+				dbus_message_iter_append_basic(&structIter, DBUS_TYPE_UINT32, &callsCount);
+				dbus_message_iter_append_basic(&structIter, DBUS_TYPE_UINT32, &averageTime);
+				dbus_message_iter_append_basic(&structIter, DBUS_TYPE_UINT32, &maxTime);
+				dbus_message_iter_close_container(&arrayIter, &structIter);
+			}
+			dbus_message_iter_close_container(&iter, &arrayIter);
+		}
+	}
 	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "Reload") == TRUE)
 	{
 		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
@@ -598,6 +744,65 @@ void DBusServletThread::doWork(void)
 			}
 		}
 	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "HasDocuments") == TRUE)
+	{
+		char **ppUrls = NULL;
+		dbus_uint32_t urlsCount = 0;
+
+		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
+			DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &ppUrls, &urlsCount,
+			DBUS_TYPE_INVALID) == TRUE)
+		{
+			set<string> urls;
+			vector<string> orderedUrls;
+			map<string, unsigned int> docIds;
+			vector<dbus_uint32_t> docIdsList;
+
+#ifdef DEBUG
+			clog << "DBusServletThread::doWork: received HasDocuments on " << urlsCount << " URLs" << endl;
+#endif
+			for (dbus_uint32_t urlIndex = 0; urlIndex < urlsCount; ++urlIndex)
+			{
+				if (ppUrls[urlIndex] == NULL)
+				{
+					break;
+				}
+
+				urls.insert(ppUrls[urlIndex]);
+				orderedUrls.push_back(ppUrls[urlIndex]);
+			}
+
+			// Free container types
+			g_strfreev(ppUrls);
+
+			// Check the index once for all URLs
+			pIndex->hasDocuments(urls, docIds);
+
+			// Reply with IDs in the order URLs were given
+			docIdsList.reserve(orderedUrls.size());
+			for (vector<string>::const_iterator urlIter = orderedUrls.begin();
+				urlIter != orderedUrls.end(); ++urlIter)
+			{
+				map<string, unsigned int>::const_iterator docIter = docIds.find(*urlIter);
+
+				docIdsList.push_back((docIter == docIds.end()) ? 0 : docIter->second);
+			}
+
+			// Prepare the reply
+			if (m_pServletInfo->newReply() == true)
+			{
+				const dbus_uint32_t *pDocIds = NULL;
+
+				if (docIdsList.empty() == false)
+				{
+					pDocIds = &docIdsList[0];
+				}
+				dbus_message_append_args(m_pServletInfo->m_pReply,
+					DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32, &pDocIds, (int)docIdsList.size(),
+					DBUS_TYPE_INVALID);
+			}
+		}
+	}
 	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "GetLabels") == TRUE)
 	{
 #ifdef DEBUG
@@ -899,7 +1104,6 @@ void DBusServletThread::doWork(void)
 					dbus_message_iter_init_append(m_pServletInfo->m_pReply, &iter);
 					if (DBusIndex::documentInfoToDBus(&iter, 0, docInfo) == false)
 					{
-						dbus_message_unref(m_pServletInfo->m_pReply);
 						m_pServletInfo->newErrorReply("GetDocumentInfo",
 							"Unknown error");
 					}
@@ -912,6 +1116,69 @@ void DBusServletThread::doWork(void)
 			}
 		}
 	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "GetDocumentsInfo") == TRUE)
+	{
+		dbus_uint32_t *pDocIds = NULL;
+		int docIdsCount = 0;
+
+		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
+			DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32, &pDocIds, &docIdsCount,
+			DBUS_TYPE_INVALID) == TRUE)
+		{
+			set<unsigned int> docIds;
+			map<unsigned int, DocumentInfo> docsInfo;
+
+#ifdef DEBUG
+			clog << "DBusServletThread::doWork: received GetDocumentsInfo on " << docIdsCount << " documents" << endl;
+#endif
+			for (int docIndex = 0; docIndex < docIdsCount; ++docIndex)
+			{
+				docIds.insert(pDocIds[docIndex]);
+			}
+
+			// Get all documents with one lookup
+			pIndex->getDocumentsInfo(docIds, docsInfo);
+
+			// Prepare the reply
+			if (m_pServletInfo->newReply() == true)
+			{
+				DBusMessageIter iter, arrayIter, structIter;
+				bool appendedAll = true;
+
+				dbus_message_iter_init_append(m_pServletInfo->m_pReply, &iter);
+				dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_STRUCT_BEGIN_CHAR_AS_STRING \
+					DBUS_TYPE_UINT32_AS_STRING \
+					DBUS_TYPE_ARRAY_AS_STRING \
+					DBUS_STRUCT_BEGIN_CHAR_AS_STRING \
+					DBUS_TYPE_STRING_AS_STRING \
+					DBUS_TYPE_STRING_AS_STRING \
+					DBUS_STRUCT_END_CHAR_AS_STRING \
+					DBUS_STRUCT_END_CHAR_AS_STRING, &arrayIter);
+				for (map<unsigned int, DocumentInfo>::const_iterator docIter = docsInfo.begin();
+					docIter != docsInfo.end(); ++docIter)
+				{
+					dbus_message_iter_open_container(&arrayIter, DBUS_TYPE_STRUCT, NULL, &structIter);
+					if (DBusIndex::documentInfoToDBus(&structIter, docIter->first, docIter->second) == false)
+					{
+						appendedAll = false;
+						break;
+					}
+					dbus_message_iter_close_container(&arrayIter, &structIter);
+				}
+
+				if (appendedAll == false)
+				{
+					m_pServletInfo->newErrorReply("GetDocumentsInfo",
+						"Unknown error");
+				}
+				else
+				{
+					dbus_message_iter_close_container(&iter, &arrayIter);
+				}
+			}
+		}
+	}
 	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "SetDocumentInfo") == TRUE)
 	{
 		DBusMessageIter iter;
@@ -1002,6 +1269,181 @@ void DBusServletThread::doWork(void)
 			}
 		}
 	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "OpenQuery") == TRUE)
+	{
+		char *pSearchText = NULL;
+		char *pEngineType = NULL;
+		char *pEngineOption = NULL;
+		dbus_uint32_t maxHits = 0;
+
+		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
+			DBUS_TYPE_STRING, &pEngineType,
+			DBUS_TYPE_STRING, &pEngineOption,
+			DBUS_TYPE_STRING, &pSearchText,
+			DBUS_TYPE_UINT32, &maxHits,
+			DBUS_TYPE_INVALID) == TRUE)
+		{
+			dbus_uint32_t cursorId = 0;
+
+#ifdef DEBUG
+			clog << "DBusServletThread::doWork: received OpenQuery " << pSearchText << ", " << maxHits << endl;
+#endif
+			if (pSearchText != NULL)
+			{
+				DBusQueryCursor cursor;
+				stringstream queryNameStr;
+
+				// Give the query a unique name
+				queryNameStr << "DBUS" << m_id;
+
+				cursor.m_queryProps = QueryProperties(queryNameStr.str(), pSearchText);
+				cursor.m_queryProps.setMaximumResultsCount(maxHits);
+
+				// Provide reasonable defaults 
+				if (((pEngineType == NULL) || (strlen(pEngineType) == 0)) &&
+					((pEngineOption == NULL) || (strlen(pEngineOption) == 0)))
+				{
+					cursor.m_engineType = settings.m_defaultBackend;
+					cursor.m_engineOption = settings.m_daemonIndexLocation;
+				}
+				else
+				{
+					cursor.m_engineType = pEngineType;
+					cursor.m_engineOption = pEngineOption;
+				}
+
+				// The query is only run when results are fetched
+				cursorId = m_pServer->open_query_cursor(cursor);
+			}
+
+			if (cursorId == 0)
+			{
+				m_pServletInfo->newErrorReply("OpenQuery",
+					"Query failed");
+			}
+			else if (m_pServletInfo->newReply() == true)
+			{
+				dbus_message_append_args(m_pServletInfo->m_pReply,
+					DBUS_TYPE_UINT32, &cursorId,
+					DBUS_TYPE_INVALID);
+			}
+		}
+	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "FetchQueryResults") == TRUE)
+	{
+		char **ppFields = NULL;
+		dbus_uint32_t cursorId = 0, count = 0, fieldsCount = 0;
+
+		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
+			DBUS_TYPE_UINT32, &cursorId,
+			DBUS_TYPE_UINT32, &count,
+			DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &ppFields, &fieldsCount,
+			DBUS_TYPE_INVALID) == TRUE)
+		{
+			DBusQueryCursor cursor;
+
+#ifdef DEBUG
+			clog << "DBusServletThread::doWork: received FetchQueryResults " << cursorId << ", " << count
+				<< ", " << fieldsCount << " fields" << endl;
+#endif
+			m_pServletInfo->m_simpleQuery = false;
+			for (dbus_uint32_t fieldIndex = 0; fieldIndex < fieldsCount; ++fieldIndex)
+			{
+				if (ppFields[fieldIndex] == NULL)
+				{
+					break;
+				}
+
+				m_pServletInfo->m_fields.insert(ppFields[fieldIndex]);
+			}
+
+			// Free container types
+			g_strfreev(ppFields);
+
+			if (m_pServer->fetch_query_cursor(cursorId, cursor) == false)
+			{
+				m_pServletInfo->newErrorReply("FetchQueryResults",
+					"Unknown cursor");
+			}
+			else
+			{
+				unsigned int maxHits = cursor.m_queryProps.getMaximumResultsCount();
+
+				// Don't go past the maximum number of hits
+				if (maxHits > 0)
+				{
+					if (cursor.m_position >= maxHits)
+					{
+						count = 0;
+					}
+					else if (cursor.m_position + count > maxHits)
+					{
+						count = maxHits - cursor.m_position;
+					}
+				}
+				// Don't let clients ask for arbitrarily large pages
+				if (count > MAX_FETCHED_RESULTS_COUNT)
+				{
+					count = MAX_FETCHED_RESULTS_COUNT;
+				}
+
+				if (count == 0)
+				{
+					vector<DocumentInfo> noResults;
+
+					m_pServletInfo->newQueryReply(noResults, 0);
+				}
+				else
+				{
+					EngineQueryThread *pQueryThread = NULL;
+
+					cursor.m_queryProps.setMaximumResultsCount(count);
+
+					// Only this page's extracts are generated, if they were asked for
+					pQueryThread = new EngineQueryThread(cursor.m_engineType,
+						cursor.m_engineType, cursor.m_engineOption,
+						cursor.m_queryProps, cursor.m_position);
+					if ((m_pServletInfo->m_fields.empty() == false) &&
+						(m_pServletInfo->m_fields.find("extract") == m_pServletInfo->m_fields.end()))
+					{
+						pQueryThread->setWithExtracts(false);
+					}
+
+					m_pServletInfo->m_pThread = pQueryThread;
+					m_pServletInfo->m_cursorId = cursorId;
+					m_pServletInfo->m_cursorPosition = cursor.m_position;
+					m_pServletInfo->m_cursorCount = count;
+				}
+			}
+		}
+	}
+	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "CloseQuery") == TRUE)
+	{
+		dbus_uint32_t cursorId = 0;
+
+		if (dbus_message_get_args(m_pServletInfo->m_pRequest, &error,
+			DBUS_TYPE_UINT32, &cursorId,
+			DBUS_TYPE_INVALID) == TRUE)
+		{
+			gboolean closed = FALSE;
+
+#ifdef DEBUG
+			clog << "DBusServletThread::doWork: received CloseQuery " << cursorId << endl;
+#endif
+			if (m_pServer->close_query_cursor(cursorId) == true)
+			{
+				closed = TRUE;
+			}
+
+			// Prepare the reply
+			if (m_pServletInfo->newReply() == true)
+			{
+				dbus_message_append_args(m_pServletInfo->m_pReply,
+					DBUS_TYPE_BOOLEAN, &closed,
+					DBUS_TYPE_INVALID);
+			}
+		}
+	}
 	// FIXME: this method will soon be obsoleted
 	else if (dbus_message_is_method_call(m_pServletInfo->m_pRequest, PINOT_DBUS_SERVICE_NAME, "SimpleQuery") == TRUE)
 	{
@@ -53,6 +53,8 @@ class CrawlerThread : public DirectoryScannerThread
 		MonitorHandler *m_pHandler;
 		CrawlHistory m_crawlHistory;
 		std::map<std::string, CrawlItem> m_crawlCache;
+		std::map<std::string, CrawlItem> m_insertCache;
+		std::map<std::string, std::map<std::string, CrawlItem> > m_historyCache;
 		std::stack<std::string> m_currentLinks;
 		std::stack<std::string> m_currentLinkReferrees;
 
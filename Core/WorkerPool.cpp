@@ -0,0 +1,191 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <iostream>
+
+#include "WorkerThread.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+pthread_mutex_t WorkerPool::m_poolMutex = PTHREAD_MUTEX_INITIALIZER;
+WorkerPool *WorkerPool::m_pInstance = NULL;
+
+WorkerPool::WorkerPool(unsigned int workersCount, unsigned int maxQueuedTasks) :
+	m_maxQueuedTasks(maxQueuedTasks),
+	m_stopping(false)
+{
+	pthread_mutex_init(&m_queuedMutex, NULL);
+	pthread_cond_init(&m_queuedCond, NULL);
+
+	for (unsigned int workerNum = 0; workerNum < workersCount; ++workerNum)
+	{
+		pthread_t threadId;
+
+		if (pthread_create(&threadId, NULL, WorkerPool::workerRoutine, (void *)this) != 0)
+		{
+			clog << "Couldn't create worker " << workerNum << endl;
+			break;
+		}
+
+		m_workers.push_back(threadId);
+	}
+#ifdef DEBUG
+	clog << "WorkerPool: " << m_workers.size() << " workers" << endl;
+#endif
+}
+
+WorkerPool::~WorkerPool()
+{
+	// Let workers run what's queued, then wait for them to exit
+	if (pthread_mutex_lock(&m_queuedMutex) == 0)
+	{
+		m_stopping = true;
+		pthread_cond_broadcast(&m_queuedCond);
+
+		pthread_mutex_unlock(&m_queuedMutex);
+	}
+	for (vector<pthread_t>::iterator workerIter = m_workers.begin();
+		workerIter != m_workers.end(); ++workerIter)
+	{
+		pthread_join(*workerIter, NULL);
+	}
+
+	pthread_cond_destroy(&m_queuedCond);
+	pthread_mutex_destroy(&m_queuedMutex);
+}
+
+/// Returns the pool, creating it with the given number of workers if necessary.
+WorkerPool *WorkerPool::getPool(unsigned int workersCount)
+{
+	WorkerPool *pPool = NULL;
+
+	if (pthread_mutex_lock(&m_poolMutex) == 0)
+	{
+		if (m_pInstance == NULL)
+		{
+			if (workersCount == 0)
+			{
+				workersCount = 1;
+			}
+
+			// Let each worker have a few tasks lined up
+			m_pInstance = new WorkerPool(workersCount, workersCount * 64);
+			if (m_pInstance->getWorkersCount() == 0)
+			{
+				delete m_pInstance;
+				m_pInstance = NULL;
+			}
+		}
+		pPool = m_pInstance;
+
+		pthread_mutex_unlock(&m_poolMutex);
+	}
+
+	return pPool;
+}
+
+/// Queues a task; false if the queue is full.
+bool WorkerPool::push(WorkerThread *pTask)
+{
+	bool pushedTask = false;
+
+	if ((pTask == NULL) ||
+		(m_workers.empty() == true))
+	{
+		return false;
+	}
+
+	if (pthread_mutex_lock(&m_queuedMutex) == 0)
+	{
+		if ((m_stopping == false) &&
+			(m_tasks.size() < m_maxQueuedTasks))
+		{
+			m_tasks.push_back(pTask);
+
+			pthread_cond_signal(&m_queuedCond);
+			pushedTask = true;
+		}
+#ifdef DEBUG
+		else clog << "WorkerPool::push: " << m_tasks.size() << " tasks already queued" << endl;
+#endif
+
+		pthread_mutex_unlock(&m_queuedMutex);
+	}
+
+	return pushedTask;
+}
+
+/// Returns the number of workers.
+unsigned int WorkerPool::getWorkersCount(void) const
+{
+	return (unsigned int)m_workers.size();
+}
+
+/// Returns the number of tasks waiting for a worker.
+unsigned int WorkerPool::getQueuedCount(void)
+{
+	unsigned int queuedCount = 0;
+
+	if (pthread_mutex_lock(&m_queuedMutex) == 0)
+	{
+		queuedCount = (unsigned int)m_tasks.size();
+
+		pthread_mutex_unlock(&m_queuedMutex);
+	}
+
+	return queuedCount;
+}
+
+void *WorkerPool::workerRoutine(void *pData)
+{
+	WorkerPool *pPool = static_cast<WorkerPool *>(pData);
+
+	if (pPool == NULL)
+	{
+		return NULL;
+	}
+
+	while (true)
+	{
+		WorkerThread *pTask = NULL;
+
+		// Wait for a task, oldest first
+		if (pthread_mutex_lock(&pPool->m_queuedMutex) != 0)
+		{
+			break;
+		}
+		while ((pPool->m_tasks.empty() == true) &&
+			(pPool->m_stopping == false))
+		{
+			pthread_cond_wait(&pPool->m_queuedCond, &pPool->m_queuedMutex);
+		}
+		if (pPool->m_tasks.empty() == true)
+		{
+			// The pool is stopping
+			pthread_mutex_unlock(&pPool->m_queuedMutex);
+			break;
+		}
+		pTask = pPool->m_tasks.front();
+		pPool->m_tasks.pop_front();
+		pthread_mutex_unlock(&pPool->m_queuedMutex);
+
+		// Tasks stopped while queued are signaled without running
+		pTask->threadHandler();
+	}
+
+	return NULL;
+}
@@ -0,0 +1,63 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _WORKERPOOL_HH
+#define _WORKERPOOL_HH
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+class WorkerThread;
+
+/// A fixed-size pool of threads that run WorkerThread tasks.
+class WorkerPool
+{
+	public:
+		WorkerPool(unsigned int workersCount, unsigned int maxQueuedTasks);
+		virtual ~WorkerPool();
+
+		/// Returns the pool, creating it with the given number of workers if necessary.
+		static WorkerPool *getPool(unsigned int workersCount);
+
+		/// Queues a task; false if the queue is full.
+		bool push(WorkerThread *pTask);
+
+		/// Returns the number of workers.
+		unsigned int getWorkersCount(void) const;
+
+		/// Returns the number of tasks waiting for a worker.
+		unsigned int getQueuedCount(void);
+
+	protected:
+		static pthread_mutex_t m_poolMutex;
+		static WorkerPool *m_pInstance;
+		std::vector<pthread_t> m_workers;
+		pthread_mutex_t m_queuedMutex;
+		pthread_cond_t m_queuedCond;
+		std::deque<WorkerThread *> m_tasks;
+		unsigned int m_maxQueuedTasks;
+		bool m_stopping;
+
+		static void *workerRoutine(void *pData);
+
+	private:
+		WorkerPool(const WorkerPool &other);
+		WorkerPool &operator=(const WorkerPool &other);
+
+};
+
+#endif // _WORKERPOOL_HH
@@ -43,6 +43,7 @@
 #include "NLS.h"
 #include "Memory.h"
 #include "Url.h"
+#include "WorkerPool.h"
 #include "WorkerThread.h"
 
 using namespace std;
@@ -64,6 +65,7 @@ public:
 
 Dispatcher WorkerThread::m_dispatcher;
 pthread_mutex_t WorkerThread::m_dispatcherMutex = PTHREAD_MUTEX_INITIALIZER;
+set<unsigned int> WorkerThread::m_doneIds;
 bool WorkerThread::m_immediateFlush = true;
 
 string WorkerThread::errorToString(int errorNum)
@@ -132,6 +134,7 @@ WorkerThread::WorkerThread() :
 	m_startTime(time(NULL)),
 	m_id(ThreadsManager::get_next_id()),
 	m_background(false),
+	m_onPool(false),
 	m_stopped(false),
 	m_done(false),
 	m_errorNum(0)
@@ -142,6 +145,33 @@ WorkerThread::~WorkerThread()
 {
 }
 
+WorkerThread *WorkerThread::popEndedThread(map<unsigned int, WorkerThread *> &threads)
+{
+	WorkerThread *pWorkerThread = NULL;
+
+	if (pthread_mutex_lock(&m_dispatcherMutex) == 0)
+	{
+		for (set<unsigned int>::iterator idIter = m_doneIds.begin();
+			idIter != m_doneIds.end(); ++idIter)
+		{
+			map<unsigned int, WorkerThread *>::iterator threadIter = threads.find(*idIter);
+
+			// Threads that belong to another manager are left alone
+			if (threadIter != threads.end())
+			{
+				pWorkerThread = threadIter->second;
+				threads.erase(threadIter);
+				m_doneIds.erase(idIter);
+				break;
+			}
+		}
+
+		pthread_mutex_unlock(&m_dispatcherMutex);
+	}
+
+	return pWorkerThread;
+}
+
 time_t WorkerThread::getStartTime(void) const
 {
 	return m_startTime;
@@ -167,6 +197,16 @@ bool WorkerThread::isBackground(void) const
 	return m_background;
 }
 
+void WorkerThread::onPool(void)
+{
+	m_onPool = true;
+}
+
+bool WorkerThread::isOnPool(void) const
+{
+	return m_onPool;
+}
+
 bool WorkerThread::operator<(const WorkerThread &other) const
 {
 	return m_id < other.m_id;
@@ -181,6 +221,11 @@ Glib::Thread *WorkerThread::start(void)
 	return Thread::create(sigc::mem_fun(*this, &WorkerThread::threadHandler), false);
 }
 
+bool WorkerThread::isPooled(void) const
+{
+	return false;
+}
+
 void WorkerThread::stop(void)
 {
 	m_stopped = m_done = true;
@@ -223,7 +268,11 @@ void WorkerThread::threadHandler(void)
 #endif
 	try
 	{
-		doWork();
+		// Pooled threads may have been stopped before they had a chance to run
+		if (m_stopped == false)
+		{
+			doWork();
+		}
 	}
 	catch (Glib::Exception &ex)
 	{
@@ -248,12 +297,14 @@ void WorkerThread::threadHandler(void)
 
 void WorkerThread::emitSignal(void)
 {
-	m_done = true;
 	if (pthread_mutex_lock(&m_dispatcherMutex) == 0)
 	{
 #ifdef DEBUG
 		clog << "WorkerThread::emitSignal: signaling end of thread " << m_id << endl;
 #endif
+		// The ID is known before the thread is seen as done
+		m_doneIds.insert(m_id);
+		m_done = true;
 		m_dispatcher();
 
 		pthread_mutex_unlock(&m_dispatcherMutex);
@@ -268,8 +319,10 @@ ThreadsManager::ThreadsManager(const string &defaultIndexLocation,
 	m_defaultIndexLocation(defaultIndexLocation),
 	m_maxIndexThreads(1),
 	m_backgroundThreadsCount(0),
+	m_pooledThreadsCount(0),
 	m_foregroundThreadsMaxTime(maxThreadsTime),
-	m_numCPUs(1)
+	m_numCPUs(1),
+	m_lastThreadsCheck(time(NULL))
 {
 	pthread_rwlock_init(&m_threadsLock, NULL);
 	pthread_rwlock_init(&m_listsLock, NULL);
@@ -302,6 +355,10 @@ ThreadsManager::ThreadsManager(const string &defaultIndexLocation,
 	m_numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
 #endif
 #endif
+	if (m_numCPUs < 1)
+	{
+		m_numCPUs = 1;
+	}
 }
 
 ThreadsManager::~ThreadsManager()
@@ -367,23 +424,36 @@ WorkerThread *ThreadsManager::get_thread(void)
 	time_t timeNow = time(NULL);
 	WorkerThread *pWorkerThread = NULL;
 
-	// Get the first thread that's finished
 	if (write_lock_threads() == true)
 	{
-		for (map<unsigned int, WorkerThread *>::iterator threadIter = m_threads.begin();
-			threadIter != m_threads.end(); ++threadIter)
+		// Threads that signaled their end are known, no need to look for them
+		pWorkerThread = WorkerThread::popEndedThread(m_threads);
+		if ((pWorkerThread != NULL) &&
+			(pWorkerThread->isOnPool() == true))
 		{
-			unsigned int threadId = threadIter->first;
-
-			if (threadIter->second->isDone() == false)
-			{
+			--m_pooledThreadsCount;
+		}
 #ifdef DEBUG
-				clog << "ThreadsManager::get_thread: thread "
-					<< threadId << " is not done" << endl;
+		if (pWorkerThread != NULL)
+		{
+			clog << "ThreadsManager::get_thread: thread " << pWorkerThread->getId()
+				<< " signaled, " << m_threads.size() << " left" << endl;
+		}
 #endif
 
+		// Look for long-running threads every now and then
+		if (m_lastThreadsCheck + 10 < timeNow)
+		{
+			m_lastThreadsCheck = timeNow;
+
+			for (map<unsigned int, WorkerThread *>::iterator threadIter = m_threads.begin();
+				threadIter != m_threads.end(); ++threadIter)
+			{
+				unsigned int threadId = threadIter->first;
+
 				// Foreground threads ought not to run very long
-				if ((threadIter->second->isBackground() == false) &&
+				if ((threadIter->second->isDone() == false) &&
+					(threadIter->second->isBackground() == false) &&
 					(threadIter->second->getStartTime() + m_foregroundThreadsMaxTime < timeNow))
 				{
 					// This thread has been running for too long !
@@ -392,18 +462,6 @@ WorkerThread *ThreadsManager::get_thread(void)
 					clog << "Stopped long-running thread " << threadId << endl;
 				}
 			}
-			else
-			{
-				// This one will do...
-				pWorkerThread = threadIter->second;
-				// Remove it
-				m_threads.erase(threadIter);
-#ifdef DEBUG
-				clog << "ThreadsManager::get_thread: thread " << threadId
-					<< " is done, " << m_threads.size() << " left" << endl;
-#endif
-				break;
-			}
 		}
 
 		unlock_threads();
@@ -442,7 +500,7 @@ unsigned int ThreadsManager::get_next_id(void)
 
 bool ThreadsManager::start_thread(WorkerThread *pWorkerThread, bool inBackground)
 {
-	bool createdThread = false;
+	WorkerPool *pPool = NULL;
 
 	if (pWorkerThread == NULL)
 	{
@@ -463,6 +521,39 @@ bool ThreadsManager::start_thread(WorkerThread *pWorkerThread, bool inBackground
 			<< " will run in the foreground" << endl;
 #endif
 
+	// Short-lived threads run on the pool, others get their own thread
+	if ((inBackground == false) &&
+		(pWorkerThread->isPooled() == true))
+	{
+		pPool = WorkerPool::getPool((unsigned int)max(m_numCPUs, (long)m_maxIndexThreads));
+		if (pPool == NULL)
+		{
+			delete pWorkerThread;
+			return false;
+		}
+	}
+
+	return run_thread(pWorkerThread, pPool);
+}
+
+/// Runs the thread on the given pool, or on its own if there's none.
+bool ThreadsManager::start_pooled_thread(WorkerThread *pWorkerThread, WorkerPool *pPool)
+{
+	if (pWorkerThread == NULL)
+	{
+		return false;
+	}
+
+	// Servlets and queries don't take up any of the indexing threads
+	pWorkerThread->onPool();
+
+	return run_thread(pWorkerThread, pPool);
+}
+
+bool ThreadsManager::run_thread(WorkerThread *pWorkerThread, WorkerPool *pPool)
+{
+	bool createdThread = false;
+
 	// Insert
 	pair<map<unsigned int, WorkerThread *>::iterator, bool> threadPair;
 	if (write_lock_threads() == true)
@@ -473,6 +564,10 @@ bool ThreadsManager::start_thread(WorkerThread *pWorkerThread, bool inBackground
 			delete pWorkerThread;
 			pWorkerThread = NULL;
 		}
+		else if (pWorkerThread->isOnPool() == true)
+		{
+			++m_pooledThreadsCount;
+		}
 
 		unlock_threads();
 	}
@@ -480,17 +575,28 @@ bool ThreadsManager::start_thread(WorkerThread *pWorkerThread, bool inBackground
 	// Start the thread
 	if (pWorkerThread != NULL)
 	{
-		Thread *pThread = pWorkerThread->start();
-		if (pThread != NULL)
+		if (pPool != NULL)
+		{
+			if (pPool->push(pWorkerThread) == true)
+			{
+				createdThread = true;
+			}
+		}
+		else if (pWorkerThread->start() != NULL)
 		{
 			createdThread = true;
 		}
-		else
+
+		if (createdThread == false)
 		{
 			// Erase
 			if (write_lock_threads() == true)
 			{
 				m_threads.erase(threadPair.first);
+				if (pWorkerThread->isOnPool() == true)
+				{
+					--m_pooledThreadsCount;
+				}
 
 				unlock_threads();
 			}
@@ -521,6 +627,21 @@ unsigned int ThreadsManager::get_threads_count(void)
 	return (unsigned int)max(count , 0);
 }
 
+/// Returns the number of foreground threads that aren't on a pool.
+unsigned int ThreadsManager::get_indexing_threads_count(void)
+{
+	int count = 0;
+
+	if (read_lock_threads() == true)
+	{
+		count = m_threads.size() - m_backgroundThreadsCount - m_pooledThreadsCount;
+
+		unlock_threads();
+	}
+
+	return (unsigned int)max(count , 0);
+}
+
 void ThreadsManager::stop_threads(void)
 {
 	if (m_threads.empty() == false)
@@ -596,10 +717,25 @@ MonitorThread::MonitorThread(MonitorInterface *pMonitor, MonitorHandler *pHandle
 	m_ctrlReadPipe(-1),
 	m_ctrlWritePipe(-1),
 	m_pMonitor(pMonitor),
-	m_pHandler(pHandler)
+	m_pHandler(pHandler),
+	m_pCoalescer(NULL)
 {
+	unsigned int quietPeriod = 5;
 	int pipeFds[2];
 
+	// How long a file has to be left alone before its events are reported
+	char *pEnvVar = getenv("PINOT_MONITOR_QUIET_PERIOD");
+	if ((pEnvVar != NULL) &&
+		(strlen(pEnvVar) > 0))
+	{
+		int envQuietPeriod = atoi(pEnvVar);
+		if (envQuietPeriod >= 0)
+		{
+			quietPeriod = (unsigned int)envQuietPeriod;
+		}
+	}
+	m_pCoalescer = new EventCoalescer(quietPeriod, max(quietPeriod, (unsigned int)60));
+
 #ifdef HAVE_PIPE
 	if (pipe(pipeFds) == 0)
 	{
@@ -612,6 +748,7 @@ MonitorThread::MonitorThread(MonitorInterface *pMonitor, MonitorHandler *pHandle
 
 MonitorThread::~MonitorThread()
 {
+	delete m_pCoalescer;
 	if (m_ctrlReadPipe >= 0)
 	{
 		close(m_ctrlReadPipe);
@@ -629,7 +766,8 @@ string MonitorThread::getType(void) const
 
 void MonitorThread::stop(void)
 {
-	WorkerThread::stop();
+	// Events held back are reported before the thread is done
+	m_stopped = true;
 	if (m_ctrlWritePipe >= 0)
 	{
 		write(m_ctrlWritePipe, "X", 1);
@@ -647,27 +785,40 @@ void MonitorThread::fileModified(const string &location)
 	m_pHandler->fileModified(location);
 }
 
-void MonitorThread::processEvents(void)
+void MonitorThread::processEvents(bool flushAll)
 {
-	queue<MonitorEvent> events;
+	queue<MonitorEvent> newEvents, events;
 
 #ifdef DEBUG
 	clog << "MonitorThread::processEvents: checking for events" << endl;
 #endif
 	if ((m_pMonitor == NULL) ||
-		(m_pMonitor->retrievePendingEvents(events) == false))
+		(m_pMonitor->retrievePendingEvents(newEvents) == false))
 	{
 #ifdef DEBUG
 		clog << "MonitorThread::processEvents: failed to retrieve pending events" << endl;
 #endif
-		return;
+		// Events held back must still be reported
+		if (flushAll == false)
+		{
+			return;
+		}
 	}
+
+	// Collapse events on the same files, and hold them until these files are left alone
+	while (newEvents.empty() == false)
+	{
+		m_pCoalescer->push(newEvents.front());
+		newEvents.pop();
+	}
+	m_pCoalescer->pop(events, time(NULL), flushAll);
 #ifdef DEBUG
-	clog << "MonitorThread::processEvents: retrieved " << events.size() << " events" << endl;
+	clog << "MonitorThread::processEvents: " << events.size() << " events to process, "
+		<< m_pCoalescer->getPendingCount() << " held back" << endl;
 #endif
 
 	while ((events.empty() == false) &&
-		(m_done == false))
+		((m_done == false) || (flushAll == true)))
 	{
 		MonitorEvent &event = events.front();
 
@@ -776,12 +927,22 @@ void MonitorThread::doWork(void)
 	processEvents();
 
 	// Wait for something to happen
-	while (m_done == false)
+	while (m_stopped == false)
 	{
 		struct timeval selectTimeout;
 		fd_set listenSet;
 
-		selectTimeout.tv_sec = 60;
+		// Wake up when held back events are due
+		int coalescerTimeout = m_pCoalescer->getTimeout(time(NULL));
+		if ((coalescerTimeout >= 0) &&
+			(coalescerTimeout < 60))
+		{
+			selectTimeout.tv_sec = coalescerTimeout;
+		}
+		else
+		{
+			selectTimeout.tv_sec = 60;
+		}
 		selectTimeout.tv_usec = 0;
 
 		FD_ZERO(&listenSet);
@@ -796,7 +957,7 @@ void MonitorThread::doWork(void)
 		if (monitorFd < 0)
 		{
 			m_errorNum = MONITORING_FAILED;
-			return;
+			break;
 		}
 
 		int fdCount = select(max(monitorFd, m_ctrlReadPipe) + 1, &listenSet, NULL, NULL, &selectTimeout);
@@ -808,10 +969,17 @@ void MonitorThread::doWork(void)
 #endif
 			break;
 		}
-		else if (FD_ISSET(monitorFd, &listenSet))
+		else if ((FD_ISSET(monitorFd, &listenSet)) ||
+			(m_pCoalescer->getPendingCount() > 0))
 		{
 			processEvents();
 		}
 	}
+
+	// Don't drop events that were still held back, while the thread isn't done
+	processEvents(true);
+
+	clog << "Monitor received " << m_pCoalescer->getEventsInCount() << " events, reported "
+		<< m_pCoalescer->getEventsOutCount() << endl;
 }
 
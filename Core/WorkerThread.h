@@ -30,9 +30,12 @@
 #include <glibmm/ustring.h>
 
 #include "Document.h"
+#include "EventCoalescer.h"
 #include "MonitorInterface.h"
 #include "MonitorHandler.h"
 
+class WorkerPool;
+
 class WorkerThread
 {
 	public:
@@ -50,6 +53,9 @@ class WorkerThread
 
 		static void immediateFlush(bool doFlush);
 
+		/// Removes and returns the first thread in the map that signaled its end.
+		static WorkerThread *popEndedThread(std::map<unsigned int, WorkerThread *> &threads);
+
 		time_t getStartTime(void) const;
 
 		void setId(unsigned int id);
@@ -60,12 +66,22 @@ class WorkerThread
 
 		bool isBackground(void) const;
 
+		void onPool(void);
+
+		bool isOnPool(void) const;
+
 		bool operator<(const WorkerThread &other) const;
 
 		Glib::Thread *start(void);
 
+		/// Runs the work and signals the end of the thread.
+		void threadHandler(void);
+
 		virtual std::string getType(void) const = 0;
 
+		/// Returns true if this can run on one of the pool's workers.
+		virtual bool isPooled(void) const;
+
 		virtual void stop(void);
 
 		bool isStopped(void) const;
@@ -80,17 +96,17 @@ class WorkerThread
 		/// Use a Dispatcher for thread safety
 		static Glib::Dispatcher m_dispatcher;
 		static pthread_mutex_t m_dispatcherMutex;
+		static std::set<unsigned int> m_doneIds;
 		static bool m_immediateFlush;
 		time_t m_startTime;
 		unsigned int m_id;
 		bool m_background;
+		bool m_onPool;
 		bool m_stopped;
 		bool m_done;
 		int m_errorNum;
 		std::string m_errorParam;
 
-		void threadHandler(void);
-
 		virtual void doWork(void) = 0;
 
 		void emitSignal(void);
@@ -112,8 +128,14 @@ class ThreadsManager : virtual public sigc::trackable
 
 		bool start_thread(WorkerThread *pWorkerThread, bool inBackground = false);
 
+		/// Runs the thread on the given pool, or on its own if there's none.
+		bool start_pooled_thread(WorkerThread *pWorkerThread, WorkerPool *pPool);
+
 		unsigned int get_threads_count(void);
 
+		/// Returns the number of foreground threads that aren't on a pool.
+		unsigned int get_indexing_threads_count(void);
+
 		void stop_threads(void);
 
 		virtual void connect(void);
@@ -140,10 +162,12 @@ class ThreadsManager : virtual public sigc::trackable
 		std::string m_defaultIndexLocation;
 		unsigned int m_maxIndexThreads;
 		unsigned int m_backgroundThreadsCount;
+		unsigned int m_pooledThreadsCount;
 		unsigned int m_foregroundThreadsMaxTime;
 		long m_numCPUs;
 		sigc::signal1<void, WorkerThread *> m_onThreadEndSignal;
 		std::set<std::string> m_beingIndexed;
+		time_t m_lastThreadsCheck;
 
 		bool read_lock_threads(void);
 
@@ -153,6 +177,8 @@ class ThreadsManager : virtual public sigc::trackable
 
 		WorkerThread *get_thread(void);
 
+		bool run_thread(WorkerThread *pWorkerThread, WorkerPool *pPool);
+
 	private:
 		ThreadsManager(const ThreadsManager &other);
 		ThreadsManager &operator=(const ThreadsManager &other);
@@ -174,10 +200,11 @@ class MonitorThread : public WorkerThread
 		int m_ctrlWritePipe;
 		MonitorInterface *m_pMonitor;
 		MonitorHandler *m_pHandler;
+		EventCoalescer *m_pCoalescer;
 
 		virtual bool isFileBlacklisted(const std::string &location);
 		virtual void fileModified(const std::string &location);
-		void processEvents(void);
+		void processEvents(bool flushAll = false);
 		virtual void doWork(void);
 
 	private:
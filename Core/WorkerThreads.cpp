@@ -43,7 +43,6 @@
 #include "NLS.h"
 #include "Languages.h"
 #include "MIMEScanner.h"
-#include "TimeConverter.h"
 #include "Timer.h"
 #include "Url.h"
 #include "HtmlFilter.h"
@@ -62,12 +61,21 @@ QueueManager::QueueManager(const string &defaultIndexLocation,
 	ThreadsManager(defaultIndexLocation, maxThreadsTime),
 	m_scanLocalFiles(scanLocalFiles),
 	m_stopIndexing(false),
-	m_actionQueue(PinotSettings::getInstance().getHistoryDatabaseName(), get_application_name())
+	m_actionQueue(PinotSettings::getInstance().getHistoryDatabaseName(), get_application_name()),
+	m_actionQueueSpilled(true),
+	m_maxPendingDocs(64),
+	m_maxPendingTime(5),
+	m_lastSpill(time(NULL))
 {
+	pthread_mutex_init(&m_actionQueueMutex, NULL);
 }
 
 QueueManager::~QueueManager()
 {
+	// Don't lose what's still queued
+	flush_queue();
+
+	pthread_mutex_destroy(&m_actionQueueMutex);
 }
 
 ustring QueueManager::index_document(const DocumentInfo &docInfo)
@@ -127,30 +135,249 @@ ustring QueueManager::index_document(const DocumentInfo &docInfo)
 		return status;
 	}
 
+	bool startedThread = false;
+
 	if ((m_scanLocalFiles == true) &&
 		(urlObj.isLocal() == true))
 	{
 		// This handles both directories and files
-		start_thread(new DirectoryScannerThread(urlObj.getLocation() + "/" + urlObj.getFile(),
+		startedThread = start_thread(new DirectoryScannerThread(urlObj.getLocation() + "/" + urlObj.getFile(),
 			m_defaultIndexLocation, 0, true, true));
 	}
 	else
 	{
-		start_thread(new IndexingThread(docInfo, m_defaultIndexLocation));
+		startedThread = start_thread(new IndexingThread(docInfo, m_defaultIndexLocation));
+	}
+
+	if (startedThread == false)
+	{
+		// The pool may be full, try again later
+		if (write_lock_lists() == true)
+		{
+			m_beingIndexed.erase(location);
+
+			unlock_lists();
+		}
+
+		push_pending(docInfo);
 	}
 
 	return "";
 }
 
+void QueueManager::push_pending(const DocumentInfo &docInfo)
+{
+	string location(docInfo.getLocation());
+	vector<DocumentInfo> docsInfo;
+	time_t timeNow = time(NULL);
+
+	if (write_lock_lists() == true)
+	{
+		map<string, DocumentInfo>::iterator docIter = m_pendingDocs.find(location);
+
+		if (docIter == m_pendingDocs.end())
+		{
+			m_pendingDocs.insert(pair<string, DocumentInfo>(location, docInfo));
+			m_pendingLocations.push_back(location);
+		}
+		else
+		{
+			// Like the action queue, keep one item per URL, the latest
+			docIter->second = docInfo;
+		}
+
+		// Limit how much of the queue would be lost if we were to crash
+		if ((m_pendingDocs.size() >= m_maxPendingDocs) ||
+			(m_lastSpill + m_maxPendingTime <= timeNow))
+		{
+			take_pending(docsInfo);
+		}
+
+		unlock_lists();
+	}
+
+	spill_queue(docsInfo);
+}
+
+bool QueueManager::pop_pending(DocumentInfo &docInfo)
+{
+	vector<DocumentInfo> docsInfo;
+	bool poppedItem = false;
+
+	// Items spilled to the action queue are older than those still in memory
+	if (write_lock_lists() == true)
+	{
+		if (m_spilledDocs.empty() == false)
+		{
+			docInfo = m_spilledDocs.front();
+			m_spilledDocs.pop_front();
+			poppedItem = true;
+		}
+
+		unlock_lists();
+	}
+
+	if (poppedItem == true)
+	{
+		return true;
+	}
+
+	// Read them back a batch at a time, until there are none left
+	if (pthread_mutex_lock(&m_actionQueueMutex) == 0)
+	{
+		if ((m_actionQueueSpilled == true) &&
+			(m_actionQueue.popItems(ActionQueue::INDEX, 64, docsInfo) == false))
+		{
+			docsInfo.clear();
+		}
+		if (docsInfo.size() < 64)
+		{
+			m_actionQueueSpilled = false;
+		}
+
+		pthread_mutex_unlock(&m_actionQueueMutex);
+	}
+
+	if (write_lock_lists() == true)
+	{
+		for (vector<DocumentInfo>::const_iterator docIter = docsInfo.begin();
+			docIter != docsInfo.end(); ++docIter)
+		{
+			// Items queued since then are more recent
+			if (m_pendingDocs.find(docIter->getLocation()) == m_pendingDocs.end())
+			{
+				m_spilledDocs.push_back(*docIter);
+			}
+		}
+
+		if (m_spilledDocs.empty() == false)
+		{
+			docInfo = m_spilledDocs.front();
+			m_spilledDocs.pop_front();
+			poppedItem = true;
+		}
+		else if (m_pendingLocations.empty() == false)
+		{
+			map<string, DocumentInfo>::iterator docIter = m_pendingDocs.find(m_pendingLocations.front());
+
+			if (docIter != m_pendingDocs.end())
+			{
+				docInfo = docIter->second;
+				m_pendingDocs.erase(docIter);
+				poppedItem = true;
+			}
+			m_pendingLocations.pop_front();
+		}
+
+		unlock_lists();
+	}
+
+	return poppedItem;
+}
+
+void QueueManager::take_pending(vector<DocumentInfo> &docsInfo)
+{
+	// The caller holds the lists lock
+	for (deque<string>::const_iterator locationIter = m_pendingLocations.begin();
+		locationIter != m_pendingLocations.end(); ++locationIter)
+	{
+		map<string, DocumentInfo>::const_iterator docIter = m_pendingDocs.find(*locationIter);
+
+		if (docIter != m_pendingDocs.end())
+		{
+			docsInfo.push_back(docIter->second);
+		}
+	}
+	m_pendingDocs.clear();
+	m_pendingLocations.clear();
+	m_lastSpill = time(NULL);
+}
+
+void QueueManager::spill_queue(const vector<DocumentInfo> &docsInfo)
+{
+	bool wroteItems = false;
+
+	if (docsInfo.empty() == true)
+	{
+		return;
+	}
+
+	// The lists lock isn't held while writing to the action queue
+	if (pthread_mutex_lock(&m_actionQueueMutex) == 0)
+	{
+		wroteItems = m_actionQueue.pushItems(ActionQueue::INDEX, docsInfo);
+		if (wroteItems == true)
+		{
+			m_actionQueueSpilled = true;
+		}
+
+		pthread_mutex_unlock(&m_actionQueueMutex);
+	}
+
+	if (wroteItems == true)
+	{
+#ifdef DEBUG
+		clog << "QueueManager::spill_queue: wrote " << docsInfo.size() << " items" << endl;
+#endif
+		return;
+	}
+
+	clog << "Couldn't write " << docsInfo.size() << " items to the action queue" << endl;
+
+	// Keep them in memory, ahead of items queued since
+	if (write_lock_lists() == true)
+	{
+		for (vector<DocumentInfo>::const_reverse_iterator docIter = docsInfo.rbegin();
+			docIter != docsInfo.rend(); ++docIter)
+		{
+			string location(docIter->getLocation());
+
+			if (m_pendingDocs.find(location) == m_pendingDocs.end())
+			{
+				m_pendingDocs.insert(pair<string, DocumentInfo>(location, *docIter));
+				m_pendingLocations.push_front(location);
+			}
+		}
+
+		unlock_lists();
+	}
+}
+
+/// Writes queued documents to the action queue.
+void QueueManager::flush_queue(void)
+{
+	vector<DocumentInfo> docsInfo;
+
+	if (write_lock_lists() == true)
+	{
+		// Items read back from the action queue go first
+		docsInfo.insert(docsInfo.end(), m_spilledDocs.begin(), m_spilledDocs.end());
+		m_spilledDocs.clear();
+		take_pending(docsInfo);
+
+		unlock_lists();
+	}
+
+	spill_queue(docsInfo);
+}
+
 void QueueManager::clear_queues(void)
 {
 	if (write_lock_lists() == true)
 	{
 		m_beingIndexed.clear();
+		m_spilledDocs.clear();
+		m_pendingDocs.clear();
+		m_pendingLocations.clear();
 
 		unlock_lists();
 
-		m_actionQueue.expireItems(time(NULL));
+		if (pthread_mutex_lock(&m_actionQueueMutex) == 0)
+		{
+			m_actionQueue.expireItems(time(NULL));
+
+			pthread_mutex_unlock(&m_actionQueueMutex);
+		}
 	}
 }
 
@@ -158,7 +385,7 @@ ustring QueueManager::queue_index(const DocumentInfo &docInfo)
 {
 	bool addToQueue = false;
 
-	if (get_threads_count() >= m_maxIndexThreads)
+	if (get_indexing_threads_count() >= m_maxIndexThreads)
 	{
 #ifdef DEBUG
 		clog << "QueueManager::queue_index: too many threads" << endl;
@@ -185,7 +412,7 @@ ustring QueueManager::queue_index(const DocumentInfo &docInfo)
 
 	if (addToQueue == true)
 	{
-		m_actionQueue.pushItem(ActionQueue::INDEX, docInfo);
+		push_pending(docInfo);
 
 		return "";
 	}
@@ -201,7 +428,7 @@ bool QueueManager::pop_queue(const string &urlWasIndexed)
 #ifdef DEBUG
 	clog << "QueueManager::pop_queue: called" << endl;
 #endif
-	if (get_threads_count() >= m_maxIndexThreads)
+	if (get_indexing_threads_count() >= m_maxIndexThreads)
 	{
 #ifdef DEBUG
 		clog << "QueueManager::pop_queue: too many threads" << endl;
@@ -226,22 +453,16 @@ bool QueueManager::pop_queue(const string &urlWasIndexed)
 		// Get an item ?
 		if (getItem == true)
 		{
-			ActionQueue::ActionType type;
 			DocumentInfo docInfo;
 			string previousLocation;
 
 			// Assume the queue is empty
 			emptyQueue = true;
 
-			while (m_actionQueue.popItem(type, docInfo) == true)
+			while (pop_pending(docInfo) == true)
 			{
 				ustring status;
 
-				if (type != ActionQueue::INDEX)
-				{
-					continue;
-				}
-
 				// The queue isn't actually empty
 				emptyQueue = false;
 
@@ -430,14 +651,16 @@ bool QueryingThread::findPlugin(void)
 
 EngineQueryThread::EngineQueryThread(const PinotSettings::IndexProperties &indexProps,
 	const QueryProperties &queryProps, unsigned int startDoc, bool listingIndex) :
-	QueryingThread(indexProps, queryProps, startDoc, listingIndex)
+	QueryingThread(indexProps, queryProps, startDoc, listingIndex),
+	m_withExtracts(true)
 {
 }
 
 EngineQueryThread::EngineQueryThread(const PinotSettings::IndexProperties &indexProps,
 	const QueryProperties &queryProps, const set<string> &limitToDocsSet,
 	unsigned int startDoc) :
-	QueryingThread(indexProps, queryProps, startDoc, false)
+	QueryingThread(indexProps, queryProps, startDoc, false),
+	m_withExtracts(true)
 {
 	copy(limitToDocsSet.begin(), limitToDocsSet.end(),
 		inserter(m_limitToDocsSet, m_limitToDocsSet.begin()));
@@ -445,7 +668,8 @@ EngineQueryThread::EngineQueryThread(const PinotSettings::IndexProperties &index
 
 EngineQueryThread::EngineQueryThread(const string &engineName, const string &engineDisplayableName,
 	const string &engineOption, const QueryProperties &queryProps, unsigned int startDoc) :
-	QueryingThread(engineName, engineDisplayableName, engineOption, queryProps, startDoc)
+	QueryingThread(engineName, engineDisplayableName, engineOption, queryProps, startDoc),
+	m_withExtracts(true)
 {
 }
 
@@ -453,11 +677,17 @@ EngineQueryThread::~EngineQueryThread()
 {
 }
 
+void EngineQueryThread::setWithExtracts(bool withExtracts)
+{
+	m_withExtracts = withExtracts;
+}
+
 void EngineQueryThread::processResults(const vector<DocumentInfo> &resultsList)
 {
 	PinotSettings &settings = PinotSettings::getInstance();
 	IndexInterface *pDocsIndex = NULL;
 	IndexInterface *pDaemonIndex = NULL;
+	map<string, unsigned int> docsIds, daemonIds;
 	unsigned int indexId = 0;
 	bool isIndexQuery = false;
 
@@ -476,8 +706,34 @@ void EngineQueryThread::processResults(const vector<DocumentInfo> &resultsList)
 	// Will we have to query internal indices ?
 	if (isIndexQuery == false)
 	{
+		set<string> urls;
+
 		pDocsIndex = settings.getIndex(settings.m_docsIndexLocation);
 		pDaemonIndex = settings.getIndex(settings.m_daemonIndexLocation);
+
+		for (vector<DocumentInfo>::const_iterator resultIter = resultsList.begin();
+			resultIter != resultsList.end(); ++resultIter)
+		{
+			urls.insert(resultIter->getLocation(true));
+		}
+
+		// Look all results up at once in each index
+		if ((pDocsIndex != NULL) &&
+			(pDocsIndex->isGood() == true))
+		{
+			pDocsIndex->hasDocuments(urls, docsIds);
+
+			for (map<string, unsigned int>::const_iterator docIter = docsIds.begin();
+				docIter != docsIds.end(); ++docIter)
+			{
+				urls.erase(docIter->first);
+			}
+		}
+		if ((pDaemonIndex != NULL) &&
+			(pDaemonIndex->isGood() == true))
+		{
+			pDaemonIndex->hasDocuments(urls, daemonIds);
+		}
 	}
 
 	// Copy the results list
@@ -516,22 +772,18 @@ void EngineQueryThread::processResults(const vector<DocumentInfo> &resultsList)
 		}
 
 		// Is this in one of the indexes ?
-		if ((pDocsIndex != NULL) &&
-			(pDocsIndex->isGood() == true))
+		map<string, unsigned int>::const_iterator docIter = docsIds.find(location);
+		if (docIter != docsIds.end())
 		{
-			docId = pDocsIndex->hasDocument(location);
-			if (docId > 0)
-			{
-				indexId = settings.getIndexPropertiesByName(_("My Web Pages")).m_id;
-			}
+			docId = docIter->second;
+			indexId = settings.getIndexPropertiesByName(_("My Web Pages")).m_id;
 		}
-		if ((pDaemonIndex != NULL) &&
-			(pDaemonIndex->isGood() == true) &&
-			(docId == 0))
+		else
 		{
-			docId = pDaemonIndex->hasDocument(location);
-			if (docId > 0)
+			docIter = daemonIds.find(location);
+			if (docIter != daemonIds.end())
 			{
+				docId = docIter->second;
 				indexId = settings.getIndexPropertiesByName(_("My Documents")).m_id;
 			}
 		}
@@ -628,6 +880,7 @@ void EngineQueryThread::doWork(void)
 
 	// Run the query
 	pEngine->setDefaultOperator(SearchEngineInterface::DEFAULT_OP_AND);
+	pEngine->setWithExtracts(m_withExtracts);
 	if (pEngine->runQuery(m_queryProps, m_startDoc) == false)
 	{
 		m_errorNum = QUERY_FAILED;
@@ -819,6 +1072,11 @@ string IndexingThread::getType(void) const
 	return "IndexingThread";
 }
 
+bool IndexingThread::isPooled(void) const
+{
+	return true;
+}
+
 const DocumentInfo &IndexingThread::getDocumentInfo(void) const
 {
 	return m_docInfo;
@@ -1272,6 +1530,12 @@ string DirectoryScannerThread::getType(void) const
 	return "DirectoryScannerThread";
 }
 
+bool DirectoryScannerThread::isPooled(void) const
+{
+	// Scanning may take a while
+	return false;
+}
+
 string DirectoryScannerThread::getDirectory(void) const
 {
 	return m_dirName;
@@ -1674,7 +1938,7 @@ bool DirectoryScannerThread::scanEntry(const string &entryName,
 			// Scan the file
 			docInfo.setType(MIMEScanner::scanFile(entryName));
 		}
-		docInfo.setTimestamp(TimeConverter::toTimestamp(fileStat.st_mtime));
+		docInfo.setTime(fileStat.st_mtime);
 		docInfo.setSize(fileStat.st_size);
 
 		foundFile(docInfo);
@@ -22,6 +22,7 @@
 #include <time.h>
 #include <string>
 #include <vector>
+#include <deque>
 #include <queue>
 #include <set>
 #include <map>
@@ -52,13 +53,32 @@ class QueueManager : public ThreadsManager
 
 		virtual bool pop_queue(const std::string &urlWasIndexed = "");
 
+		/// Writes queued documents to the action queue.
+		void flush_queue(void);
+
 	protected:
 		bool m_scanLocalFiles;
 		bool m_stopIndexing;
 		ActionQueue m_actionQueue;
+		pthread_mutex_t m_actionQueueMutex;
+		bool m_actionQueueSpilled;
+		std::map<std::string, DocumentInfo> m_pendingDocs;
+		std::deque<std::string> m_pendingLocations;
+		std::deque<DocumentInfo> m_spilledDocs;
+		unsigned int m_maxPendingDocs;
+		time_t m_maxPendingTime;
+		time_t m_lastSpill;
 
 		Glib::ustring index_document(const DocumentInfo &docInfo);
 
+		void push_pending(const DocumentInfo &docInfo);
+
+		bool pop_pending(DocumentInfo &docInfo);
+
+		void take_pending(std::vector<DocumentInfo> &docsInfo);
+
+		void spill_queue(const std::vector<DocumentInfo> &docsInfo);
+
 		virtual void clear_queues(void);
 
 	private:
@@ -149,8 +169,11 @@ class EngineQueryThread : public QueryingThread
 			unsigned int startDoc = 0);
 		virtual ~EngineQueryThread();
 
+		void setWithExtracts(bool withExtracts);
+
 	protected:
 		std::set<std::string> m_limitToDocsSet;
+		bool m_withExtracts;
 
 		virtual void processResults(const std::vector<DocumentInfo> &resultsList);
 
@@ -203,6 +226,8 @@ class IndexingThread : public DownloadingThread
 
 		virtual std::string getType(void) const;
 
+		virtual bool isPooled(void) const;
+
 		const DocumentInfo &getDocumentInfo(void) const;
 
 		std::string getLabelName(void) const;
@@ -283,6 +308,8 @@ class DirectoryScannerThread : public IndexingThread
 
 		virtual std::string getType(void) const;
 
+		virtual bool isPooled(void) const;
+
 		virtual std::string getDirectory(void) const;
 
 		virtual void stop(void);
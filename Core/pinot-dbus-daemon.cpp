@@ -353,7 +353,7 @@ static DBusHandlerResult messageHandler(DBusConnection *pConnection, DBusMessage
 		{
 			DBusServletInfo *pInfo = new DBusServletInfo(pConnection, pMessage);
 
-			pServer->start_thread(new DBusServletThread(pServer, pInfo));
+			pServer->start_servlet(pInfo);
 		}
 	}
 
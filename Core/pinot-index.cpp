@@ -16,6 +16,8 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
  
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -24,6 +26,8 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <deque>
+#include <algorithm>
 #include <glibmm.h>
 #include <glibmm/thread.h>
 #include <glibmm/miscutils.h>
@@ -41,23 +45,51 @@
 #include "ModuleFactory.h"
 #include "ActionQueue.h"
 #include "PinotSettings.h"
+#include "Timer.h"
 #include "WorkerThreads.h"
 
 using namespace std;
 
 static struct option g_longOptions[] = {
 	{"backend", 1, 0, 'b'},
+	{"bulk", 0, 0, 'B'},
 	{"check", 0, 0, 'c'},
 	{"db", 1, 0, 'd'},
 	{"help", 0, 0, 'h'},
 	{"index", 0, 0, 'i'},
+	{"list", 1, 0, 'l'},
 	{"override", 1, 0, 'o'},
 	{"showinfo", 0, 0, 's'},
+	{"upgrade", 0, 0, 'u'},
 	{"version", 0, 0, 'v'},
 	{0, 0, 0, 0}
 };
 static Glib::RefPtr<Glib::MainLoop> g_refMainLoop;
 
+static string rewriteUrl(const Url &thisUrl)
+{
+	string urlParam(thisUrl.getProtocol());
+
+	// Rewrite the URL, dropping user name and password which we don't support
+	urlParam += "://";
+	if (thisUrl.isLocal() == false)
+	{
+		urlParam += thisUrl.getHost();
+		urlParam += "/";
+	}
+	urlParam += thisUrl.getLocation();
+	if (thisUrl.getFile().empty() == false)
+	{
+		urlParam += "/";
+		urlParam += thisUrl.getFile();
+	}
+#ifdef DEBUG
+	clog << "URL rewritten to " << urlParam << endl;
+#endif
+
+	return urlParam;
+}
+
 class IndexingState : public QueueManager
 {
 	public:
@@ -140,6 +172,246 @@ class IndexingState : public QueueManager
 };
 static IndexingState *g_pState = NULL;
 
+class BulkIndexingState : public QueueManager
+{
+	public:
+		BulkIndexingState(const string &indexLocation, istream *pInput) :
+			QueueManager(indexLocation),
+			m_pInput(pInput),
+			m_indexedCount(0),
+			m_failedCount(0),
+			m_bytesCount(0)
+		{
+			// The index is flushed once, when all is done
+			WorkerThread::immediateFlush(false);
+
+			// Keep every CPU busy, some threads will be waiting on the index
+			m_maxIndexThreads = max(m_maxIndexThreads, (unsigned int)m_numCPUs * 2);
+
+			m_onThreadEndSignal.connect(sigc::mem_fun(*this, &BulkIndexingState::on_thread_end));
+			m_timer.start();
+		}
+
+		virtual ~BulkIndexingState()
+		{
+		}
+
+		void add_url(const string &urlParam)
+		{
+			m_urls.push_back(urlParam);
+		}
+
+		void on_file_found(DocumentInfo docInfo, bool isDirectory)
+		{
+			// This is called by scanner threads
+			queue_index(docInfo);
+		}
+
+		void on_thread_end(WorkerThread *pThread)
+		{
+			if (pThread == NULL)
+			{
+				return;
+			}
+
+			string indexedUrl, type(pThread->getType());
+#ifdef DEBUG
+			clog << "BulkIndexingState::on_thread_end: end of thread " << type << " " << pThread->getId() << endl;
+#endif
+
+			if (type == "IndexingThread")
+			{
+				IndexingThread *pIndexThread = dynamic_cast<IndexingThread *>(pThread);
+
+				if (pIndexThread != NULL)
+				{
+					indexedUrl = pIndexThread->getURL();
+				}
+
+				if ((pIndexThread != NULL) &&
+					(pThread->isStopped() == false))
+				{
+					if ((pThread->getErrorNum() > 0) ||
+						(pIndexThread->getDocumentID() == 0))
+					{
+						++m_failedCount;
+					}
+					else
+					{
+						++m_indexedCount;
+						m_bytesCount += pIndexThread->getDocumentInfo().getSize();
+
+						if (m_indexedCount % 1000 == 0)
+						{
+							print_statistics();
+						}
+					}
+				}
+			}
+
+			// Delete the thread
+			delete pThread;
+
+			if (start_threads(indexedUrl) == false)
+			{
+				// Stop there
+				g_refMainLoop->quit();
+			}
+		}
+
+		/// Starts threads for pending and new URLs; false if there's nothing left to do.
+		bool start_threads(const string &indexedUrl = "")
+		{
+			string urlParam, urlWasIndexed(indexedUrl);
+
+			while ((mustQuit() == false) &&
+				(get_threads_count() < m_maxIndexThreads))
+			{
+				// Documents found by scanners come first
+				bool emptyQueue = pop_queue(urlWasIndexed);
+
+				// The indexed document is no longer in progress
+				urlWasIndexed.clear();
+				if (emptyQueue == false)
+				{
+					continue;
+				}
+
+				if (next_url(urlParam) == false)
+				{
+					break;
+				}
+				queue_url(urlParam);
+			}
+
+			// Scanners may still find files
+			if ((mustQuit() == true) ||
+				((get_threads_count() == 0) && (m_backgroundThreadsCount == 0)))
+			{
+				return false;
+			}
+
+			return true;
+		}
+
+		/// Stops all threads, including those on the pool, and waits until they are done.
+		void stop_threads_and_wait(void)
+		{
+			mustQuit(true);
+
+			while (true)
+			{
+				WorkerThread *pThread = get_thread();
+
+				if (pThread != NULL)
+				{
+					delete pThread;
+					continue;
+				}
+
+				bool threadsLeft = true;
+
+				if (read_lock_threads() == true)
+				{
+					threadsLeft = (m_threads.empty() == false);
+
+					unlock_threads();
+				}
+				if (threadsLeft == false)
+				{
+					break;
+				}
+
+				// Stopped threads will signal shortly
+				Glib::usleep(100000);
+			}
+		}
+
+		void print_statistics(void)
+		{
+			long elapsedTime = m_timer.stop();
+			long docsRate = 0, bytesRate = 0;
+
+			if (elapsedTime > 0)
+			{
+				docsRate = (long)(((double)m_indexedCount * 1000) / elapsedTime);
+				bytesRate = (long)(((double)m_bytesCount * 1000) / (elapsedTime * 1024));
+			}
+
+			clog << "Indexed " << m_indexedCount << " documents (" << m_bytesCount / 1024
+				<< " kB), " << m_failedCount << " failed, in " << elapsedTime / 1000 << " s: "
+				<< docsRate << " documents/s, " << bytesRate << " kB/s" << endl;
+		}
+
+	protected:
+		istream *m_pInput;
+		deque<string> m_urls;
+		unsigned int m_indexedCount;
+		unsigned int m_failedCount;
+		off_t m_bytesCount;
+		Timer m_timer;
+
+		bool next_url(string &urlParam)
+		{
+			// Arguments first, then the list
+			if (m_urls.empty() == false)
+			{
+				urlParam = m_urls.front();
+				m_urls.pop_front();
+
+				return true;
+			}
+
+			while ((m_pInput != NULL) &&
+				(getline(*m_pInput, urlParam)))
+			{
+				if (urlParam.empty() == false)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void queue_url(const string &urlParam)
+		{
+			Url thisUrl(urlParam, "");
+			DocumentInfo docInfo("", rewriteUrl(thisUrl), MIMEScanner::scanUrl(thisUrl), "");
+			struct stat fileStat;
+
+			if ((thisUrl.isLocal() == true) &&
+				(stat(docInfo.getLocation().substr(7).c_str(), &fileStat) == 0) &&
+				(S_ISDIR(fileStat.st_mode)))
+			{
+				DirectoryScannerThread *pScannerThread = new DirectoryScannerThread(docInfo.getLocation().substr(7),
+					m_defaultIndexLocation, 0, false, true);
+
+				// Scanning may take longer than foreground threads are allowed to run
+				pScannerThread->getFileFoundSignal().connect(sigc::mem_fun(*this, &BulkIndexingState::on_file_found));
+				if (start_thread(pScannerThread, true) == false)
+				{
+					clog << "Couldn't scan " << docInfo.getLocation() << endl;
+				}
+
+				return;
+			}
+
+			Glib::ustring status(queue_index(docInfo));
+			if (status.empty() == false)
+			{
+				clog << status << endl;
+				++m_failedCount;
+			}
+		}
+
+	private:
+		BulkIndexingState(const BulkIndexingState &other);
+		BulkIndexingState &operator=(const BulkIndexingState &other);
+
+};
+static BulkIndexingState *g_pBulkState = NULL;
+
 static void printHelp(void)
 {
 	map<ModuleProperties, bool> engines;
@@ -151,12 +423,15 @@ static void printHelp(void)
 		<< "Usage: pinot-index [OPTIONS] --db DATABASE URLS\n\n"
 		<< "Options:\n"
 		<< "  -b, --backend             name of back-end to use (default " << PinotSettings::getInstance().m_defaultBackend << ")\n"
+		<< "  -B, --bulk                index the given URLs in parallel and flush once at the end\n"
 		<< "  -c, --check               check whether the given URL is in the index\n"
 		<< "  -d, --db                  path to, or name of, index to use (mandatory)\n"
 		<< "  -h, --help                display this help and exit\n"
 		<< "  -i, --index               index the given URL\n"
+		<< "  -l, --list                file listing URLs to index in bulk, one per line, - for standard input\n"
 		<< "  -o, --override            MIME type detection override, as TYPE:EXT\n"
 		<< "  -s, --showinfo            show information about the document\n"
+		<< "  -u, --upgrade             rewrite documents' data in the current format\n"
 		<< "  -v, --version             output version information and exit\n\n"
 		<< "Supported back-ends are :";
 	for (map<ModuleProperties, bool>::const_iterator engineIter = engines.begin(); engineIter != engines.end(); ++engineIter)
@@ -172,6 +447,8 @@ static void printHelp(void)
 		<< "pinot-index --check --showinfo --backend xapian --db ~/.pinot/daemon ../Bozo.txt\n\n"
 		<< "pinot-index --index --db PinotOnTheWeb http://code.google.com/p/pinot-search/\n\n"
 		<< "pinot-index --index --db Docs --override text/x-rst:rst /usr/share/doc/python-kitchen-1.1.1/docs/index.rst\n\n"
+		<< "find ~/Archives -name '*.pdf' | pinot-index --bulk --db Archives\n\n"
+		<< "pinot-index --upgrade --db ~/.pinot/daemon\n\n"
 		<< "Indexing documents to My Web Pages or My Documents with pinot-index is not recommended\n\n"
 		<< "Report bugs to " << PACKAGE_BUGREPORT << endl;
 }
@@ -183,6 +460,11 @@ static void closeAll(void)
 		delete g_pState;
 		g_pState = NULL;
 	}
+	if (g_pBulkState != NULL)
+	{
+		delete g_pBulkState;
+		g_pBulkState = NULL;
+	}
 
 	// Close everything
 	ModuleFactory::unloadModules();
@@ -200,6 +482,10 @@ static void quitAll(int sigNum)
 		{
 			g_pState->mustQuit(true);
 		}
+		if (g_pBulkState != NULL)
+		{
+			g_pBulkState->mustQuit(true);
+		}
 		g_refMainLoop->quit();
 	}
 }
@@ -207,12 +493,13 @@ static void quitAll(int sigNum)
 int main(int argc, char **argv)
 {
 	string type, option;
-	string backendType, databaseName;
+	string backendType, databaseName, listFileName;
 	int longOptionIndex = 0;
-	bool checkDocument = false, indexDocument = false, showInfo = false, success = false;
+	bool bulkIndex = false, checkDocument = false, indexDocument = false, showInfo = false;
+	bool upgradeIndex = false, success = false;
 
 	// Look at the options
-	int optionChar = getopt_long(argc, argv, "b:cd:hio:sv", g_longOptions, &longOptionIndex);
+	int optionChar = getopt_long(argc, argv, "b:Bcd:hil:o:suv", g_longOptions, &longOptionIndex);
 	while (optionChar != -1)
 	{
 		set<string> engines;
@@ -225,6 +512,9 @@ int main(int argc, char **argv)
 					backendType = optarg;
 				}
 				break;
+			case 'B':
+				bulkIndex = true;
+				break;
 			case 'c':
 				checkDocument = true;
 				break;
@@ -240,6 +530,12 @@ int main(int argc, char **argv)
 			case 'i':
 				indexDocument = true;
 				break;
+			case 'l':
+				if (optarg != NULL)
+				{
+					listFileName = optarg;
+				}
+				break;
 			case 'o':
 				if (optarg != NULL)
 				{
@@ -256,6 +552,9 @@ int main(int argc, char **argv)
 			case 's':
 				showInfo = true;
 				break;
+			case 'u':
+				upgradeIndex = true;
+				break;
 			case 'v':
 				clog << "pinot-index - " << PACKAGE_STRING << "\n\n"
 					<< "This is free software.  You may redistribute copies of it under the terms of\n"
@@ -267,7 +566,7 @@ int main(int argc, char **argv)
 		}
 
 		// Next option
-		optionChar = getopt_long(argc, argv, "b:cd:hio:sv", g_longOptions, &longOptionIndex);
+		optionChar = getopt_long(argc, argv, "b:Bcd:hil:o:suv", g_longOptions, &longOptionIndex);
 	}
 
 #if defined(ENABLE_NLS)
@@ -282,15 +581,45 @@ int main(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
+	// In bulk mode, URLs may be read from a list, and upgrades don't need any
 	if ((argc < 2) ||
-		(argc - optind == 0))
+		((argc - optind == 0) && (bulkIndex == false) && (upgradeIndex == false)))
 	{
 		clog << "Not enough parameters" << endl;
 		return EXIT_FAILURE;
 	}
 
+	if (upgradeIndex == true)
+	{
+		if ((bulkIndex == true) ||
+			(checkDocument == true) ||
+			(indexDocument == true) ||
+			(showInfo == true) ||
+			(argc - optind > 0))
+		{
+			clog << "Incorrect parameters" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else if (bulkIndex == true)
+	{
+		if ((checkDocument == true) ||
+			(showInfo == true))
+		{
+			clog << "Incorrect parameters" << endl;
+			return EXIT_FAILURE;
+		}
+		indexDocument = true;
+	}
+	else if (listFileName.empty() == false)
+	{
+		clog << "Incorrect parameters" << endl;
+		return EXIT_FAILURE;
+	}
+
 	if (((indexDocument == false) &&
-		(checkDocument == false)) ||
+		(checkDocument == false) &&
+		(upgradeIndex == false)) ||
 		(databaseName.empty() == true))
 	{
 		clog << "Incorrect parameters" << endl;
@@ -308,6 +637,11 @@ int main(int argc, char **argv)
 
 	// This should make Xapian use Chert rather than Flint
 	Glib::setenv("XAPIAN_PREFER_CHERT", "1");
+	if (bulkIndex == true)
+	{
+		// Commit in large batches, unless told otherwise
+		Glib::setenv("XAPIAN_FLUSH_THRESHOLD", "100000", false);
+	}
 
 	// This will create the necessary directories on the first run
 	PinotSettings &settings = PinotSettings::getInstance();
@@ -379,7 +713,8 @@ int main(int argc, char **argv)
 
 	// Make sure the index is open in the correct mode
 	bool wasObsoleteFormat = false;
-	if (ModuleFactory::openOrCreateIndex(backendType, indexProps.m_location, wasObsoleteFormat, (indexDocument ? false : true)) == false)
+	if (ModuleFactory::openOrCreateIndex(backendType, indexProps.m_location, wasObsoleteFormat,
+		((indexDocument || upgradeIndex) ? false : true)) == false)
 	{
 		clog << "Couldn't open index " << indexProps.m_location << endl;
 
@@ -414,29 +749,74 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-	while (optind < argc)
+	if (upgradeIndex == true)
+	{
+		unsigned int upgradedCount = pIndex->upgradeRecords();
+
+		// Commit everything at once
+		if (pIndex->flush() == true)
+		{
+			clog << "Upgraded " << upgradedCount << " documents" << endl;
+			success = true;
+		}
+	}
+	else if (bulkIndex == true)
 	{
-		string urlParam(argv[optind]);
-		Url thisUrl(urlParam, "");
+		ifstream listFile;
+		istream *pInput = NULL;
 
-		// Rewrite the URL, dropping user name and password which we don't support
-		urlParam = thisUrl.getProtocol();
-		urlParam += "://";
-		if (thisUrl.isLocal() == false)
+		if (listFileName == "-")
+		{
+			pInput = &cin;
+		}
+		else if (listFileName.empty() == false)
 		{
-			urlParam += thisUrl.getHost();
-			urlParam += "/";
+			listFile.open(listFileName.c_str());
+			if (listFile.is_open() == false)
+			{
+				clog << "Couldn't open " << listFileName << endl;
+
+				delete pIndex;
+				return EXIT_FAILURE;
+			}
+			pInput = &listFile;
 		}
-		urlParam += thisUrl.getLocation();
-		if (thisUrl.getFile().empty() == false)
+		else if (argc - optind == 0)
 		{
-			urlParam += "/";
-			urlParam += thisUrl.getFile();
+			pInput = &cin;
 		}
-#ifdef DEBUG
-		clog << "URL rewritten to " << urlParam << endl;
-#endif
 
+		g_pBulkState = new BulkIndexingState(indexProps.m_location, pInput);
+		while (optind < argc)
+		{
+			g_pBulkState->add_url(argv[optind]);
+			++optind;
+		}
+
+		// Connect to threads' finished signal
+		g_pBulkState->connect();
+
+		if (g_pBulkState->start_threads() == true)
+		{
+			// Run the main loop until all is indexed
+			g_refMainLoop->run();
+		}
+
+		// Stop everything, and don't flush while pool threads are still indexing
+		g_pBulkState->disconnect();
+		g_pBulkState->stop_threads_and_wait();
+
+		// Commit everything at once
+		pIndex->flush();
+		g_pBulkState->print_statistics();
+
+		success = true;
+	}
+
+	while (optind < argc)
+	{
+		Url thisUrl(argv[optind], "");
+		string urlParam(rewriteUrl(thisUrl));
 		DocumentInfo docInfo("", urlParam, MIMEScanner::scanUrl(thisUrl), "");
 		unsigned int docId = 0;
 
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include "Languages.h"
 #include "DBusIndex.h"
@@ -208,6 +209,15 @@ bool DBusIndex::documentInfoFromDBus(DBusMessageIter *iter, unsigned int &docId,
 /// Converts docId and docInfo to a dbus message.
 bool DBusIndex::documentInfoToDBus(DBusMessageIter *iter, unsigned int docId,
 	const DocumentInfo &docInfo)
+{
+	set<string> allFields;
+
+	return documentInfoToDBus(iter, docId, docInfo, allFields);
+}
+
+/// Converts docId and the given fields of docInfo to a dbus message.
+bool DBusIndex::documentInfoToDBus(DBusMessageIter *iter, unsigned int docId,
+	const DocumentInfo &docInfo, const set<string> &fields)
 {
         DBusMessageIter array_iter;
 	DBusMessageIter struct_iter;
@@ -239,6 +249,13 @@ bool DBusIndex::documentInfoToDBus(DBusMessageIter *iter, unsigned int docId,
 		string value;
 		stringstream numStr;
 
+		// Was this field asked for ?
+		if ((fields.empty() == false) &&
+			(fields.find(g_fieldNames[fieldNum]) == fields.end()))
+		{
+			continue;
+		}
+
 		switch (fieldNum)
 		{
 			case 0:
@@ -472,6 +489,96 @@ bool DBusIndex::getDocumentInfo(unsigned int docId, DocumentInfo &docInfo) const
 	return m_pROIndex->getDocumentInfo(docId, docInfo);
 }
 
+/// Returns the properties of the given documents; returns the number found.
+unsigned int DBusIndex::getDocumentsInfo(const set<unsigned int> &docIds,
+	map<unsigned int, DocumentInfo> &docsInfo) const
+{
+	unsigned int foundCount = 0;
+
+	if (docIds.empty() == true)
+	{
+		return 0;
+	}
+
+	if (m_pROIndex != NULL)
+	{
+		reopen();
+
+		return m_pROIndex->getDocumentsInfo(docIds, docsInfo);
+	}
+
+	DBusGConnection *pBus = getBusConnection();
+	if (pBus == NULL)
+	{
+		return 0;
+	}
+
+	// FIXME: AFAIK we can't use DBusGProxy with message iterators
+	DBusMessage *pMsg = dbus_message_new_method_call(PINOT_DBUS_SERVICE_NAME,
+		PINOT_DBUS_OBJECT_PATH, PINOT_DBUS_SERVICE_NAME, "GetDocumentsInfo");
+	if (pMsg == NULL)
+	{
+		clog << "DBusIndex::getDocumentsInfo: couldn't call method" << endl;
+		return 0;
+	}
+
+	vector<dbus_uint32_t> docIdsList(docIds.begin(), docIds.end());
+	const dbus_uint32_t *pDocIds = &docIdsList[0];
+	DBusError err;
+
+	// All documents are fetched in one call
+	dbus_message_append_args(pMsg,
+		DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32, &pDocIds, (int)docIdsList.size(),
+		DBUS_TYPE_INVALID);
+
+	dbus_error_init(&err);
+	DBusMessage *pReply = dbus_connection_send_with_reply_and_block(dbus_g_connection_get_connection(pBus),
+		pMsg, 1000 * 10, &err);
+	dbus_message_unref(pMsg);
+
+	if (dbus_error_is_set(&err))
+	{
+		clog << "DBusIndex::getDocumentsInfo: " << err.message << endl;
+		dbus_error_free(&err);
+		return 0;
+	}
+
+	if (pReply != NULL)
+	{
+		DBusMessageIter iter;
+		DBusMessageIter array_iter;
+		DBusMessageIter struct_iter;
+
+		dbus_message_iter_init(pReply, &iter);
+		if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+		{
+			dbus_message_iter_recurse(&iter, &array_iter);
+
+			while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT)
+			{
+				DocumentInfo docInfo;
+				unsigned int docId = 0;
+
+				dbus_message_iter_recurse(&array_iter, &struct_iter);
+				if ((documentInfoFromDBus(&struct_iter, docId, docInfo) == true) &&
+					(docId > 0))
+				{
+					docsInfo[docId] = docInfo;
+					++foundCount;
+				}
+
+				dbus_message_iter_next(&array_iter);
+			}
+		}
+
+		dbus_message_unref(pReply);
+	}
+
+	// FIXME: don't we have to call dbus_g_connection_unref(pBus); ?
+
+	return foundCount;
+}
+
 /// Returns a document's terms count.
 unsigned int DBusIndex::getDocumentTermsCount(unsigned int docId) const
 {
@@ -901,6 +1008,90 @@ unsigned int DBusIndex::hasDocument(const string &url) const
 	return docId;
 }
 
+/// Checks which of the given URLs are in the index; returns the number found.
+unsigned int DBusIndex::hasDocuments(const set<string> &urls,
+	map<string, unsigned int> &docIds) const
+{
+	if (urls.empty() == true)
+	{
+		return 0;
+	}
+
+	if (m_pROIndex != NULL)
+	{
+		reopen();
+
+		return m_pROIndex->hasDocuments(urls, docIds);
+	}
+
+	DBusGConnection *pBus = getBusConnection();
+	if (pBus == NULL)
+	{
+		return 0;
+	}
+
+	DBusGProxy *pBusProxy = getBusProxy(pBus);
+	if (pBusProxy == NULL)
+	{
+		clog << "DBusIndex::hasDocuments: couldn't get bus proxy" << endl;
+		return 0;
+	}
+
+	GError *pError = NULL;
+	char **pUrls = g_new(char *, urls.size() + 1);
+	GArray *pDocIds = NULL;
+	unsigned int urlIndex = 0, foundCount = 0;
+
+	for (set<string>::const_iterator urlIter = urls.begin();
+		urlIter != urls.end(); ++urlIter)
+	{
+		pUrls[urlIndex] = g_strdup(urlIter->c_str());
+		++urlIndex;
+	}
+	pUrls[urlIndex] = NULL;
+
+	// All URLs are checked in one call, document IDs come back in the same order
+	if (dbus_g_proxy_call(pBusProxy, "HasDocuments", &pError,
+		G_TYPE_STRV, pUrls,
+		G_TYPE_INVALID,
+		DBUS_TYPE_G_UINT_ARRAY, &pDocIds,
+		G_TYPE_INVALID) == FALSE)
+	{
+		if (pError != NULL)
+		{
+			clog << "DBusIndex::hasDocuments: " << pError->message << endl;
+			g_error_free(pError);
+		}
+	}
+	else if (pDocIds != NULL)
+	{
+		set<string>::const_iterator urlIter = urls.begin();
+
+		for (unsigned int idIndex = 0; (idIndex < pDocIds->len) && (urlIter != urls.end()); ++idIndex)
+		{
+			unsigned int docId = g_array_index(pDocIds, guint, idIndex);
+
+			if (docId > 0)
+			{
+				docIds[*urlIter] = docId;
+				++foundCount;
+			}
+
+			++urlIter;
+		}
+
+		g_array_free(pDocIds, TRUE);
+	}
+
+	// Free the array
+	g_strfreev(pUrls);
+
+	g_object_unref(pBusProxy);
+	// FIXME: don't we have to call dbus_g_connection_unref(pBus); ?
+
+	return foundCount;
+}
+
 /// Gets terms with the same root.
 unsigned int DBusIndex::getCloseTerms(const string &term, set<string> &suggestions)
 {
@@ -968,6 +1159,34 @@ bool DBusIndex::listDocuments(const string &name, set<unsigned int> &docIds,
 	return m_pROIndex->listDocuments(name, docIds, type, maxDocsCount, startDoc);
 }
 
+/// Lists documents that come after lastDocId, which is set to the last document listed.
+unsigned int DBusIndex::listDocumentsAfter(set<unsigned int> &docIds,
+	unsigned int &lastDocId, unsigned int maxDocsCount) const
+{
+	if (m_pROIndex == NULL)
+	{
+		return 0;
+	}
+
+	reopen();
+
+	return m_pROIndex->listDocumentsAfter(docIds, lastDocId, maxDocsCount);
+}
+
+/// Lists documents that come after lastDocId, which is set to the last document listed.
+bool DBusIndex::listDocumentsAfter(const string &name, set<unsigned int> &docIds,
+	NameType type, unsigned int &lastDocId, unsigned int maxDocsCount) const
+{
+	if (m_pROIndex == NULL)
+	{
+		return false;
+	}
+
+	reopen();
+
+	return m_pROIndex->listDocumentsAfter(name, docIds, type, lastDocId, maxDocsCount);
+}
+
 /// Indexes the given data.
 bool DBusIndex::indexDocument(const Document &doc, const set<string> &labels,
 	unsigned int &docId)
@@ -1076,6 +1295,14 @@ bool DBusIndex::updateDocumentInfo(unsigned int docId, const DocumentInfo &docIn
 	return updated;
 }
 
+/// Moves a directory or file and the documents it holds to a new name.
+bool DBusIndex::moveDocuments(const string &previousName, const string &name,
+	NameType type)
+{
+	clog << "DBusIndex::moveDocuments: not allowed" << endl;
+	return false;
+}
+
 /// Unindexes the given document; true if success.
 bool DBusIndex::unindexDocument(unsigned int docId)
 {
@@ -1104,6 +1331,13 @@ bool DBusIndex::unindexAllDocuments(void)
 	return false;
 }
 
+/// Rewrites documents' data in the current record format; returns the number rewritten.
+unsigned int DBusIndex::upgradeRecords(void)
+{
+	clog << "DBusIndex::upgradeRecords: not allowed" << endl;
+	return 0;
+}
+
 /// Flushes recent changes to the disk.
 bool DBusIndex::flush(void)
 {
@@ -56,6 +56,10 @@ class DBusIndex : public IndexInterface
 		static bool documentInfoToDBus(DBusMessageIter *iter, unsigned int docId,
 			const DocumentInfo &docInfo);
 
+		/// Converts docId and the given fields of docInfo to a dbus message.
+		static bool documentInfoToDBus(DBusMessageIter *iter, unsigned int docId,
+			const DocumentInfo &docInfo, const std::set<std::string> &fields);
+
 		/// Asks the D-Bus service to reload its configuration.
 		static bool reload(void);
 
@@ -78,6 +82,10 @@ class DBusIndex : public IndexInterface
 		/// Returns a document's properties.
 		virtual bool getDocumentInfo(unsigned int docId, DocumentInfo &docInfo) const;
 
+		/// Returns the properties of the given documents; returns the number found.
+		virtual unsigned int getDocumentsInfo(const std::set<unsigned int> &docIds,
+			std::map<unsigned int, DocumentInfo> &docsInfo) const;
+
 		/// Returns a document's terms count.
 		virtual unsigned int getDocumentTermsCount(unsigned int docId) const;
 
@@ -114,6 +122,10 @@ class DBusIndex : public IndexInterface
 		/// Checks whether the given URL is in the index.
 		virtual unsigned int hasDocument(const std::string &url) const;
 
+		/// Checks which of the given URLs are in the index; returns the number found.
+		virtual unsigned int hasDocuments(const std::set<std::string> &urls,
+			std::map<std::string, unsigned int> &docIds) const;
+
 		/// Gets terms with the same root.
 		virtual unsigned int getCloseTerms(const std::string &term, std::set<std::string> &suggestions);
 
@@ -131,6 +143,14 @@ class DBusIndex : public IndexInterface
 		virtual bool listDocuments(const std::string &name, std::set<unsigned int> &docIds,
 			NameType type, unsigned int maxDocsCount = 0, unsigned int startDoc = 0) const;
 
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual unsigned int listDocumentsAfter(std::set<unsigned int> &docIds,
+			unsigned int &lastDocId, unsigned int maxDocsCount = 0) const;
+
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual bool listDocumentsAfter(const std::string &name, std::set<unsigned int> &docIds,
+			NameType type, unsigned int &lastDocId, unsigned int maxDocsCount = 0) const;
+
 		/// Indexes the given data.
 		virtual bool indexDocument(const Document &doc, const std::set<std::string> &labels,
 			unsigned int &docId);
@@ -141,6 +161,10 @@ class DBusIndex : public IndexInterface
 		/// Updates a document's properties.
 		virtual bool updateDocumentInfo(unsigned int docId, const DocumentInfo &docInfo);
 
+		/// Moves a directory or file and the documents it holds to a new name.
+		virtual bool moveDocuments(const std::string &previousName, const std::string &name,
+			NameType type);
+
 		/// Unindexes the given document.
 		virtual bool unindexDocument(unsigned int docId);
 
@@ -153,6 +177,9 @@ class DBusIndex : public IndexInterface
 		/// Unindexes all documents.
 		virtual bool unindexAllDocuments(void);
 
+		/// Rewrites documents' data in the current record format; returns the number rewritten.
+		virtual unsigned int upgradeRecords(void);
+
 		/// Flushes recent changes to the disk.
 		virtual bool flush(void);
 
@@ -47,7 +47,7 @@ class PINOT_EXPORT FieldMapperInterface
 		virtual void getTerms(const DocumentInfo &docInfo,
 			std::vector<std::pair<std::string, std::string> > &prefixedTerms) = 0;
 
-		/// Gets values.
+		/// Gets values; 0 to 5 and 255 are reserved.
 		virtual void getValues(const DocumentInfo &docInfo,
 			std::map<unsigned int, std::string> &values) = 0;
 
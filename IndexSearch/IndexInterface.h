@@ -50,6 +50,10 @@ class PINOT_EXPORT IndexInterface
 		/// Returns a document's properties.
 		virtual bool getDocumentInfo(unsigned int docId, DocumentInfo &docInfo) const = 0;
 
+		/// Returns the properties of the given documents; returns the number found.
+		virtual unsigned int getDocumentsInfo(const std::set<unsigned int> &docIds,
+			std::map<unsigned int, DocumentInfo> &docsInfo) const = 0;
+
 		/// Returns a document's terms count.
 		virtual unsigned int getDocumentTermsCount(unsigned int docId) const = 0;
 
@@ -86,6 +90,10 @@ class PINOT_EXPORT IndexInterface
 		/// Checks whether the given URL is in the index.
 		virtual unsigned int hasDocument(const std::string &url) const = 0;
 
+		/// Checks which of the given URLs are in the index; returns the number found.
+		virtual unsigned int hasDocuments(const std::set<std::string> &urls,
+			std::map<std::string, unsigned int> &docIds) const = 0;
+
 		/// Gets terms with the same root.
 		virtual unsigned int getCloseTerms(const std::string &term, std::set<std::string> &suggestions) = 0;
 
@@ -103,6 +111,14 @@ class PINOT_EXPORT IndexInterface
 		virtual bool listDocuments(const std::string &name, std::set<unsigned int> &docIds,
 			NameType type, unsigned int maxDocsCount = 0, unsigned int startDoc = 0) const = 0;
 
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual unsigned int listDocumentsAfter(std::set<unsigned int> &docIds,
+			unsigned int &lastDocId, unsigned int maxDocsCount = 0) const = 0;
+
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual bool listDocumentsAfter(const std::string &name, std::set<unsigned int> &docIds,
+			NameType type, unsigned int &lastDocId, unsigned int maxDocsCount = 0) const = 0;
+
 		/// Indexes the given data.
 		virtual bool indexDocument(const Document &doc, const std::set<std::string> &labels,
 			unsigned int &docId) = 0;
@@ -113,6 +129,10 @@ class PINOT_EXPORT IndexInterface
 		/// Updates a document's properties.
 		virtual bool updateDocumentInfo(unsigned int docId, const DocumentInfo &docInfo) = 0;
 
+		/// Moves a directory or file and the documents it holds to a new name.
+		virtual bool moveDocuments(const std::string &previousName, const std::string &name,
+			NameType type) = 0;
+
 		/// Unindexes the given document.
 		virtual bool unindexDocument(unsigned int docId) = 0;
 
@@ -125,6 +145,9 @@ class PINOT_EXPORT IndexInterface
 		/// Unindexes all documents.
 		virtual bool unindexAllDocuments(void) = 0;
 
+		/// Rewrites documents' data in the current record format; returns the number rewritten.
+		virtual unsigned int upgradeRecords(void) = 0;
+
 		/// Flushes recent changes to the disk.
 		virtual bool flush(void) = 0;
 
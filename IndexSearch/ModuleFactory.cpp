@@ -51,7 +51,7 @@
 
 typedef ModuleProperties *(getModulePropertiesFunc)(void);
 typedef bool (openOrCreateIndexFunc)(const string &, bool &, bool, bool);
-typedef bool (mergeIndexesFunc)(const string &, const string &, const string &);
+typedef bool (mergeIndexesFunc)(const string &, const vector<string> &);
 typedef IndexInterface *(getIndexFunc)(const string &);
 typedef SearchEngineInterface *(getSearchEngineFunc)(const string &);
 typedef void (setFieldMapperFunc)(FieldMapperInterface *pMapper);
@@ -64,6 +64,7 @@ using std::string;
 using std::map;
 using std::set;
 using std::pair;
+using std::vector;
 
 LoadableModule::LoadableModule(ModuleProperties *pProperties,
 	const string &location, void *pHandle) :
@@ -327,8 +328,8 @@ bool ModuleFactory::openOrCreateIndex(const string &type, const string &option,
 	return false;
 }
 
-bool ModuleFactory::mergeIndexes(const string &type, const string &option0,
-	const string &option1, const string &option2)
+bool ModuleFactory::mergeIndexes(const string &type, const string &option,
+	const vector<string> &shardsOptions)
 {
 	map<string, LoadableModule>::iterator typeIter = m_types.find(type);
 	if ((typeIter == m_types.end()) ||
@@ -349,7 +350,7 @@ bool ModuleFactory::mergeIndexes(const string &type, const string &option0,
 		MERGEINDEXESFUNC);
 	if (pFunc != NULL)
 	{
-		return (*pFunc)(option0, option1, option2);
+		return (*pFunc)(option, shardsOptions);
 	}
 #endif
 #ifdef DEBUG
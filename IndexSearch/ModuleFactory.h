@@ -21,6 +21,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "FieldMapperInterface.h"
 #include "IndexInterface.h"
@@ -59,9 +60,9 @@ class ModuleFactory
 		static bool openOrCreateIndex(const std::string &type, const std::string &option,
 			bool &obsoleteFormat, bool readOnly = true, bool overwrite = false);
 
-		/// Merges two physical indexes in a logical one.
-		static bool mergeIndexes(const std::string &type, const std::string &option0,
-			const std::string &option1, const std::string &option2);
+		/// Merges physical indexes in a logical one.
+		static bool mergeIndexes(const std::string &type, const std::string &option,
+			const std::vector<std::string> &shardsOptions);
 
 		/// Returns an index of the specified type; NULL if unavailable.
 		static IndexInterface *getIndex(const std::string &type, const std::string &option);
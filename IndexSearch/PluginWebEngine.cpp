@@ -31,6 +31,9 @@
 #endif
 #include "PluginWebEngine.h"
 
+// How many pages of results may be fetched ahead at once
+#define PREFETCHED_PAGES_COUNT 3
+
 using std::clog;
 using std::clog;
 using std::endl;
@@ -68,17 +71,31 @@ void PluginWebEngine::load(const string &fileName)
 	delete pParser;
 }
 
-bool PluginWebEngine::getPage(const string &formattedQuery, unsigned int maxResultsCount)
+bool PluginWebEngine::getPage(const string &formattedQuery, unsigned int maxResultsCount,
+	Document *pResponseDoc)
 {
 	if ((m_pResponseParser == NULL) ||
 		(formattedQuery.empty() == true))
 	{
+		if (pResponseDoc != NULL)
+		{
+			delete pResponseDoc;
+		}
 		return false;
 	}
 
-	DocumentInfo docInfo("Results Page", formattedQuery,
-		"text/html", "");
-	Document *pResponseDoc = downloadPage(docInfo);
+	if (pResponseDoc == NULL)
+	{
+		DocumentInfo docInfo("Results Page", formattedQuery,
+			"text/html", "");
+
+		pResponseDoc = downloadPage(docInfo);
+	}
+	else
+	{
+		// This page was prefetched
+		setCharset(pResponseDoc);
+	}
 	if (pResponseDoc == NULL)
 	{
 		clog << "PluginWebEngine::getPage: couldn't download "
@@ -147,6 +164,56 @@ bool PluginWebEngine::getPage(const string &formattedQuery, unsigned int maxResu
 	return success;
 }
 
+void PluginWebEngine::prefetchPages(const string &formattedQuery, unsigned int firstPage,
+	unsigned int maxResultsCount, vector<Document *> &pages)
+{
+	vector<Document *> nextPages;
+	char countStr[64];
+
+	// Only pages whose address doesn't depend on previous results can be fetched ahead
+	if ((m_properties.m_scrolling == SearchPluginProperties::PER_INDEX) ||
+		(m_properties.m_nextIncrement == 0))
+	{
+		return;
+	}
+
+	map<SearchPluginProperties::ParameterVariable, string>::iterator paramIter = m_properties.m_variableParameters.find(SearchPluginProperties::START_PAGE_PARAM);
+	if ((paramIter == m_properties.m_variableParameters.end()) ||
+		(paramIter->second.empty() == true))
+	{
+		return;
+	}
+
+	// Only the next few pages, since a page that isn't full ends the query
+	unsigned int pagesCount = (maxResultsCount + m_properties.m_nextIncrement - 1) / m_properties.m_nextIncrement;
+	pagesCount = min(pagesCount, firstPage + PREFETCHED_PAGES_COUNT);
+	if (pagesCount <= firstPage + 1)
+	{
+		return;
+	}
+
+	vector<DocumentInfo> pagesInfo;
+	for (unsigned int pageNum = firstPage; pageNum < pagesCount; ++pageNum)
+	{
+		string pageQuery(formattedQuery);
+
+		pageQuery += "&";
+		pageQuery += paramIter->second;
+		pageQuery += "=";
+		snprintf(countStr, 64, "%u", pageNum * m_properties.m_nextIncrement + m_properties.m_nextBase);
+		pageQuery += countStr;
+
+		pagesInfo.push_back(DocumentInfo("Results Page", pageQuery,
+			"text/html", ""));
+	}
+
+	downloadPages(pagesInfo, nextPages);
+	pages.insert(pages.end(), nextPages.begin(), nextPages.end());
+#ifdef DEBUG
+	clog << "PluginWebEngine::prefetchPages: prefetched " << nextPages.size() << " pages" << endl;
+#endif
+}
+
 PluginParserInterface *PluginWebEngine::getPluginParser(const string &fileName,
 	string &pluginType)
 {
@@ -313,6 +380,10 @@ bool PluginWebEngine::runQuery(QueryProperties& queryProps,
 #ifdef DEBUG
 	clog << "PluginWebEngine::runQuery: querying " << m_properties.m_longName << endl;
 #endif
+	// Fetch pages a few at a time if possible
+	vector<Document *> pages;
+	unsigned int pageNum = 0;
+
 	while (count < maxResultsCount)
 	{
 		string pageQuery(formattedQuery);
@@ -373,10 +444,31 @@ bool PluginWebEngine::runQuery(QueryProperties& queryProps,
 		}
 
 		firstPage = false;
-		if (getPage(pageQuery, queryProps.getMaximumResultsCount()) == false)
+		if (pageNum == pages.size())
+		{
+			prefetchPages(formattedQuery, pageNum, maxResultsCount, pages);
+		}
+		if (pageNum < pages.size())
+		{
+			Document *pResponseDoc = pages[pageNum];
+
+			pages[pageNum] = NULL;
+			if (pResponseDoc == NULL)
+			{
+				clog << "PluginWebEngine::runQuery: couldn't download "
+					<< pageQuery << endl;
+				break;
+			}
+			if (getPage(pageQuery, queryProps.getMaximumResultsCount(), pResponseDoc) == false)
+			{
+				break;
+			}
+		}
+		else if (getPage(pageQuery, queryProps.getMaximumResultsCount()) == false)
 		{
 			break;
 		}
+		++pageNum;
 
 		if (m_properties.m_nextIncrement == 0)
 		{
@@ -405,5 +497,15 @@ bool PluginWebEngine::runQuery(QueryProperties& queryProps,
 	}
 	m_resultsCountEstimate = m_resultsList.size();
 
+	// Discard pages that weren't needed after all
+	for (vector<Document *>::iterator pageIter = pages.begin();
+		pageIter != pages.end(); ++pageIter)
+	{
+		if (*pageIter != NULL)
+		{
+			delete *pageIter;
+		}
+	}
+
 	return true;
 }
@@ -45,7 +45,11 @@ class PluginWebEngine : public WebEngine
 
 		void load(const std::string &fileName);
 
-		bool getPage(const std::string &formattedQuery, unsigned int maxResultsCount);
+		bool getPage(const std::string &formattedQuery, unsigned int maxResultsCount,
+			Document *pResponseDoc = NULL);
+
+		void prefetchPages(const std::string &formattedQuery, unsigned int firstPage,
+			unsigned int maxResultsCount, std::vector<Document *> &pages);
 
 		static PluginParserInterface *getPluginParser(const std::string &fileName,
 			std::string &pluginType);
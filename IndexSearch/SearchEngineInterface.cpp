@@ -28,6 +28,7 @@ using std::endl;
 
 SearchEngineInterface::SearchEngineInterface() :
 	m_defaultOperator(DEFAULT_OP_AND),
+	m_withExtracts(true),
 	m_resultsCountEstimate(0)
 {
 }
@@ -56,6 +57,12 @@ bool SearchEngineInterface::setExpandSet(const set<string> &docsSet)
 	return false;
 }
 
+/// Sets whether results should come with an extract.
+void SearchEngineInterface::setWithExtracts(bool withExtracts)
+{
+	m_withExtracts = withExtracts;
+}
+
 /// Returns the results for the previous query.
 const vector<DocumentInfo> &SearchEngineInterface::getResults(void) const
 {
@@ -47,6 +47,9 @@ class PINOT_EXPORT SearchEngineInterface
 		/// Sets the set of documents to expand from.
 		virtual bool setExpandSet(const set<string> &docsSet);
 
+		/// Sets whether results should come with an extract.
+		virtual void setWithExtracts(bool withExtracts);
+
 		/// Runs a query; true if success.
 		virtual bool runQuery(QueryProperties& queryProps,
 			unsigned int startDoc = 0) = 0;
@@ -68,6 +71,7 @@ class PINOT_EXPORT SearchEngineInterface
 
 	protected:
 		DefaultOperator m_defaultOperator;
+		bool m_withExtracts;
 		vector<DocumentInfo> m_resultsList;
 		unsigned int m_resultsCountEstimate;
 		string m_charset;
@@ -149,22 +149,45 @@ Document *WebEngine::downloadPage(const DocumentInfo &docInfo)
 	}
 
 	Document *pDoc = m_pDownloader->retrieveUrl(docInfo);
-	if (pDoc != NULL)
+	setCharset(pDoc);
+
+	return pDoc;
+}
+
+unsigned int WebEngine::downloadPages(const vector<DocumentInfo> &docsInfo,
+	vector<Document *> &documents)
+{
+	documents.clear();
+
+	if (m_pDownloader == NULL)
 	{
-		string contentType(pDoc->getType());
+		return 0;
+	}
 
-		// Is a charset specified ?
-		string::size_type pos = contentType.find("charset=");
-		if (pos != string::npos)
-		{
-			m_charset = StringManip::removeQuotes(contentType.substr(pos + 8));
+	// The downloader may fetch these concurrently
+	return m_pDownloader->retrieveUrls(docsInfo, documents);
+}
+
+void WebEngine::setCharset(const Document *pDoc)
+{
+	m_charset.clear();
+
+	if (pDoc == NULL)
+	{
+		return;
+	}
+
+	string contentType(pDoc->getType());
+
+	// Is a charset specified ?
+	string::size_type pos = contentType.find("charset=");
+	if (pos != string::npos)
+	{
+		m_charset = StringManip::removeQuotes(contentType.substr(pos + 8));
 #ifdef DEBUG
-			clog << "WebEngine::downloadPage: page charset is " << m_charset << endl;
+		clog << "WebEngine::setCharset: page charset is " << m_charset << endl;
 #endif
-		}
 	}
-
-	return pDoc;
 }
 
 void WebEngine::setQuery(const QueryProperties &queryProps)
@@ -22,6 +22,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <vector>
 
 #include "Document.h"
 #include "Visibility.h"
@@ -49,6 +50,11 @@ class PINOT_EXPORT WebEngine : public SearchEngineInterface
 
 		Document *downloadPage(const DocumentInfo &docInfo);
 
+		unsigned int downloadPages(const std::vector<DocumentInfo> &docsInfo,
+			std::vector<Document *> &documents);
+
+		void setCharset(const Document *pDoc);
+
 		void setHostNameFilter(const string &filter);
 
 		void setFileNameFilter(const string &filter);
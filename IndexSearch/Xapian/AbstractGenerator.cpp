@@ -16,7 +16,10 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <sys/time.h>
 #include <glib.h>
@@ -37,11 +40,20 @@ using std::string;
 using std::vector;
 using std::map;
 using std::set;
+using std::list;
+using std::pair;
 using std::find;
 using namespace Dijon;
 
 unsigned int AbstractGenerator::m_maxSeedTerms = 5;
 unsigned int AbstractGenerator::m_minTermPositions = 10;
+// Well clear of the values set in XapianIndex::setDocumentData() and by field mappers
+Xapian::valueno AbstractGenerator::m_wordsValue = 255;
+unsigned int AbstractGenerator::m_maxStoredWords = 16384;
+unsigned int AbstractGenerator::m_maxCachedAbstracts = 1000;
+pthread_mutex_t AbstractGenerator::m_cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+list<pair<string, string> > AbstractGenerator::m_cachedAbstracts;
+map<string, list<pair<string, string> >::iterator> AbstractGenerator::m_cachedAbstractsIndex;
 
 AbstractGenerator::PositionWindow::PositionWindow() :
 	m_backWeight(1),
@@ -54,9 +66,10 @@ AbstractGenerator::PositionWindow::~PositionWindow()
 }
 
 AbstractGenerator::AbstractGenerator(const Xapian::Database *pIndex,
-	unsigned int wordsCount) :
+	unsigned int wordsCount, const string &indexName) :
 	m_pIndex(pIndex),
-	m_wordsCount(wordsCount)
+	m_wordsCount(wordsCount),
+	m_indexName(indexName)
 {
 }
 
@@ -64,6 +77,243 @@ AbstractGenerator::~AbstractGenerator()
 {
 }
 
+bool AbstractGenerator::isAbstractWord(CJKVTokenizer &tokenizer, const string &termName)
+{
+	// Skip prefixed terms
+	if ((termName.empty() == true) ||
+		(isupper((int)termName[0]) != 0))
+	{
+		return false;
+	}
+	// Skip multi-character CJKV terms
+	if ((tokenizer.has_cjkv(termName) == true) &&
+		(termName.length() > 4))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+/// Stores the document's words by position so that abstracts are quicker to generate.
+void AbstractGenerator::storeWords(Xapian::Document &doc)
+{
+	CJKVTokenizer tokenizer;
+	vector<string> words;
+	bool truncated = false;
+
+	// Is this turned off ?
+	char *pEnvVar = getenv("PINOT_ABSTRACT_WORDS");
+	if ((pEnvVar != NULL) &&
+		(strlen(pEnvVar) > 0) &&
+		(strncasecmp(pEnvVar, "N", 1) == 0))
+	{
+		return;
+	}
+
+	try
+	{
+		// Same choice of words as generateAbstract() makes without them
+		for (Xapian::TermIterator termIter = doc.termlist_begin();
+			termIter != doc.termlist_end(); ++termIter)
+		{
+			string termName(*termIter);
+
+			if (isAbstractWord(tokenizer, termName) == false)
+			{
+				continue;
+			}
+
+			for (Xapian::PositionIterator positionIter = termIter.positionlist_begin();
+				positionIter != termIter.positionlist_end(); ++positionIter)
+			{
+				Xapian::termpos termPos = *positionIter;
+
+				if ((termPos == 0) ||
+					(termPos > m_maxStoredWords))
+				{
+					truncated = true;
+					continue;
+				}
+				if (words.size() < termPos)
+				{
+					words.resize(termPos);
+				}
+
+				string &word = words[termPos - 1];
+				if ((word.empty() == true) ||
+					(word.length() > termName.length()))
+				{
+					word = termName;
+				}
+			}
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't store words: " << error.get_type() << ": " << error.get_msg() << endl;
+		return;
+	}
+
+	if (words.empty() == true)
+	{
+		return;
+	}
+
+	// Words are separated by spaces, which terms don't have
+	string storedWords(truncated == true ? "T" : "W");
+	for (vector<string>::const_iterator wordIter = words.begin();
+		wordIter != words.end(); ++wordIter)
+	{
+		storedWords += " ";
+		storedWords += *wordIter;
+	}
+
+	doc.add_value(m_wordsValue, storedWords);
+}
+
+bool AbstractGenerator::getStoredWords(Xapian::docid docId, Xapian::termpos startPosition,
+	map<Xapian::termpos, string> &wordsBuffer)
+{
+	string storedWords;
+
+	try
+	{
+		Xapian::Document doc(m_pIndex->get_document(docId));
+
+		storedWords = doc.get_value(m_wordsValue);
+	}
+	catch (const Xapian::Error &error)
+	{
+#ifdef DEBUG
+		clog << "AbstractGenerator::getStoredWords: " << error.get_msg() << endl;
+#endif
+		return false;
+	}
+
+	if ((storedWords.length() < 2) ||
+		((storedWords[0] != 'W') && (storedWords[0] != 'T')))
+	{
+		return false;
+	}
+
+	// Walk to the window
+	string::size_type wordPos = 1;
+	Xapian::termpos termPos = 0;
+	while (wordPos < storedWords.length())
+	{
+		string::size_type nextPos = storedWords.find(' ', wordPos + 1);
+
+		++termPos;
+		if ((startPosition <= termPos + 1) &&
+			(termPos < startPosition + m_wordsCount))
+		{
+			string::size_type wordLen = (nextPos == string::npos ? storedWords.length() : nextPos) - wordPos - 1;
+
+			if (wordLen > 0)
+			{
+				wordsBuffer[termPos] = storedWords.substr(wordPos + 1, wordLen);
+			}
+		}
+		else if (termPos >= startPosition + m_wordsCount)
+		{
+			return true;
+		}
+
+		if (nextPos == string::npos)
+		{
+			break;
+		}
+		wordPos = nextPos;
+	}
+
+	// Words beyond those stored may be needed
+	if (storedWords[0] == 'T')
+	{
+		wordsBuffer.clear();
+		return false;
+	}
+
+	return true;
+}
+
+string AbstractGenerator::getCacheKey(Xapian::docid docId,
+	const vector<string> &seedTerms)
+{
+	char numStr[64];
+
+	if (m_indexName.empty() == true)
+	{
+		return "";
+	}
+
+	string cacheKey(m_indexName);
+	try
+	{
+		Xapian::Document doc(m_pIndex->get_document(docId));
+
+		// The document's date and length change with its content
+		snprintf(numStr, 64, "\n%u\n%u\n", docId, m_pIndex->get_doclength(docId));
+		cacheKey += numStr;
+		cacheKey += doc.get_value(4);
+	}
+	catch (const Xapian::Error &error)
+	{
+		return "";
+	}
+
+	for (vector<string>::const_iterator termIter = seedTerms.begin();
+		termIter != seedTerms.end(); ++termIter)
+	{
+		cacheKey += " ";
+		cacheKey += *termIter;
+	}
+
+	return cacheKey;
+}
+
+bool AbstractGenerator::getCachedAbstract(const string &cacheKey, string &summary)
+{
+	bool foundAbstract = false;
+
+	if (pthread_mutex_lock(&m_cacheMutex) == 0)
+	{
+		map<string, list<pair<string, string> >::iterator>::iterator indexIter = m_cachedAbstractsIndex.find(cacheKey);
+		if (indexIter != m_cachedAbstractsIndex.end())
+		{
+			// Move to the front
+			m_cachedAbstracts.splice(m_cachedAbstracts.begin(), m_cachedAbstracts, indexIter->second);
+			summary = indexIter->second->second;
+			foundAbstract = true;
+		}
+
+		pthread_mutex_unlock(&m_cacheMutex);
+	}
+
+	return foundAbstract;
+}
+
+void AbstractGenerator::setCachedAbstract(const string &cacheKey, const string &summary)
+{
+	if (pthread_mutex_lock(&m_cacheMutex) == 0)
+	{
+		if (m_cachedAbstractsIndex.find(cacheKey) == m_cachedAbstractsIndex.end())
+		{
+			m_cachedAbstracts.push_front(pair<string, string>(cacheKey, summary));
+			m_cachedAbstractsIndex[cacheKey] = m_cachedAbstracts.begin();
+
+			// Evict the least recently used
+			while (m_cachedAbstracts.size() > m_maxCachedAbstracts)
+			{
+				m_cachedAbstractsIndex.erase(m_cachedAbstracts.back().first);
+				m_cachedAbstracts.pop_back();
+			}
+		}
+
+		pthread_mutex_unlock(&m_cacheMutex);
+	}
+}
+
 /// Attempts to generate an abstract of wordsCount words.
 string AbstractGenerator::generateAbstract(Xapian::docid docId,
 	const vector<string> &seedTerms)
@@ -83,6 +333,13 @@ string AbstractGenerator::generateAbstract(Xapian::docid docId,
 		return "";
 	}
 
+	string cacheKey(getCacheKey(docId, seedTerms));
+	if ((cacheKey.empty() == false) &&
+		(getCachedAbstract(cacheKey, summary) == true))
+	{
+		return summary;
+	}
+
 #ifdef DEBUG
 	Timer timer;
 	timer.start();
@@ -195,7 +452,14 @@ string AbstractGenerator::generateAbstract(Xapian::docid docId,
 		<< bestPosition << ":" << startPosition << " with weight " << bestWeight << endl;
 #endif
 
-	try
+	// Words may have been stored at index time
+	if (getStoredWords(docId, startPosition, wordsBuffer) == true)
+	{
+#ifdef DEBUG
+		clog << "AbstractGenerator::generateAbstract: " << wordsBuffer.size() << " stored words" << endl;
+#endif
+	}
+	else try
 	{
 		// Go through the position list of each term
 		for (Xapian::TermIterator termIter = m_pIndex->termlist_begin(docId);
@@ -203,14 +467,7 @@ string AbstractGenerator::generateAbstract(Xapian::docid docId,
 		{
 			string termName(*termIter);
 
-			// Skip prefixed terms
-			if (isupper((int)termName[0]) != 0)
-			{
-				continue;
-			}
-			// Skip multi-character CJKV terms
-			if ((tokenizer.has_cjkv(termName) == true) &&
-				(termName.length() > 4))
+			if (isAbstractWord(tokenizer, termName) == false)
 			{
 				continue;
 			}
@@ -284,5 +541,10 @@ string AbstractGenerator::generateAbstract(Xapian::docid docId,
 		<< docId << " in " << timer.stop() << " ms" << endl;
 #endif
 
+	if (cacheKey.empty() == false)
+	{
+		setCachedAbstract(cacheKey, summary);
+	}
+
 	return summary;
 }
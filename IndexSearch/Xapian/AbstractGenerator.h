@@ -19,18 +19,28 @@
 #ifndef _ABSTRACT_GENERATOR_H
 #define _ABSTRACT_GENERATOR_H
 
+#include <pthread.h>
 #include <string>
 #include <vector>
+#include <map>
+#include <list>
+#include <utility>
 
 #include <xapian.h>
 
+#include "CJKVTokenizer.h"
+
 /// Generates abstracts for indexed documents.
 class AbstractGenerator
 {
 	public:
-		AbstractGenerator(const Xapian::Database *pIndex, unsigned int wordsCount);
+		AbstractGenerator(const Xapian::Database *pIndex, unsigned int wordsCount,
+			const std::string &indexName = "");
 		virtual ~AbstractGenerator();
 
+		/// Stores the document's words by position so that abstracts are quicker to generate.
+		static void storeWords(Xapian::Document &doc);
+
 		/// Attempts to generate an abstract of wordsCount words.
 		std::string generateAbstract(Xapian::docid docId,
 			const std::vector<std::string> &seedTerms);
@@ -38,8 +48,27 @@ class AbstractGenerator
 	protected:
 		static unsigned int m_maxSeedTerms;
 		static unsigned int m_minTermPositions;
+		static Xapian::valueno m_wordsValue;
+		static unsigned int m_maxStoredWords;
+		static unsigned int m_maxCachedAbstracts;
+		static pthread_mutex_t m_cacheMutex;
+		static std::list<std::pair<std::string, std::string> > m_cachedAbstracts;
+		static std::map<std::string, std::list<std::pair<std::string, std::string> >::iterator> m_cachedAbstractsIndex;
 		const Xapian::Database *m_pIndex;
 		unsigned int m_wordsCount;
+		std::string m_indexName;
+
+		static bool isAbstractWord(Dijon::CJKVTokenizer &tokenizer, const std::string &termName);
+
+		bool getStoredWords(Xapian::docid docId, Xapian::termpos startPosition,
+			std::map<Xapian::termpos, std::string> &wordsBuffer);
+
+		std::string getCacheKey(Xapian::docid docId,
+			const std::vector<std::string> &seedTerms);
+
+		static bool getCachedAbstract(const std::string &cacheKey, std::string &summary);
+
+		static void setCachedAbstract(const std::string &cacheKey, const std::string &summary);
 
 		class PositionWindow
 		{
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "config.h"
 #include "Visibility.h"
@@ -28,6 +29,7 @@
 #include "XapianIndex.h"
 
 using std::string;
+using std::vector;
 
 extern "C"
 {
@@ -35,7 +37,7 @@ extern "C"
 	PINOT_EXPORT bool openOrCreateIndex(const string &databaseName, bool &obsoleteFormat,
 		bool readOnly, bool overwrite);
 	PINOT_EXPORT bool mergeIndexes(const string &mergedDatabaseName,
-		const string &firstDatabaseName, const string &secondDatabaseName);
+		const vector<string> &databaseNames);
 	PINOT_EXPORT IndexInterface *getIndex(const string &databaseName);
 	PINOT_EXPORT SearchEngineInterface *getSearchEngine(const string &databaseName);
 	PINOT_EXPORT void setFieldMapper(FieldMapperInterface *pMapper);
@@ -64,24 +66,35 @@ bool openOrCreateIndex(const string &databaseName, bool &obsoleteFormat,
 }
 
 bool mergeIndexes(const string &mergedDatabaseName,
-	const string &firstDatabaseName, const string &secondDatabaseName)
+	const vector<string> &databaseNames)
 {
-	// Assume both have already been open
-	XapianDatabase *pFirstDb = XapianDatabaseFactory::getDatabase(firstDatabaseName);
-	if ((pFirstDb == NULL) ||
-		(pFirstDb->isOpen() == false))
+	vector<XapianDatabase *> shards;
+	bool foundOpenDb = false;
+
+	// Assume they have already been open
+	for (vector<string>::const_iterator nameIter = databaseNames.begin();
+		nameIter != databaseNames.end(); ++nameIter)
 	{
-		return false;
+		XapianDatabase *pDb = XapianDatabaseFactory::getDatabase(*nameIter);
+
+		// Those that couldn't be open may be later on
+		if (pDb == NULL)
+		{
+			continue;
+		}
+		if (pDb->isOpen() == true)
+		{
+			foundOpenDb = true;
+		}
+		shards.push_back(pDb);
 	}
-	XapianDatabase *pSecondDb = XapianDatabaseFactory::getDatabase(secondDatabaseName);
-	if ((pSecondDb == NULL) ||
-		(pSecondDb->isOpen() == false))
+	if (foundOpenDb == false)
 	{
 		return false;
 	}
 
 	// Merge them
-	return XapianDatabaseFactory::mergeDatabases(mergedDatabaseName, pFirstDb, pSecondDb);
+	return XapianDatabaseFactory::mergeDatabases(mergedDatabaseName, shards);
 }
 
 IndexInterface *getIndex(const string &databaseName)
@@ -24,15 +24,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
-#ifdef HAVE_REGEX_H
-#include <regex.h>
-#endif
 #include <stdio.h>
 #include <sstream>
 #include <iostream>
 
 #include "StringManip.h"
-#include "TimeConverter.h"
+#include "Timer.h"
 #include "Url.h"
 #include "FieldMapperInterface.h"
 #include "XapianDatabase.h"
@@ -42,11 +39,35 @@ using std::clog;
 using std::endl;
 using std::string;
 using std::stringstream;
+using std::set;
+using std::vector;
 
 extern FieldMapperInterface *g_pMapper;
 
 // This puts a limit to terms length.
 const unsigned int XapianDatabase::m_maxTermLength = 230;
+// Lock waits under 1, 10, 100, 1000 ms, and longer.
+const unsigned int XapianDatabase::m_lockWaitsBucketsCount = 5;
+// Version of binary document records.
+const unsigned int XapianDatabase::m_recordVersion = 1;
+
+XapianDatabase::ThreadState::ThreadState(XapianDatabase *pOwner) :
+	m_pOwner(pOwner),
+	m_pSnapshot(NULL),
+	m_snapshotRevision(0),
+	m_writeRevision(0),
+	m_lockType(NOT_LOCKED),
+	m_committed(false)
+{
+}
+
+XapianDatabase::ThreadState::~ThreadState()
+{
+	if (m_pSnapshot != NULL)
+	{
+		delete m_pSnapshot;
+	}
+}
 
 XapianDatabase::XapianDatabase(const string &databaseName,
 	bool readOnly, bool overwrite) :
@@ -55,30 +76,45 @@ XapianDatabase::XapianDatabase(const string &databaseName,
 	m_readOnly(readOnly),
 	m_overwrite(overwrite),
 	m_obsoleteFormat(false),
+	m_revision(1),
+	m_commitRevision(1),
+	m_pendingChanges(false),
 	m_pDatabase(NULL),
 	m_isOpen(false),
-	m_merge(false),
-	m_pFirst(NULL),
-	m_pSecond(NULL)
+	m_isLocal(false),
+	m_merge(false)
 {
 	initializeLock();
 	openDatabase();
 }
 
-XapianDatabase::XapianDatabase(const string &databaseName, 
-	XapianDatabase *pFirst, XapianDatabase *pSecond) :
+XapianDatabase::XapianDatabase(const string &databaseName,
+	const vector<XapianDatabase *> &shards) :
 	m_databaseName(databaseName),
 	m_withSpelling(true),
 	m_readOnly(true),
 	m_overwrite(false),
 	m_obsoleteFormat(false),
+	m_revision(1),
+	m_commitRevision(1),
+	m_pendingChanges(false),
 	m_pDatabase(NULL),
-	m_isOpen(pFirst->m_isOpen),
+	m_isOpen(false),
+	m_isLocal(false),
 	m_merge(true),
-	m_pFirst(pFirst),
-	m_pSecond(pSecond)
+	m_shards(shards)
 {
 	initializeLock();
+
+	// Shards that can't be opened yet are skipped until they can
+	for (vector<XapianDatabase *>::const_iterator shardIter = m_shards.begin();
+		shardIter != m_shards.end(); ++shardIter)
+	{
+		if ((*shardIter)->isOpen() == true)
+		{
+			m_isOpen = true;
+		}
+	}
 }
 
 XapianDatabase::XapianDatabase(const XapianDatabase &other) :
@@ -87,11 +123,14 @@ XapianDatabase::XapianDatabase(const XapianDatabase &other) :
 	m_readOnly(other.m_readOnly),
 	m_overwrite(other.m_overwrite),
 	m_obsoleteFormat(other.m_obsoleteFormat),
+	m_revision(1),
+	m_commitRevision(1),
+	m_pendingChanges(false),
 	m_pDatabase(NULL),
 	m_isOpen(other.m_isOpen),
+	m_isLocal(other.m_isLocal),
 	m_merge(other.m_merge),
-	m_pFirst(other.m_pFirst),
-	m_pSecond(other.m_pSecond)
+	m_shards(other.m_shards)
 {
 	initializeLock();
 	if (other.m_pDatabase != NULL)
@@ -102,10 +141,20 @@ XapianDatabase::XapianDatabase(const XapianDatabase &other) :
 
 XapianDatabase::~XapianDatabase()
 {
+	// Threads that exit from now on won't release their state
+	pthread_key_delete(m_threadKey);
+	for (set<ThreadState *>::iterator stateIter = m_threadStates.begin();
+		stateIter != m_threadStates.end(); ++stateIter)
+	{
+		delete *stateIter;
+	}
+	m_threadStates.clear();
+
 	if (m_pDatabase != NULL)
 	{
 		delete m_pDatabase;
 	}
+	pthread_mutex_destroy(&m_stateLock);
 	pthread_mutex_destroy(&m_rwLock);
 }
 
@@ -128,9 +177,9 @@ XapianDatabase &XapianDatabase::operator=(const XapianDatabase &other)
 			m_pDatabase = new Xapian::Database(*other.m_pDatabase);
 		}
 		m_isOpen = other.m_isOpen;
+		m_isLocal = other.m_isLocal;
 		m_merge = other.m_merge;
-		m_pFirst = other.m_pFirst;
-		m_pSecond = other.m_pSecond;
+		m_shards = other.m_shards;
 	}
 
 	return *this;
@@ -139,6 +188,206 @@ XapianDatabase &XapianDatabase::operator=(const XapianDatabase &other)
 void XapianDatabase::initializeLock(void)
 {
 	pthread_mutex_init(&m_rwLock, NULL);
+	pthread_mutex_init(&m_stateLock, NULL);
+	pthread_key_create(&m_threadKey, XapianDatabase::deleteThreadState);
+	m_readWaits.resize(m_lockWaitsBucketsCount, 0);
+	m_writeWaits.resize(m_lockWaitsBucketsCount, 0);
+}
+
+void XapianDatabase::deleteThreadState(void *pData)
+{
+	ThreadState *pState = static_cast<ThreadState *>(pData);
+
+	if (pState == NULL)
+	{
+		return;
+	}
+
+	XapianDatabase *pOwner = pState->m_pOwner;
+	if (pthread_mutex_lock(&pOwner->m_stateLock) == 0)
+	{
+		pOwner->m_threadStates.erase(pState);
+
+		pthread_mutex_unlock(&pOwner->m_stateLock);
+	}
+
+	delete pState;
+}
+
+XapianDatabase::ThreadState *XapianDatabase::getThreadState(void)
+{
+	ThreadState *pState = static_cast<ThreadState *>(pthread_getspecific(m_threadKey));
+
+	if (pState == NULL)
+	{
+		pState = new ThreadState(this);
+
+		pthread_setspecific(m_threadKey, pState);
+		if (pthread_mutex_lock(&m_stateLock) == 0)
+		{
+			m_threadStates.insert(pState);
+
+			pthread_mutex_unlock(&m_stateLock);
+		}
+	}
+
+	return pState;
+}
+
+Xapian::Database *XapianDatabase::snapshotLock(ThreadState *pState,
+	bool withPendingChanges)
+{
+	unsigned int revision = 0;
+	bool readShared = false;
+	Timer waitTimer;
+
+	// Readers wait until the snapshot is ready
+	waitTimer.start();
+	if (pthread_mutex_lock(&m_stateLock) != 0)
+	{
+		return NULL;
+	}
+	revision = m_revision;
+	// Are there changes that haven't been committed yet, made by this thread or wanted by the caller ?
+	if ((m_pendingChanges == true) &&
+		((withPendingChanges == true) || (pState->m_writeRevision > m_commitRevision)))
+	{
+		readShared = true;
+	}
+	pthread_mutex_unlock(&m_stateLock);
+
+	if (readShared == true)
+	{
+		// Only the shared database has these changes
+		return NULL;
+	}
+
+	try
+	{
+		if (pState->m_pSnapshot == NULL)
+		{
+			pState->m_pSnapshot = new Xapian::Database(m_databaseName);
+		}
+		else if (pState->m_snapshotRevision != revision)
+		{
+			pState->m_pSnapshot->reopen();
+		}
+		pState->m_snapshotRevision = revision;
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't open snapshot of " << m_databaseName << ": " << error.get_type()
+			<< ": " << error.get_msg() << endl;
+
+		if (pState->m_pSnapshot != NULL)
+		{
+			delete pState->m_pSnapshot;
+			pState->m_pSnapshot = NULL;
+		}
+
+		return NULL;
+	}
+	recordLockWait(false, waitTimer.stop());
+
+	pState->m_lockType = ThreadState::SNAPSHOT_LOCK;
+
+	return pState->m_pSnapshot;
+}
+
+Xapian::Database *XapianDatabase::mergeLock(ThreadState *pState)
+{
+	vector<Xapian::Database *> shardsDatabases;
+	bool foundShard = false;
+
+	// Lock all shards, they stay locked until unlock() is called
+	for (vector<XapianDatabase *>::const_iterator shardIter = m_shards.begin();
+		shardIter != m_shards.end(); ++shardIter)
+	{
+		Xapian::Database *pShardDatabase = (*shardIter)->readLock();
+
+		// Leave it out for now if it's NULL
+		shardsDatabases.push_back(pShardDatabase);
+		if (pShardDatabase != NULL)
+		{
+			foundShard = true;
+		}
+	}
+	pState->m_lockType = ThreadState::SNAPSHOT_LOCK;
+
+	if (foundShard == false)
+	{
+		return NULL;
+	}
+
+	// The merge shares the shards' databases, so it sees whatever they were reopened to
+	if ((pState->m_pSnapshot != NULL) &&
+		(pState->m_shardsDatabases == shardsDatabases))
+	{
+		return pState->m_pSnapshot;
+	}
+
+	try
+	{
+		// Each thread keeps its own merge, and only rebuilds it when shards hand out other databases
+		Xapian::Database *pMerge = new Xapian::Database();
+
+		for (vector<Xapian::Database *>::const_iterator dbIter = shardsDatabases.begin();
+			dbIter != shardsDatabases.end(); ++dbIter)
+		{
+			if (*dbIter != NULL)
+			{
+				pMerge->add_database(*(*dbIter));
+			}
+		}
+
+		if (pState->m_pSnapshot != NULL)
+		{
+			delete pState->m_pSnapshot;
+		}
+		pState->m_pSnapshot = pMerge;
+		pState->m_shardsDatabases = shardsDatabases;
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't merge shards of " << m_databaseName << ": " << error.get_type()
+			<< ": " << error.get_msg() << endl;
+
+		if (pState->m_pSnapshot != NULL)
+		{
+			delete pState->m_pSnapshot;
+			pState->m_pSnapshot = NULL;
+		}
+		pState->m_shardsDatabases.clear();
+	}
+
+	return pState->m_pSnapshot;
+}
+
+void XapianDatabase::recordLockWait(bool writeLock, long waitTime)
+{
+	unsigned int bucket = 0;
+	long bucketLimit = 1;
+
+	while ((bucket < m_lockWaitsBucketsCount - 1) &&
+		(waitTime >= bucketLimit))
+	{
+		bucketLimit *= 10;
+		++bucket;
+	}
+
+	if (pthread_mutex_lock(&m_stateLock) == 0)
+	{
+		if (writeLock == true)
+		{
+			++m_writeWaits[bucket];
+		}
+		else
+		{
+			++m_readWaits[bucket];
+		}
+
+		pthread_mutex_unlock(&m_stateLock);
+	}
 }
 
 void XapianDatabase::openDatabase(void)
@@ -326,7 +575,16 @@ void XapianDatabase::openDatabase(void)
 			clog << "XapianDatabase::openDatabase: opened " << m_databaseName
 				<< " " << m_pDatabase->get_description() << endl;
 #endif
+			if (checkRecordVersion() == false)
+			{
+				delete m_pDatabase;
+				m_pDatabase = NULL;
+
+				return;
+			}
+
 			m_isOpen = true;
+			m_isLocal = true;
 		}
 
 		return;
@@ -361,6 +619,47 @@ void XapianDatabase::openDatabase(void)
 	}
 }
 
+bool XapianDatabase::checkRecordVersion(void)
+{
+#if ENABLE_XAPIAN_DB_METADATA>0
+	string versionStr(m_pDatabase->get_metadata("record-version"));
+	unsigned int version = 0;
+
+	if (versionStr.empty() == false)
+	{
+		version = (unsigned int)atoi(versionStr.c_str());
+	}
+
+	// Records written by later versions can't be read
+	if (version > m_recordVersion)
+	{
+		clog << "Couldn't open " << m_databaseName << ", its records are version " << version << endl;
+		return false;
+	}
+
+	// Let readers know which version records may be in before any is written
+	if ((version < m_recordVersion) &&
+		(m_readOnly == false))
+	{
+		Xapian::WritableDatabase *pIndex = dynamic_cast<Xapian::WritableDatabase *>(m_pDatabase);
+
+		if (pIndex != NULL)
+		{
+			stringstream recordVersion;
+
+			recordVersion << m_recordVersion;
+			pIndex->set_metadata("record-version", recordVersion.str());
+#ifdef DEBUG
+			clog << "XapianDatabase::checkRecordVersion: " << m_databaseName
+				<< " records were version " << version << endl;
+#endif
+		}
+	}
+#endif
+
+	return true;
+}
+
 /// Returns true if the database supports spelling.
 bool XapianDatabase::withSpelling(void)
 {
@@ -401,6 +700,43 @@ bool XapianDatabase::wasObsoleteFormat(void) const
 /// Reopens the database.
 void XapianDatabase::reopen(void)
 {
+	if (m_merge == true)
+	{
+		// Reopen the shards, the cached merge shares their databases
+		for (vector<XapianDatabase *>::const_iterator shardIter = m_shards.begin();
+			shardIter != m_shards.end(); ++shardIter)
+		{
+			(*shardIter)->reopen();
+		}
+		return;
+	}
+
+	ThreadState *pState = getThreadState();
+
+	// This thread's snapshot gets the latest revision, including changes made by other processes
+	if ((pState->m_pSnapshot != NULL) &&
+		(pState->m_lockType == ThreadState::NOT_LOCKED))
+	{
+		try
+		{
+			pState->m_pSnapshot->reopen();
+		}
+		catch (const Xapian::Error &error)
+		{
+			clog << "Couldn't reopen snapshot of " << m_databaseName << ": " << error.get_type()
+				<< ": " << error.get_msg() << endl;
+
+			delete pState->m_pSnapshot;
+			pState->m_pSnapshot = NULL;
+		}
+	}
+
+	// The writer always has the latest revision
+	if (m_readOnly == false)
+	{
+		return;
+	}
+
 	// This is provided by Xapian::Database
 	if (pthread_mutex_lock(&m_rwLock) == 0)
 	{
@@ -413,58 +749,72 @@ void XapianDatabase::reopen(void)
 	}
 }
 
+/// Records that pending changes were committed; call before unlock().
+void XapianDatabase::markCommitted(void)
+{
+	ThreadState *pState = getThreadState();
+
+	if (pState->m_lockType == ThreadState::WRITE_LOCK)
+	{
+		pState->m_committed = true;
+	}
+}
+
+/// Returns the number of write locks released through this object.
+unsigned int XapianDatabase::getRevision(void)
+{
+	unsigned int revision = 0;
+
+	if (pthread_mutex_lock(&m_stateLock) == 0)
+	{
+		revision = m_revision;
+
+		pthread_mutex_unlock(&m_stateLock);
+	}
+
+	return revision;
+}
+
 /// Attempts to lock and retrieve the database.
-Xapian::Database *XapianDatabase::readLock(void)
+Xapian::Database *XapianDatabase::readLock(bool withPendingChanges)
 {
 	if (m_merge == false)
 	{
-		if (pthread_mutex_lock(&m_rwLock) == 0)
+		ThreadState *pState = getThreadState();
+		Timer waitTimer;
+
+		// Local databases can be read without blocking the writer
+		if (m_isLocal == true)
 		{
-			if (m_pDatabase == NULL)
+			Xapian::Database *pSnapshot = snapshotLock(pState, withPendingChanges);
+
+			if (pSnapshot != NULL)
 			{
-				// Try again
-				openDatabase();
+				return pSnapshot;
 			}
-			return m_pDatabase;
-		}
-#ifdef DEBUG
-		else clog << "XapianDatabase::readLock: failed" << endl;
-#endif
-	}
-	else
-	{
-		if ((m_pFirst == NULL) ||
-			(m_pFirst->isOpen() == false) ||
-			(m_pSecond == NULL) ||
-			(m_pSecond->isOpen() == false))
-		{
-			return NULL;
 		}
 
+		waitTimer.start();
 		if (pthread_mutex_lock(&m_rwLock) == 0)
 		{
-			// Reopen the second index
-			m_pSecond->reopen();
+			recordLockWait(false, waitTimer.stop());
+			pState->m_lockType = ThreadState::SHARED_LOCK;
 
-			// Lock both indexes
-			Xapian::Database *pFirstDatabase = m_pFirst->readLock();
-			Xapian::Database *pSecondDatabase = m_pSecond->readLock();
-			if ((pFirstDatabase != NULL) &&
-				(pSecondDatabase != NULL))
+			if (m_pDatabase == NULL)
 			{
-				// Copy the first one
-				m_pDatabase = new Xapian::Database(*pFirstDatabase);
-				// Add the second index to it
-				m_pDatabase->add_database(*pSecondDatabase);
-				// Until unlock() is called, both indexes are read locked
+				// Try again
+				openDatabase();
 			}
-
 			return m_pDatabase;
 		}
 #ifdef DEBUG
 		else clog << "XapianDatabase::readLock: failed" << endl;
 #endif
 	}
+	else
+	{
+		return mergeLock(getThreadState());
+	}
 
 	return NULL;
 }
@@ -472,6 +822,8 @@ Xapian::Database *XapianDatabase::readLock(void)
 /// Attempts to lock and retrieve the database.
 Xapian::WritableDatabase *XapianDatabase::writeLock(void)
 {
+	Timer waitTimer;
+
 	if ((m_readOnly == true) ||
 		(m_merge == true))
 	{
@@ -480,8 +832,15 @@ Xapian::WritableDatabase *XapianDatabase::writeLock(void)
 		return NULL;
 	}
 
+	waitTimer.start();
 	if (pthread_mutex_lock(&m_rwLock) == 0)
 	{
+		ThreadState *pState = getThreadState();
+
+		recordLockWait(true, waitTimer.stop());
+		pState->m_lockType = ThreadState::WRITE_LOCK;
+		pState->m_committed = false;
+
 		if (m_pDatabase == NULL)
 		{
 			// Try again
@@ -500,142 +859,202 @@ Xapian::WritableDatabase *XapianDatabase::writeLock(void)
 /// Unlocks the database.
 void XapianDatabase::unlock(void)
 {
-	if (pthread_mutex_unlock(&m_rwLock) != 0)
+	ThreadState *pState = getThreadState();
+
+	if (pState->m_lockType == ThreadState::NOT_LOCKED)
 	{
 #ifdef DEBUG
-		clog << "XapianDatabase::unlock: failed" << endl;
+		clog << "XapianDatabase::unlock: not locked" << endl;
 #endif
+		return;
 	}
-
-	if (m_merge == true)
+	else if (m_merge == true)
 	{
-		// Unlock the original indexes
-		if (m_pFirst != NULL)
-		{
-			m_pFirst->unlock();
-		}
-		if (m_pSecond != NULL)
-		{
-			m_pSecond->unlock();
-		}
+		pState->m_lockType = ThreadState::NOT_LOCKED;
 
-		// Delete merge
-		if (m_pDatabase != NULL)
+		// Unlock the shards, the merge itself belongs to this thread
+		for (vector<XapianDatabase *>::const_iterator shardIter = m_shards.begin();
+			shardIter != m_shards.end(); ++shardIter)
 		{
-			delete m_pDatabase;
-			m_pDatabase = NULL;
+			(*shardIter)->unlock();
 		}
+		return;
 	}
-}
-
-bool XapianDatabase::badRecordField(const string &field)
-{
-	bool isBadField = false;
-#ifdef HAVE_REGEX_H
-	regex_t fieldRegex;
-	regmatch_t pFieldMatches[1];
-
-	// A bad field is one that includes one of our field delimiters
-	if (regcomp(&fieldRegex,
-		"(url|ipath|sample|caption|type|modtime|language|size)=",
-		REG_EXTENDED|REG_ICASE) == 0)
+	else if (pState->m_lockType == ThreadState::SNAPSHOT_LOCK)
+	{
+		// Nothing to release
+		pState->m_lockType = ThreadState::NOT_LOCKED;
+		return;
+	}
+	else if (pState->m_lockType == ThreadState::WRITE_LOCK)
 	{
-		if (regexec(&fieldRegex, field.c_str(), 1,
-			pFieldMatches, REG_NOTBOL|REG_NOTEOL) == 0)
+		if (pthread_mutex_lock(&m_stateLock) == 0)
 		{
-			isBadField = true;
+			// Snapshots will have to be reopened, even without an explicit flush
+			// Xapian may have flushed on its own once XAPIAN_FLUSH_THRESHOLD was reached
+			++m_revision;
+			if (pState->m_committed == true)
+			{
+				m_commitRevision = m_revision;
+				m_pendingChanges = false;
+			}
+			else
+			{
+				// Until the next commit, this thread reads from the shared database
+				m_pendingChanges = true;
+				pState->m_writeRevision = m_revision;
+			}
+
+			pthread_mutex_unlock(&m_stateLock);
 		}
+		pState->m_committed = false;
 	}
-	regfree(&fieldRegex);
-#else
-	// A bad field is one that includes one of our field delimiters
-	if ((field.find("url=") != string::npos) ||
-		(field.find("ipath=") != string::npos) ||
-		(field.find("sample=") != string::npos) ||
-		(field.find("caption=") != string::npos) ||
-		(field.find("type=") != string::npos) ||
-		(field.find("modtime=") != string::npos) ||
-		(field.find("language=") != string::npos) ||
-		(field.find("size=") != string::npos))
-	{
-		isBadField = true;
-	}
-#endif
+	pState->m_lockType = ThreadState::NOT_LOCKED;
 
-	return isBadField;
+	if (pthread_mutex_unlock(&m_rwLock) != 0)
+	{
+#ifdef DEBUG
+		clog << "XapianDatabase::unlock: failed" << endl;
+#endif
+	}
 }
 
-/// Returns a record for the document's properties.
-string XapianDatabase::propsToRecord(DocumentInfo *pDoc)
+/// Gets the histograms of lock waits.
+void XapianDatabase::getLockWaits(vector<unsigned int> &readWaits,
+	vector<unsigned int> &writeWaits)
 {
-	string record;
-
-	if (pDoc == NULL)
+	if (pthread_mutex_lock(&m_stateLock) == 0)
 	{
-		return "";
+		readWaits = m_readWaits;
+		writeWaits = m_writeWaits;
+
+		pthread_mutex_unlock(&m_stateLock);
 	}
+}
 
-	if (g_pMapper != NULL)
+void XapianDatabase::appendVarint(string &data, unsigned long long value)
+{
+	// Seven bits at a time, lowest bits first
+	while (value >= 0x80)
 	{
-		g_pMapper->toRecord(pDoc, record);
+		data += (char)((value & 0x7f) | 0x80);
+		value >>= 7;
 	}
+	data += (char)value;
+}
 
-	string title(pDoc->getTitle());
-	string timestamp(pDoc->getTimestamp());
-	time_t timeT = TimeConverter::fromTimestamp(timestamp);
+bool XapianDatabase::readVarint(const string &data, string::size_type &pos,
+	unsigned long long &value)
+{
+	unsigned int shift = 0;
 
-	// Set the document data omindex-style
-	record += "url=";
-	record += pDoc->getLocation();
-	record += "\nipath=";
-	record += Url::escapeUrl(pDoc->getInternalPath());
-	// The sample will be generated at query time
-	record += "\nsample=";
-	record += "\ncaption=";
-	if (badRecordField(title) == true)
+	value = 0;
+	while ((pos < data.length()) &&
+		(shift < 64))
 	{
-		// Modify the title if necessary
-		string::size_type pos = title.find("=");
-		while (pos != string::npos)
+		unsigned char byte = (unsigned char)data[pos];
+
+		++pos;
+		value |= ((unsigned long long)(byte & 0x7f)) << shift;
+		if ((byte & 0x80) == 0)
 		{
-			title[pos] = ' ';
-			pos = title.find("=", pos + 1);
+			return true;
 		}
-#ifdef DEBUG
-		clog << "XapianDatabase::propsToRecord: modified title" << endl;
-#endif
+		shift += 7;
 	}
-	record += title;
-	record += "\ntype=";
-	record += pDoc->getType();
-	// Append a timestamp, in a format compatible with Omega
-	record += "\nmodtime=";
-	stringstream timeStream;
-	timeStream << timeT;
-	record += timeStream.str();
-	// ...and the language
-	record += "\nlanguage=";
-	record += pDoc->getLanguage();
-	// ...and the file size
-	record += "\nsize=";
-	stringstream sizeStream;
-	sizeStream << pDoc->getSize();
-	record += sizeStream.str();
-#ifdef DEBUG
-	clog << "XapianDatabase::propsToRecord: document data is " << record << endl;
-#endif
 
-	return record;
+	return false;
 }
 
-/// Sets the document's properties acording to the record.
-void XapianDatabase::recordToProps(const string &record, DocumentInfo *pDoc)
+void XapianDatabase::appendRecordField(string &record, RecordField field,
+	const string &value)
 {
-	if (pDoc == NULL)
+	if (value.empty() == true)
+	{
+		return;
+	}
+
+	appendVarint(record, (unsigned long long)field);
+	appendVarint(record, (unsigned long long)value.length());
+	record += value;
+}
+
+void XapianDatabase::binaryRecordToProps(const string &record, DocumentInfo *pDoc)
+{
+	string::size_type pos = 4;
+	unsigned long long fieldId = 0, length = 0;
+	unsigned int version = (unsigned int)(unsigned char)record[3];
+
+	// Later versions may not be laid out the same way
+	if (version > m_recordVersion)
 	{
+		clog << "Couldn't read record, version " << version << " is not supported" << endl;
 		return;
 	}
 
+	// Walk the fields, only copying those that are known
+	while ((readVarint(record, pos, fieldId) == true) &&
+		(readVarint(record, pos, length) == true))
+	{
+		if (length > record.length() - pos)
+		{
+			clog << "Couldn't read record, field " << fieldId << " is truncated" << endl;
+			break;
+		}
+
+		switch (fieldId)
+		{
+			case RECORD_URL:
+				pDoc->setLocation(Url::canonicalizeUrl(record.substr(pos, length)));
+				break;
+			case RECORD_IPATH:
+				pDoc->setInternalPath(record.substr(pos, length));
+				break;
+			case RECORD_CAPTION:
+				pDoc->setTitle(record.substr(pos, length));
+				break;
+			case RECORD_TYPE:
+				pDoc->setType(record.substr(pos, length));
+				break;
+			case RECORD_MODTIME:
+			case RECORD_SIZE:
+			{
+				string::size_type valuePos = pos;
+				unsigned long long value = 0;
+
+				if (readVarint(record, valuePos, value) == true)
+				{
+					if (fieldId == RECORD_MODTIME)
+					{
+						pDoc->setTime((time_t)value);
+					}
+					else
+					{
+						pDoc->setSize((off_t)value);
+					}
+				}
+				break;
+			}
+			case RECORD_LANGUAGE:
+				pDoc->setLanguage(record.substr(pos, length));
+				break;
+			case RECORD_MAPPER:
+				if (g_pMapper != NULL)
+				{
+					g_pMapper->fromRecord(pDoc, record.substr(pos, length));
+				}
+				break;
+			default:
+				// Fields added by later versions are skipped
+				break;
+		}
+
+		pos += length;
+	}
+}
+
+void XapianDatabase::textRecordToProps(const string &record, DocumentInfo *pDoc)
+{
 	if (g_pMapper != NULL)
 	{
 		g_pMapper->fromRecord(pDoc, record);
@@ -666,7 +1085,7 @@ void XapianDatabase::recordToProps(const string &record, DocumentInfo *pDoc)
 	if (modTime.empty() == false)
 	{
 		time_t timeT = (time_t )atol(modTime.c_str());
-		pDoc->setTimestamp(TimeConverter::toTimestamp(timeT));
+		pDoc->setTime(timeT);
 	}
 	string bytesSize(StringManip::extractField(record, "size=", ""));
 	if (bytesSize.empty() == false)
@@ -675,6 +1094,79 @@ void XapianDatabase::recordToProps(const string &record, DocumentInfo *pDoc)
 	}
 }
 
+/// Returns whether the record is in the binary format.
+bool XapianDatabase::isBinaryRecord(const string &record)
+{
+	// Text records never start with a NUL character
+	if ((record.length() >= 4) &&
+		(record[0] == '\0') &&
+		(record[1] == 'P') &&
+		(record[2] == 'R'))
+	{
+		return true;
+	}
+
+	return false;
+}
+
+/// Returns a record for the document's properties.
+string XapianDatabase::propsToRecord(DocumentInfo *pDoc)
+{
+	string record("\0PR", 3);
+
+	if (pDoc == NULL)
+	{
+		return "";
+	}
+
+	// Header and version
+	record += (char)m_recordVersion;
+
+	if (g_pMapper != NULL)
+	{
+		string mapperRecord;
+
+		g_pMapper->toRecord(pDoc, mapperRecord);
+		appendRecordField(record, RECORD_MAPPER, mapperRecord);
+	}
+
+	// Fields are length-prefixed, they don't need escaping
+	appendRecordField(record, RECORD_URL, pDoc->getLocation());
+	appendRecordField(record, RECORD_IPATH, pDoc->getInternalPath());
+	appendRecordField(record, RECORD_CAPTION, pDoc->getTitle());
+	appendRecordField(record, RECORD_TYPE, pDoc->getType());
+	appendRecordField(record, RECORD_LANGUAGE, pDoc->getLanguage());
+	// Numbers are stored as varints
+	string modTime, bytesSize;
+	appendVarint(modTime, (unsigned long long)pDoc->getTime());
+	appendRecordField(record, RECORD_MODTIME, modTime);
+	appendVarint(bytesSize, (unsigned long long)pDoc->getSize());
+	appendRecordField(record, RECORD_SIZE, bytesSize);
+#ifdef DEBUG
+	clog << "XapianDatabase::propsToRecord: document data is " << record.length() << " bytes long" << endl;
+#endif
+
+	return record;
+}
+
+/// Sets the document's properties acording to the record.
+void XapianDatabase::recordToProps(const string &record, DocumentInfo *pDoc)
+{
+	if (pDoc == NULL)
+	{
+		return;
+	}
+
+	if (isBinaryRecord(record) == true)
+	{
+		binaryRecordToProps(record, pDoc);
+	}
+	else
+	{
+		textRecordToProps(record, pDoc);
+	}
+}
+
 /// Returns the URL for the given document in the given index.
 string XapianDatabase::buildUrl(const string &database, unsigned int docId)
 {
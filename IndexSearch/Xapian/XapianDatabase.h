@@ -21,11 +21,22 @@
 
 #include <string>
 #include <set>
+#include <vector>
 #include <pthread.h>
 #include <xapian.h>
 
+#include "config.h"
 #include "DocumentInfo.h"
 
+#if !ENABLE_XAPIAN_DB_METADATA
+// Database metadata is only available in Xapian > 1.0.2
+#if XAPIAN_NUM_VERSION > 1000002
+#define ENABLE_XAPIAN_DB_METADATA 1
+#else
+#define ENABLE_XAPIAN_DB_METADATA 0
+#endif
+#endif
+
 /// Lockable Xapian database.
 class XapianDatabase
 {
@@ -33,7 +44,7 @@ class XapianDatabase
 		XapianDatabase(const std::string &databaseName,
 			bool readOnly = true, bool overwrite = false);
 		XapianDatabase(const std::string &databaseName,
-			XapianDatabase *pFirst, XapianDatabase *pSecond);
+			const std::vector<XapianDatabase *> &shards);
 		XapianDatabase(const XapianDatabase &other);
 		virtual ~XapianDatabase();
 
@@ -57,8 +68,19 @@ class XapianDatabase
 		/// Reopens the database.
 		void reopen(void);
 
-		/// Attempts to lock and retrieve the database.
-		Xapian::Database *readLock(void);
+		/// Records that pending changes were committed; call before unlock().
+		void markCommitted(void);
+
+		/// Returns the number of write locks released through this object.
+		unsigned int getRevision(void);
+
+		/**
+		  * Attempts to lock and retrieve the database.
+		  * Unless withPendingChanges is true, or the calling thread has uncommitted
+		  * changes, local databases are read through a per-thread snapshot that
+		  * doesn't block on writers.
+		  */
+		Xapian::Database *readLock(bool withPendingChanges = false);
 
 		/// Attempts to lock and retrieve the database.
 		Xapian::WritableDatabase *writeLock(void);
@@ -66,6 +88,17 @@ class XapianDatabase
 		/// Unlocks the database.
 		void unlock(void);
 
+		/**
+		  * Gets the histograms of lock waits.
+		  * Buckets count waits under 1, 10, 100 and 1000 milliseconds, and longer.
+		  * Snapshot reads are timed until the snapshot is open.
+		  */
+		void getLockWaits(std::vector<unsigned int> &readWaits,
+			std::vector<unsigned int> &writeWaits);
+
+		/// Returns whether the record is in the binary format.
+		static bool isBinaryRecord(const std::string &record);
+
 		/// Returns a record for the document's properties.
 		static std::string propsToRecord(DocumentInfo *pDoc);
 
@@ -79,24 +112,82 @@ class XapianDatabase
 		static std::string limitTermLength(const std::string &term, bool makeUnique = false);
 
 	protected:
+		/// Per-thread state.
+		class ThreadState
+		{
+			public:
+				ThreadState(XapianDatabase *pOwner);
+				~ThreadState();
+
+				typedef enum { NOT_LOCKED = 0, SNAPSHOT_LOCK, SHARED_LOCK, WRITE_LOCK } LockType;
+
+				XapianDatabase *m_pOwner;
+				Xapian::Database *m_pSnapshot;
+				unsigned int m_snapshotRevision;
+				unsigned int m_writeRevision;
+				std::vector<Xapian::Database *> m_shardsDatabases;
+				LockType m_lockType;
+				bool m_committed;
+
+			private:
+				ThreadState(const ThreadState &other);
+				ThreadState &operator=(const ThreadState &other);
+
+		};
+
+		typedef enum { RECORD_URL = 1, RECORD_IPATH, RECORD_CAPTION, RECORD_TYPE, RECORD_MODTIME,
+			RECORD_LANGUAGE, RECORD_SIZE, RECORD_MAPPER } RecordField;
+
 		static const unsigned int m_maxTermLength;
+		static const unsigned int m_lockWaitsBucketsCount;
+		static const unsigned int m_recordVersion;
 		std::string m_databaseName;
 		bool m_withSpelling;
 		bool m_readOnly;
 		bool m_overwrite;
 		bool m_obsoleteFormat;
 		pthread_mutex_t m_rwLock;
+		pthread_mutex_t m_stateLock;
+		pthread_key_t m_threadKey;
+		std::set<ThreadState *> m_threadStates;
+		unsigned int m_revision;
+		unsigned int m_commitRevision;
+		bool m_pendingChanges;
+		std::vector<unsigned int> m_readWaits;
+		std::vector<unsigned int> m_writeWaits;
 		Xapian::Database *m_pDatabase;
 		bool m_isOpen;
+		bool m_isLocal;
 		bool m_merge;
-		XapianDatabase *m_pFirst;
-		XapianDatabase *m_pSecond;
+		std::vector<XapianDatabase *> m_shards;
 
 		void initializeLock(void);
 
 		void openDatabase(void);
 
-		static bool badRecordField(const std::string &field);
+		bool checkRecordVersion(void);
+
+		ThreadState *getThreadState(void);
+
+		Xapian::Database *snapshotLock(ThreadState *pState, bool withPendingChanges);
+
+		Xapian::Database *mergeLock(ThreadState *pState);
+
+		void recordLockWait(bool writeLock, long waitTime);
+
+		static void deleteThreadState(void *pData);
+
+		static void appendVarint(std::string &data, unsigned long long value);
+
+		static bool readVarint(const std::string &data, std::string::size_type &pos,
+			unsigned long long &value);
+
+		static void appendRecordField(std::string &record, RecordField field,
+			const std::string &value);
+
+		static void binaryRecordToProps(const std::string &record, DocumentInfo *pDoc);
+
+		static void textRecordToProps(const std::string &record, DocumentInfo *pDoc);
 
 };
 
@@ -25,6 +25,27 @@ using std::endl;
 using std::string;
 using std::map;
 using std::pair;
+using std::vector;
+
+static void logLockWaits(const string &name, XapianDatabase *pDb)
+{
+	vector<unsigned int> readWaits, writeWaits;
+
+	pDb->getLockWaits(readWaits, writeWaits);
+	clog << "Lock waits on " << name << " (<1ms, <10ms, <100ms, <1s, longer): reads";
+	for (vector<unsigned int>::const_iterator waitIter = readWaits.begin();
+		waitIter != readWaits.end(); ++waitIter)
+	{
+		clog << " " << *waitIter;
+	}
+	clog << ", writes";
+	for (vector<unsigned int>::const_iterator waitIter = writeWaits.begin();
+		waitIter != writeWaits.end(); ++waitIter)
+	{
+		clog << " " << *waitIter;
+	}
+	clog << endl;
+}
 
 pthread_mutex_t XapianDatabaseFactory::m_mutex = PTHREAD_MUTEX_INITIALIZER;
 map<string, XapianDatabase *> XapianDatabaseFactory::m_databases;
@@ -38,36 +59,48 @@ XapianDatabaseFactory::~XapianDatabaseFactory()
 {
 }
 
-/// Merges two databases together and add the result to the list.
+/// Merges databases together and adds the result to the list.
 bool XapianDatabaseFactory::mergeDatabases(const string &name,
-	XapianDatabase *pFirst, XapianDatabase *pSecond)
+	const vector<XapianDatabase *> &shards)
 {
-	if (m_closed == true)
+	bool mergedDatabases = false;
+
+	if ((m_closed == true) ||
+		(shards.empty() == true))
 	{
 		return false;
 	}
 
-	map<string, XapianDatabase *>::iterator dbIter = m_databases.find(name);
-	if (dbIter != m_databases.end())
+	// Lock the map
+	if (pthread_mutex_lock(&m_mutex) != 0)
 	{
 		return false;
 	}
 
-	// Create the new database
-	XapianDatabase *pDb = new XapianDatabase(name, pFirst, pSecond);
-
-	// Insert it into the map
-	pair<map<string, XapianDatabase *>::iterator, bool> insertPair = m_databases.insert(pair<string, XapianDatabase *>(name, pDb));
-	// Was it inserted ?
-	if (insertPair.second == false)
+	map<string, XapianDatabase *>::iterator dbIter = m_databases.find(name);
+	if (dbIter == m_databases.end())
 	{
-		// No, it wasn't : delete the object
-		delete pDb;
+		// Create the new database
+		XapianDatabase *pDb = new XapianDatabase(name, shards);
 
-		return false;
+		// Insert it into the map
+		pair<map<string, XapianDatabase *>::iterator, bool> insertPair = m_databases.insert(pair<string, XapianDatabase *>(name, pDb));
+		// Was it inserted ?
+		if (insertPair.second == false)
+		{
+			// No, it wasn't : delete the object
+			delete pDb;
+		}
+		else
+		{
+			mergedDatabases = true;
+		}
 	}
 
-	return true;
+	// Unlock the map
+	pthread_mutex_unlock(&m_mutex);
+
+	return mergedDatabases;
 }
 
 /// Returns a XapianDatabase pointer; NULL if unavailable.
@@ -185,6 +218,8 @@ void XapianDatabaseFactory::closeAll(void)
 		clog << "XapianDatabaseFactory::closeAll: closing " << dbIter->first << endl;
 #endif
 
+		logLockWaits(dbIter->first, pDb);
+
 		// Remove from the map
 		dbIter->second = NULL;
 		m_databases.erase(dbIter);
@@ -22,6 +22,7 @@
 #include <pthread.h>
 #include <string>
 #include <map>
+#include <vector>
 
 #include "XapianDatabase.h"
 
@@ -31,9 +32,9 @@ class XapianDatabaseFactory
 	public:
 		virtual ~XapianDatabaseFactory();
 
-		/// Merges two databases together and add the result to the list.
+		/// Merges databases together and adds the result to the list.
 		static bool mergeDatabases(const std::string &name,
-			XapianDatabase *pFirst, XapianDatabase *pSecond);
+			const std::vector<XapianDatabase *> &shards);
 
 		/// Returns a XapianDatabase pointer; NULL if unavailable.
 		static XapianDatabase *getDatabase(const std::string &location,
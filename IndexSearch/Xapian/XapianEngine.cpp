@@ -16,6 +16,7 @@
  *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -41,6 +42,10 @@
 
 using std::string;
 using std::multimap;
+using std::map;
+using std::list;
+using std::pair;
+using std::max;
 using std::vector;
 using std::clog;
 using std::clog;
@@ -576,6 +581,44 @@ class QueryModifier : public Dijon::CJKVTokenizer::TokensHandler
 
 };
 
+unsigned int XapianEngine::m_maxCachedQueries = 100;
+pthread_mutex_t XapianEngine::m_cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+list<pair<string, XapianEngine::CachedResults> > XapianEngine::m_cachedResults;
+map<string, list<pair<string, XapianEngine::CachedResults> >::iterator> XapianEngine::m_cachedResultsIndex;
+
+XapianEngine::CachedResults::CachedResults() :
+	m_isComplete(false),
+	m_resultsCountEstimate(0)
+{
+}
+
+XapianEngine::CachedResults::CachedResults(const CachedResults &other) :
+	m_query(other.m_query),
+	m_matches(other.m_matches),
+	m_isComplete(other.m_isComplete),
+	m_resultsCountEstimate(other.m_resultsCountEstimate),
+	m_correctedFreeQuery(other.m_correctedFreeQuery)
+{
+}
+
+XapianEngine::CachedResults::~CachedResults()
+{
+}
+
+XapianEngine::CachedResults &XapianEngine::CachedResults::operator=(const CachedResults &other)
+{
+	if (this != &other)
+	{
+		m_query = other.m_query;
+		m_matches = other.m_matches;
+		m_isComplete = other.m_isComplete;
+		m_resultsCountEstimate = other.m_resultsCountEstimate;
+		m_correctedFreeQuery = other.m_correctedFreeQuery;
+	}
+
+	return *this;
+}
+
 XapianEngine::XapianEngine(const string &database) :
 	SearchEngineInterface()
 {
@@ -849,7 +892,8 @@ Xapian::Query XapianEngine::parseQuery(Xapian::Database *pIndex, const QueryProp
 }
 
 bool XapianEngine::queryDatabase(Xapian::Database *pIndex, Xapian::Query &query,
-	const string &stemLanguage, unsigned int startDoc, const QueryProperties &queryProps)
+	const string &stemLanguage, unsigned int startDoc, const QueryProperties &queryProps,
+	CachedResults &results)
 {
 	Timer timer;
 	unsigned int maxResultsCount = queryProps.getMaximumResultsCount();
@@ -866,8 +910,8 @@ bool XapianEngine::queryDatabase(Xapian::Database *pIndex, Xapian::Query &query,
 	timer.start();
 	try
 	{
-		AbstractGenerator abstractGen(pIndex, 50);
-		vector<string> seedTerms;
+		// Match enough to serve the next page too, and more as paging goes on
+		unsigned int matchesCount = max(startDoc + (2 * maxResultsCount), 2 * startDoc);
 
 		// Give the query object to the enquire session
 		enquire.set_query(query);
@@ -923,102 +967,27 @@ bool XapianEngine::queryDatabase(Xapian::Database *pIndex, Xapian::Query &query,
 		}
 
 		// Get the top results of the query
-		Xapian::MSet matches = enquire.get_mset(startDoc, maxResultsCount, (2 * maxResultsCount) + 1);
-		m_resultsCountEstimate = matches.get_matches_estimated();
-		if (matches.empty() == false)
-		{
+		Xapian::MSet matches = enquire.get_mset(0, matchesCount, matchesCount + 1);
 #ifdef DEBUG
-			clog << "XapianEngine::queryDatabase: found " << matches.size() << "/" << maxResultsCount
-				<< " results found from position " << startDoc << endl;
-			clog << "XapianEngine::queryDatabase: estimated " << matches.get_matches_lower_bound()
-				<< "/" << m_resultsCountEstimate << "/" << matches.get_matches_upper_bound()
-				<< ", " << matches.get_description() << endl;
+		clog << "XapianEngine::queryDatabase: found " << matches.size() << "/" << matchesCount
+			<< " results" << endl;
+		clog << "XapianEngine::queryDatabase: estimated " << matches.get_matches_lower_bound()
+			<< "/" << matches.get_matches_estimated() << "/" << matches.get_matches_upper_bound()
+			<< ", " << matches.get_description() << endl;
 #endif
 
-			// Get the results
-			for (Xapian::MSetIterator mIter = matches.begin(); mIter != matches.end(); ++mIter)
-			{
-				Xapian::docid docId = *mIter;
-				Xapian::Document doc(mIter.get_document());
-
-				// What terms did this document match ?
-				seedTerms.clear();
-				for (Xapian::TermIterator termIter = enquire.get_matching_terms_begin(docId);
-					termIter != enquire.get_matching_terms_end(docId); ++termIter)
-				{
-					char firstChar = (*termIter)[0];
-
-					if (isupper(((int)firstChar)) == 0)
-					{
-						seedTerms.push_back(*termIter);
-#ifdef DEBUG
-						clog << "XapianEngine::queryDatabase: matched term " << *termIter << endl;
-#endif
-					}
-					else if (firstChar == 'Z')
-					{
-						string stemmed((*termIter).substr(1));
-						string::size_type stemmedLen = stemmed.length();
-
-						// Which of this document's terms stem to this ?
-						Xapian::TermIterator docTermIter = pIndex->termlist_begin(docId);
-						if (docTermIter != pIndex->termlist_end(docId))
-						{
-							for (docTermIter.skip_to(stemmed);
-								docTermIter != pIndex->termlist_end(docId); ++docTermIter)
-							{
-								// Is this a potential unstem ?
-								if (strncasecmp((*docTermIter).c_str(), stemmed.c_str(), stemmedLen) != 0)
-								{
-									// No, no point looking at the next terms
-									break;
-								}
-#ifdef DEBUG
-								clog << "XapianEngine::queryDatabase: matched unstem " << *docTermIter << endl;
-#endif
-
-								// FIXME: check this term stems to stemmed !
-								seedTerms.push_back(*docTermIter); 
-							}
-						}
-					}
-				}
-
-				if (docId <= 0)
-				{
-#ifdef DEBUG
-					clog << "XapianEngine::queryDatabase: bogus document ID " << docId << endl;
-#endif
-					continue;
-				}
-
-				DocumentInfo thisResult;
-				thisResult.setExtract(abstractGen.generateAbstract(docId, seedTerms));
-				thisResult.setScore((float)mIter.get_percent());
-
-#ifdef DEBUG
-				clog << "XapianEngine::queryDatabase: found document ID " << docId << endl;
-#endif
-				XapianDatabase::recordToProps(doc.get_data(), &thisResult);
-				// XapianDatabase stored the language in English
-				thisResult.setLanguage(Languages::toLocale(thisResult.getLanguage()));
-
-				string url(thisResult.getLocation());
-				if (url.empty() == true)
-				{
-					// Hmmm this shouldn't be empty...
-					// Use this instead, even though the document isn't cached in the index
-					thisResult.setLocation(XapianDatabase::buildUrl(m_databaseName, docId));
-				}
-
-				// We don't know the index ID, just the document ID
-				thisResult.setIsIndexed(0, docId);
-
-				// Add this result
-				m_resultsList.push_back(thisResult);
-			}
+		results.m_query = query;
+		results.m_matches.clear();
+		results.m_isComplete = (matches.size() < matchesCount);
+		results.m_resultsCountEstimate = matches.get_matches_estimated();
+		for (Xapian::MSetIterator mIter = matches.begin(); mIter != matches.end(); ++mIter)
+		{
+			results.m_matches.push_back(pair<Xapian::docid, int>(*mIter, mIter.get_percent()));
 		}
 
+		m_resultsCountEstimate = results.m_resultsCountEstimate;
+		getResults(pIndex, results, startDoc, maxResultsCount);
+
 		completedQuery = true;
 	}
 	catch (const Xapian::Error &error)
@@ -1092,6 +1061,190 @@ bool XapianEngine::queryDatabase(Xapian::Database *pIndex, Xapian::Query &query,
 	return false;
 }
 
+void XapianEngine::getResults(Xapian::Database *pIndex, const CachedResults &results,
+	unsigned int startDoc, unsigned int maxResultsCount)
+{
+	AbstractGenerator abstractGen(pIndex, 50, m_databaseName);
+	Xapian::Enquire enquire(*pIndex);
+	vector<string> seedTerms;
+
+	// Matching terms only depend on the query
+	enquire.set_query(results.m_query);
+
+	for (unsigned int matchNum = startDoc;
+		(matchNum < results.m_matches.size()) && (matchNum < startDoc + maxResultsCount); ++matchNum)
+	{
+		Xapian::docid docId = results.m_matches[matchNum].first;
+
+		if (docId <= 0)
+		{
+#ifdef DEBUG
+			clog << "XapianEngine::getResults: bogus document ID " << docId << endl;
+#endif
+			continue;
+		}
+
+		Xapian::Document doc(pIndex->get_document(docId));
+
+		DocumentInfo thisResult;
+
+		if (m_withExtracts == true)
+		{
+			// What terms did this document match ?
+			seedTerms.clear();
+			for (Xapian::TermIterator termIter = enquire.get_matching_terms_begin(docId);
+				termIter != enquire.get_matching_terms_end(docId); ++termIter)
+			{
+				char firstChar = (*termIter)[0];
+
+				if (isupper(((int)firstChar)) == 0)
+				{
+					seedTerms.push_back(*termIter);
+#ifdef DEBUG
+					clog << "XapianEngine::getResults: matched term " << *termIter << endl;
+#endif
+				}
+				else if (firstChar == 'Z')
+				{
+					string stemmed((*termIter).substr(1));
+					string::size_type stemmedLen = stemmed.length();
+
+					// Which of this document's terms stem to this ?
+					Xapian::TermIterator docTermIter = pIndex->termlist_begin(docId);
+					if (docTermIter != pIndex->termlist_end(docId))
+					{
+						for (docTermIter.skip_to(stemmed);
+							docTermIter != pIndex->termlist_end(docId); ++docTermIter)
+						{
+							// Is this a potential unstem ?
+							if (strncasecmp((*docTermIter).c_str(), stemmed.c_str(), stemmedLen) != 0)
+							{
+								// No, no point looking at the next terms
+								break;
+							}
+#ifdef DEBUG
+							clog << "XapianEngine::getResults: matched unstem " << *docTermIter << endl;
+#endif
+
+							// FIXME: check this term stems to stemmed !
+							seedTerms.push_back(*docTermIter); 
+						}
+					}
+				}
+			}
+
+			thisResult.setExtract(abstractGen.generateAbstract(docId, seedTerms));
+		}
+		thisResult.setScore((float)results.m_matches[matchNum].second);
+
+#ifdef DEBUG
+		clog << "XapianEngine::getResults: found document ID " << docId << endl;
+#endif
+		XapianDatabase::recordToProps(doc.get_data(), &thisResult);
+		// XapianDatabase stored the language in English
+		thisResult.setLanguage(Languages::toLocale(thisResult.getLanguage()));
+
+		string url(thisResult.getLocation());
+		if (url.empty() == true)
+		{
+			// Hmmm this shouldn't be empty...
+			// Use this instead, even though the document isn't cached in the index
+			thisResult.setLocation(XapianDatabase::buildUrl(m_databaseName, docId));
+		}
+
+		// We don't know the index ID, just the document ID
+		thisResult.setIsIndexed(0, docId);
+
+		// Add this result
+		m_resultsList.push_back(thisResult);
+	}
+}
+
+string XapianEngine::getCacheKey(XapianDatabase *pDatabase, Xapian::Database *pIndex,
+	const QueryProperties &queryProps)
+{
+	char numStr[256];
+
+	// Expand terms aren't cached
+	if ((pDatabase == NULL) ||
+		(pIndex == NULL) ||
+		(m_expandDocuments.empty() == false))
+	{
+		return "";
+	}
+
+	// Changes made by this process bump the revision, others alter the index's statistics
+	Xapian::doccount docCount = pIndex->get_doccount();
+	snprintf(numStr, 256, " %u %u %u %.0f %d %d %d %d ",
+		pDatabase->getRevision(), docCount, pIndex->get_lastdocid(),
+		pIndex->get_avlength() * docCount,
+		(int)queryProps.getType(), (int)queryProps.getSortOrder(),
+		(queryProps.getDiacriticSensitive() == true ? 1 : 0), (int)m_defaultOperator);
+
+	string cacheKey(m_databaseName);
+	cacheKey += numStr;
+	cacheKey += queryProps.getStemmingLanguage();
+	cacheKey += "\n";
+	cacheKey += queryProps.getFreeQuery();
+	for (set<string>::const_iterator docIter = m_limitDocuments.begin();
+		docIter != m_limitDocuments.end(); ++docIter)
+	{
+		cacheKey += "\n";
+		cacheKey += *docIter;
+	}
+
+	return cacheKey;
+}
+
+bool XapianEngine::getCachedResults(const string &cacheKey, CachedResults &results)
+{
+	bool foundResults = false;
+
+	if (pthread_mutex_lock(&m_cacheMutex) == 0)
+	{
+		map<string, list<pair<string, CachedResults> >::iterator>::iterator indexIter = m_cachedResultsIndex.find(cacheKey);
+		if (indexIter != m_cachedResultsIndex.end())
+		{
+			// Most recently used first
+			m_cachedResults.splice(m_cachedResults.begin(), m_cachedResults, indexIter->second);
+			results = indexIter->second->second;
+			foundResults = true;
+		}
+
+		pthread_mutex_unlock(&m_cacheMutex);
+	}
+
+	return foundResults;
+}
+
+void XapianEngine::setCachedResults(const string &cacheKey, const CachedResults &results)
+{
+	if (pthread_mutex_lock(&m_cacheMutex) == 0)
+	{
+		map<string, list<pair<string, CachedResults> >::iterator>::iterator indexIter = m_cachedResultsIndex.find(cacheKey);
+		if (indexIter != m_cachedResultsIndex.end())
+		{
+			// These go further
+			m_cachedResults.splice(m_cachedResults.begin(), m_cachedResults, indexIter->second);
+			indexIter->second->second = results;
+		}
+		else
+		{
+			m_cachedResults.push_front(pair<string, CachedResults>(cacheKey, results));
+			m_cachedResultsIndex[cacheKey] = m_cachedResults.begin();
+
+			// Drop the least recently used
+			while (m_cachedResults.size() > m_maxCachedQueries)
+			{
+				m_cachedResultsIndex.erase(m_cachedResults.back().first);
+				m_cachedResults.pop_back();
+			}
+		}
+
+		pthread_mutex_unlock(&m_cacheMutex);
+	}
+}
+
 /// Frees all objects.
 void XapianEngine::freeAll(void)
 {
@@ -1179,8 +1332,29 @@ bool XapianEngine::runQuery(QueryProperties& queryProps,
 	Xapian::Database *pIndex = pDatabase->readLock();
 	try
 	{
+		CachedResults results;
+		string cacheKey(getCacheKey(pDatabase, pIndex, queryProps));
+		unsigned int maxResultsCount = queryProps.getMaximumResultsCount();
 		unsigned int searchStep = 1;
 
+		// Were these results cached, and do they go far enough ?
+		if ((cacheKey.empty() == false) &&
+			(getCachedResults(cacheKey, results) == true) &&
+			((results.m_isComplete == true) ||
+			(results.m_matches.size() >= startDoc + maxResultsCount)))
+		{
+#ifdef DEBUG
+			clog << "XapianEngine::runQuery: " << results.m_matches.size() << " cached results" << endl;
+#endif
+			m_resultsCountEstimate = results.m_resultsCountEstimate;
+			m_correctedFreeQuery = results.m_correctedFreeQuery;
+			m_expandTerms.clear();
+			getResults(pIndex, results, startDoc, maxResultsCount);
+
+			pDatabase->unlock();
+			return true;
+		}
+
 		// Searches are run in this order :
 		// 1. no stemming, exact matches only
 		// 2. stem terms if a language is defined for the query
@@ -1189,7 +1363,7 @@ bool XapianEngine::runQuery(QueryProperties& queryProps,
 		while (fullQuery.empty() == false)
 		{
 			// Query the database
-			if (queryDatabase(pIndex, fullQuery, stemLanguage, startDoc, queryProps) == false)
+			if (queryDatabase(pIndex, fullQuery, stemLanguage, startDoc, queryProps, results) == false)
 			{
 				break;
 			}
@@ -1215,6 +1389,15 @@ bool XapianEngine::runQuery(QueryProperties& queryProps,
 				m_correctedFreeQuery.clear();
 			}
 
+			// Don't cache a match that failed
+			if ((cacheKey.empty() == false) &&
+				((results.m_isComplete == true) ||
+				(results.m_matches.empty() == false)))
+			{
+				results.m_correctedFreeQuery = m_correctedFreeQuery;
+				setCachedResults(cacheKey, results);
+			}
+
 			pDatabase->unlock();
 			return true;
 		}
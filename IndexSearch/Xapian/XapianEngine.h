@@ -19,14 +19,19 @@
 #ifndef _XAPIAN_ENGINE_H
 #define _XAPIAN_ENGINE_H
 
+#include <pthread.h>
 #include <string>
 #include <set>
 #include <vector>
+#include <map>
+#include <list>
+#include <utility>
 
 #include <xapian.h>
 
 #include "config.h"
 #include "SearchEngineInterface.h"
+#include "XapianDatabase.h"
 
 #if !ENABLE_XAPIAN_SPELLING_CORRECTION
 // Spelling correction in Xapian 1.0.2 may cause a crash
@@ -59,6 +64,28 @@ class XapianEngine : public SearchEngineInterface
 			unsigned int startDoc = 0);
 
 	protected:
+		/// Matches of a query, from the first one onwards.
+		class CachedResults
+		{
+			public:
+				CachedResults();
+				CachedResults(const CachedResults &other);
+				~CachedResults();
+
+				CachedResults &operator=(const CachedResults &other);
+
+				Xapian::Query m_query;
+				std::vector<std::pair<Xapian::docid, int> > m_matches;
+				bool m_isComplete;
+				unsigned int m_resultsCountEstimate;
+				std::string m_correctedFreeQuery;
+
+		};
+
+		static unsigned int m_maxCachedQueries;
+		static pthread_mutex_t m_cacheMutex;
+		static std::list<std::pair<std::string, CachedResults> > m_cachedResults;
+		static std::map<std::string, std::list<std::pair<std::string, CachedResults> >::iterator> m_cachedResultsIndex;
 		std::string m_databaseName;
 		std::set<std::string> m_limitDocuments;
 		std::set<std::string> m_expandDocuments;
@@ -66,8 +93,18 @@ class XapianEngine : public SearchEngineInterface
 
 		bool queryDatabase(Xapian::Database *pIndex, Xapian::Query &query,
 			const string &stemLanguage, unsigned int startDoc,
+			const QueryProperties &queryProps, CachedResults &results);
+
+		void getResults(Xapian::Database *pIndex, const CachedResults &results,
+			unsigned int startDoc, unsigned int maxResultsCount);
+
+		std::string getCacheKey(XapianDatabase *pDatabase, Xapian::Database *pIndex,
 			const QueryProperties &queryProps);
 
+		static bool getCachedResults(const std::string &cacheKey, CachedResults &results);
+
+		static void setCachedResults(const std::string &cacheKey, const CachedResults &results);
+
 		Xapian::Query parseQuery(Xapian::Database *pIndex, const QueryProperties &queryProps,
 			const string &stemLanguage, DefaultOperator defaultOperator,
 			string &correctedFreeQuery, bool minimal = false);
@@ -39,6 +39,7 @@
 #include "Url.h"
 #include "FieldMapperInterface.h"
 #include "LanguageDetector.h"
+#include "AbstractGenerator.h"
 #include "XapianDatabaseFactory.h"
 #include "XapianIndex.h"
 
@@ -76,13 +77,13 @@ class TokensIndexer : public Dijon::CJKVTokenizer::TokensHandler
 {
 	public:
 		TokensIndexer(Xapian::Stem *pStemmer, Xapian::Document &doc,
-			const Xapian::WritableDatabase &db,
+			map<string, Xapian::termcount> &spellingTerms,
 			const string &prefix, unsigned int nGramSize,
 			bool &doSpelling, Xapian::termcount &termPos) :
 			Dijon::CJKVTokenizer::TokensHandler(),
 			m_pStemmer(pStemmer),
 			m_doc(doc),
-			m_db(db),
+			m_spellingTerms(spellingTerms),
 			m_prefix(prefix),
 			m_nGramSize(nGramSize),
 			m_nGramCount(0),
@@ -244,16 +245,8 @@ class TokensIndexer : public Dijon::CJKVTokenizer::TokensHandler
 
 			if (addSpelling == true)
 			{
-				try
-				{
-					m_db.add_spelling(XapianDatabase::limitTermLength(term));
-				}
-				catch (const Xapian::UnimplementedError &error)
-				{
-					clog << "Couldn't index with spelling correction: " << error.get_type() << ": " << error.get_msg() << endl;
-
-					m_doSpelling = false;
-				}
+				// The spelling dictionary is updated when the document is committed
+				++m_spellingTerms[XapianDatabase::limitTermLength(term)];
 			}
 
 			return true;
@@ -262,7 +255,7 @@ class TokensIndexer : public Dijon::CJKVTokenizer::TokensHandler
 	protected:
 		Xapian::Stem *m_pStemmer;
 		Xapian::Document &m_doc;
-		const Xapian::WritableDatabase &m_db;
+		map<string, Xapian::termcount> &m_spellingTerms;
 		string m_prefix;
 		unsigned int m_nGramSize;
 		unsigned int m_nGramCount;
@@ -272,6 +265,9 @@ class TokensIndexer : public Dijon::CJKVTokenizer::TokensHandler
 
 };
 
+pthread_key_t XapianIndex::m_stemmersKey;
+pthread_once_t XapianIndex::m_stemmersKeyOnce = PTHREAD_ONCE_INIT;
+
 XapianIndex::XapianIndex(const string &indexName) :
 	IndexInterface(),
 	m_databaseName(indexName),
@@ -315,6 +311,93 @@ XapianIndex &XapianIndex::operator=(const XapianIndex &other)
 	return *this;
 }
 
+void XapianIndex::createStemmersKey(void)
+{
+	pthread_key_create(&m_stemmersKey, XapianIndex::deleteStemmers);
+}
+
+void XapianIndex::deleteStemmers(void *pStemmers)
+{
+	map<string, Xapian::Stem *> *pStemmersMap = (map<string, Xapian::Stem *> *)pStemmers;
+
+	if (pStemmersMap == NULL)
+	{
+		return;
+	}
+
+	for (map<string, Xapian::Stem *>::iterator stemIter = pStemmersMap->begin();
+		stemIter != pStemmersMap->end(); ++stemIter)
+	{
+		if (stemIter->second != NULL)
+		{
+			delete stemIter->second;
+		}
+	}
+	delete pStemmersMap;
+}
+
+/// Returns the calling thread's stemmer for the language, NULL if not supported.
+Xapian::Stem *XapianIndex::getStemmer(const string &language)
+{
+	if (language.empty() == true)
+	{
+		return NULL;
+	}
+
+	pthread_once(&m_stemmersKeyOnce, XapianIndex::createStemmersKey);
+
+	// Stemmers are kept for the lifetime of the thread, one per language
+	map<string, Xapian::Stem *> *pStemmersMap = (map<string, Xapian::Stem *> *)pthread_getspecific(m_stemmersKey);
+	if (pStemmersMap == NULL)
+	{
+		pStemmersMap = new map<string, Xapian::Stem *>();
+		if (pthread_setspecific(m_stemmersKey, (void *)pStemmersMap) != 0)
+		{
+			delete pStemmersMap;
+			return NULL;
+		}
+	}
+
+	map<string, Xapian::Stem *>::const_iterator stemIter = pStemmersMap->find(language);
+	if (stemIter != pStemmersMap->end())
+	{
+		return stemIter->second;
+	}
+
+	Xapian::Stem *pStemmer = NULL;
+	try
+	{
+		pStemmer = new Xapian::Stem(StringManip::toLowerCase(language));
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Invalid language: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+
+	// Unsupported languages are remembered too
+	(*pStemmersMap)[language] = pStemmer;
+
+	return pStemmer;
+}
+
+string XapianIndex::getNameTerm(const string &name, NameType type)
+{
+	if (type == BY_LABEL)
+	{
+		return string("XLABEL:") + XapianDatabase::limitTermLength(Url::escapeUrl(name));
+	}
+	else if (type == BY_DIRECTORY)
+	{
+		return string("XDIR:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
+	}
+	else if (type == BY_FILE)
+	{
+		return string("XFILE:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
+	}
+
+	return "";
+}
+
 bool XapianIndex::listDocumentsWithTerm(const string &term, set<unsigned int> &docIds,
 	unsigned int maxDocsCount, unsigned int startDoc) const
 {
@@ -344,7 +427,7 @@ bool XapianIndex::listDocumentsWithTerm(const string &term, set<unsigned int> &d
 			{
 				Xapian::docid docId = *postingIter;
 
-				// We cannot use postingIter->skip_to() because startDoc isn't an ID
+				// We cannot use postingIter->skip_to() because startDoc isn't an ID, see listDocumentsWithTermAfter()
 				if (docCount >= startDoc)
 				{
 					docIds.insert(docId);
@@ -366,9 +449,59 @@ bool XapianIndex::listDocumentsWithTerm(const string &term, set<unsigned int> &d
 	return docIds.size();
 }
 
+bool XapianIndex::listDocumentsWithTermAfter(const string &term, set<unsigned int> &docIds,
+	unsigned int &lastDocId, unsigned int maxDocsCount) const
+{
+	XapianDatabase *pDatabase = XapianDatabaseFactory::getDatabase(m_databaseName);
+	if (pDatabase == NULL)
+	{
+		clog << "Couldn't get index " << m_databaseName << endl;
+		return false;
+	}
+
+	docIds.clear();
+	try
+	{
+		Xapian::Database *pIndex = pDatabase->readLock();
+		if (pIndex != NULL)
+		{
+#ifdef DEBUG
+			clog << "XapianIndex::listDocumentsWithTermAfter: term " << term << " after " << lastDocId << endl;
+#endif
+			Xapian::PostingIterator postingIter = pIndex->postlist_begin(term);
+
+			// Resume right after the last document listed
+			if (lastDocId > 0)
+			{
+				postingIter.skip_to(lastDocId + 1);
+			}
+			for (; (postingIter != pIndex->postlist_end(term)) &&
+					((maxDocsCount == 0) || (docIds.size() < maxDocsCount));
+				++postingIter)
+			{
+				Xapian::docid docId = *postingIter;
+
+				docIds.insert(docId);
+				lastDocId = docId;
+			}
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't get document list: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+	catch (...)
+	{
+		clog << "Couldn't get document list, unknown exception occured" << endl;
+	}
+	pDatabase->unlock();
+
+	return docIds.size();
+}
+
 void XapianIndex::addPostingsToDocument(const Xapian::Utf8Iterator &itor, Xapian::Document &doc,
-	const Xapian::WritableDatabase &db, const string &prefix, bool noStemming, bool &doSpelling,
-	Xapian::termcount &termPos) const
+	map<string, Xapian::termcount> &spellingTerms, const string &prefix, bool noStemming,
+	bool &doSpelling, Xapian::termcount &termPos) const
 {
 	Xapian::Stem *pStemmer = NULL;
 	bool isCJKV = false;
@@ -377,28 +510,21 @@ void XapianIndex::addPostingsToDocument(const Xapian::Utf8Iterator &itor, Xapian
 	if ((noStemming == false) &&
 		(m_stemLanguage.empty() == false))
 	{
-		try
-		{
-			pStemmer = new Xapian::Stem(StringManip::toLowerCase(m_stemLanguage));
-		}
-		catch (const Xapian::Error &error)
-		{
-			clog << "Couldn't create stemmer: " << error.get_type() << ": " << error.get_msg() << endl;
-		}
+		pStemmer = getStemmer(m_stemLanguage);
 	}
 
 	const char *pRawData = itor.raw();
 	if (pRawData != NULL)
 	{
 		Dijon::CJKVTokenizer tokenizer;
-		string text(pRawData);
+		unsigned int textLength = (unsigned int)itor.left();
 
 #ifdef _DIACRITICS_SENSITIVE
-		if (tokenizer.has_cjkv(text) == true)
+		if (tokenizer.has_cjkv(pRawData, textLength) == true)
 		{
 #endif
-			// Use overload
-			addPostingsToDocument(tokenizer, pStemmer, text, doc, db,
+			// Use overload, tokenizing in place
+			addPostingsToDocument(tokenizer, pStemmer, pRawData, textLength, doc, spellingTerms,
 				prefix, doSpelling, termPos);
 			isCJKV = true;
 #ifdef _DIACRITICS_SENSITIVE
@@ -418,52 +544,61 @@ void XapianIndex::addPostingsToDocument(const Xapian::Utf8Iterator &itor, Xapian
 		}
 
 		generator.set_termpos(termPos);
-		try
+		// The generator only feeds the spelling dictionary with unprefixed terms
+		if ((doSpelling == false) ||
+			(prefix.empty() == false))
 		{
-			// Older Xapian backends don't support spelling correction
-			if (doSpelling == true)
-			{
-				// The database is required for the spelling dictionary
-				generator.set_flags(Xapian::TermGenerator::FLAG_SPELLING);
-				generator.set_database(db);
-			}
 			generator.set_document(doc);
 			generator.index_text(itor, 1, prefix);
+			termPos = generator.get_termpos();
+			return;
 		}
-		catch (const Xapian::UnimplementedError &error)
+
+		Xapian::Document termsDoc;
+
+		// Tokenize once, then copy the terms over and pick the words for the spelling dictionary
+		generator.set_document(termsDoc);
+		generator.index_text(itor, 1, prefix);
+		termPos = generator.get_termpos();
+		for (Xapian::TermIterator termIter = termsDoc.termlist_begin();
+			termIter != termsDoc.termlist_end(); ++termIter)
 		{
-			clog << "Couldn't index with spelling correction: " << error.get_type() << ": " << error.get_msg() << endl;
+			string term(*termIter);
 
-			if (doSpelling == true)
+			// Stemmed terms have no positions
+			if (termIter.positionlist_count() == 0)
 			{
-				doSpelling = false;
+				doc.add_term(term, termIter.get_wdf());
+			}
+			else
+			{
+				for (Xapian::PositionIterator posIter = termIter.positionlist_begin();
+					posIter != termIter.positionlist_end(); ++posIter)
+				{
+					doc.add_posting(term, *posIter);
+				}
+			}
 
-				// Try again without spelling correction
-				// Let the caller catch the exception
-				generator.set_flags(Xapian::TermGenerator::FLAG_SPELLING, Xapian::TermGenerator::FLAG_SPELLING);
-				generator.set_document(doc);
-				generator.index_text(itor, 1, prefix);
+			// Stemmed terms are prefixed with Z, other terms are words
+			if (term[0] != 'Z')
+			{
+				spellingTerms[term] += termIter.get_wdf();
 			}
 		}
-		termPos = generator.get_termpos();
 	}
 #endif
-
-	if (pStemmer != NULL)
-	{
-		delete pStemmer;
-	}
 }
 
 void XapianIndex::addPostingsToDocument(Dijon::CJKVTokenizer &tokenizer, Xapian::Stem *pStemmer,
-	const string &text, Xapian::Document &doc, const Xapian::WritableDatabase &db,
-	const string &prefix, bool &doSpelling, Xapian::termcount &termPos) const
+	const char *pText, unsigned int textLength, Xapian::Document &doc,
+	map<string, Xapian::termcount> &spellingTerms, const string &prefix,
+	bool &doSpelling, Xapian::termcount &termPos) const
 {
-	TokensIndexer handler(pStemmer, doc, db, prefix, tokenizer.get_ngram_size(),
+	TokensIndexer handler(pStemmer, doc, spellingTerms, prefix, tokenizer.get_ngram_size(),
 		doSpelling, termPos);
 
 	// Get the terms
-	tokenizer.tokenize(text, handler, true);
+	tokenizer.tokenize(pText, textLength, handler, true);
 #ifdef DEBUG
 	clog << "XapianIndex::addPostingsToDocument: terms to position " << termPos << endl;
 #endif
@@ -501,11 +636,12 @@ void XapianIndex::removePostingsFromDocument(const Xapian::Utf8Iterator &itor, X
 	bool noStemming, bool &doSpelling) const
 {
 	Xapian::Document termsDoc;
+	map<string, Xapian::termcount> noSpellingTerms;
 	Xapian::termcount termPos = 0;
 	bool addDoSpelling = false;
 
 	// Get the terms, without populating the spelling database
-	addPostingsToDocument(itor, termsDoc, db, prefix, noStemming, addDoSpelling, termPos);
+	addPostingsToDocument(itor, termsDoc, noSpellingTerms, prefix, noStemming, addDoSpelling, termPos);
 
 	// Get the terms and remove the first posting for each
 	for (Xapian::TermIterator termListIter = termsDoc.termlist_begin();
@@ -618,7 +754,7 @@ void XapianIndex::removePostingsFromDocument(const Xapian::Utf8Iterator &itor, X
 }
 
 void XapianIndex::addCommonTerms(const DocumentInfo &docInfo, Xapian::Document &doc,
-	const Xapian::WritableDatabase &db, Xapian::termcount &termPos)
+	map<string, Xapian::termcount> &spellingTerms, Xapian::termcount &termPos)
 {
 	string title(docInfo.getTitle());
 	string location(docInfo.getLocation());
@@ -631,7 +767,7 @@ void XapianIndex::addCommonTerms(const DocumentInfo &docInfo, Xapian::Document &
 	// Index the title with prefix S
 	if (title.empty() == false)
 	{
-		addPostingsToDocument(Xapian::Utf8Iterator(title), doc, db, "S",
+		addPostingsToDocument(Xapian::Utf8Iterator(title), doc, spellingTerms, "S",
 			false, m_doSpelling, termPos);
 	}
 
@@ -701,7 +837,7 @@ void XapianIndex::addCommonTerms(const DocumentInfo &docInfo, Xapian::Document &
 
 		// ...and all components as XPATH:
 		bool doSpellingOnPaths = false;
-		addPostingsToDocument(Xapian::Utf8Iterator(tree), doc, db, "XPATH:",
+		addPostingsToDocument(Xapian::Utf8Iterator(tree), doc, spellingTerms, "XPATH:",
 			true, doSpellingOnPaths, termPos);
 	}
 	else
@@ -719,7 +855,7 @@ void XapianIndex::addCommonTerms(const DocumentInfo &docInfo, Xapian::Document &
 			bool doSpellingOnPaths = false;
 
 			// Add more XPATH: terms if there's a space in the file name
-			addPostingsToDocument(Xapian::Utf8Iterator(fileName), doc, db, "XPATH:",
+			addPostingsToDocument(Xapian::Utf8Iterator(fileName), doc, spellingTerms, "XPATH:",
 				true, doSpellingOnPaths, termPos);
 		}
 
@@ -909,6 +1045,30 @@ void XapianIndex::removeCommonTerms(Xapian::Document &doc, const Xapian::Writabl
 	}
 }
 
+void XapianIndex::addSpelling(const Xapian::WritableDatabase &db,
+	const map<string, Xapian::termcount> &spellingTerms)
+{
+	if (m_doSpelling == false)
+	{
+		return;
+	}
+
+	try
+	{
+		for (map<string, Xapian::termcount>::const_iterator termIter = spellingTerms.begin();
+			termIter != spellingTerms.end(); ++termIter)
+		{
+			db.add_spelling(termIter->first, termIter->second);
+		}
+	}
+	catch (const Xapian::UnimplementedError &error)
+	{
+		clog << "Couldn't index with spelling correction: " << error.get_type() << ": " << error.get_msg() << endl;
+
+		m_doSpelling = false;
+	}
+}
+
 string XapianIndex::scanDocument(const string &suggestedLanguage,
 	const char *pData, off_t dataLength)
 {
@@ -924,7 +1084,7 @@ string XapianIndex::scanDocument(const string &suggestedLanguage,
 	else
 	{
 		// Try to determine the document's language right away
-		LanguageDetector::getInstance().guessLanguage(pData, max(dataLength, (off_t)2048), candidates);
+		LanguageDetector::getInstance().guessLanguage(pData, min(dataLength, (off_t)2048), candidates);
 
 		scannedDocument = true;
 	}
@@ -939,19 +1099,13 @@ string XapianIndex::scanDocument(const string &suggestedLanguage,
 			continue;
 		}
 
-		try
-		{
-			Xapian::Stem stemmer(StringManip::toLowerCase(*langIter));
-		}
-		catch (const Xapian::Error &error)
+		if (getStemmer(*langIter) == NULL)
 		{
-			clog << "Invalid language: " << error.get_type() << ": " << error.get_msg() << endl;
-
 			if (scannedDocument == false)
 			{
 				// The suggested language is not suitable
 				candidates.clear();
-				LanguageDetector::getInstance().guessLanguage(pData, max(dataLength, (off_t)2048), candidates);
+				LanguageDetector::getInstance().guessLanguage(pData, min(dataLength, (off_t)2048), candidates);
 
 				langIter = candidates.begin();
 				scannedDocument = true;
@@ -976,7 +1130,7 @@ string XapianIndex::scanDocument(const string &suggestedLanguage,
 void XapianIndex::setDocumentData(const DocumentInfo &docInfo, Xapian::Document &doc,
 	const string &language) const
 {
-	time_t timeT = TimeConverter::fromTimestamp(docInfo.getTimestamp());
+	time_t timeT = docInfo.getTime();
 	struct tm *tm = localtime(&timeT);
 	string yyyymmdd(TimeConverter::toYYYYMMDDString(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday));
 	string hhmmss(TimeConverter::toHHMMSSString(tm->tm_hour, tm->tm_min, tm->tm_sec));
@@ -992,6 +1146,7 @@ void XapianIndex::setDocumentData(const DocumentInfo &docInfo, Xapian::Document
 	doc.add_value(4, yyyymmdd + hhmmss);
 	// Number of seconds to January 1st, 10000
 	doc.add_value(5, Xapian::sortable_serialise((double )253402300800 - timeT));
+	// Value 255 is reserved for the words stored by AbstractGenerator
 	// Any custom value ?
 	if (g_pMapper != NULL)
 	{
@@ -1200,6 +1355,78 @@ bool XapianIndex::getDocumentInfo(unsigned int docId, DocumentInfo &docInfo) con
 	return foundDocument;
 }
 
+/// Returns the properties of the given documents; returns the number found.
+unsigned int XapianIndex::getDocumentsInfo(const set<unsigned int> &docIds,
+	map<unsigned int, DocumentInfo> &docsInfo) const
+{
+	unsigned int foundCount = 0;
+
+	if (docIds.empty() == true)
+	{
+		return 0;
+	}
+
+	XapianDatabase *pDatabase = XapianDatabaseFactory::getDatabase(m_databaseName);
+	if (pDatabase == NULL)
+	{
+		clog << "Couldn't get index " << m_databaseName << endl;
+		return 0;
+	}
+
+	try
+	{
+		Xapian::Database *pIndex = pDatabase->readLock();
+		if (pIndex != NULL)
+		{
+			// Documents are fetched in ID order
+			for (set<unsigned int>::const_iterator docIter = docIds.begin();
+				docIter != docIds.end(); ++docIter)
+			{
+				if (*docIter == 0)
+				{
+					continue;
+				}
+
+				try
+				{
+					Xapian::Document doc = pIndex->get_document(*docIter);
+					string record(doc.get_data());
+
+					if (record.empty() == false)
+					{
+						DocumentInfo &docInfo = docsInfo[*docIter];
+
+						XapianDatabase::recordToProps(record, &docInfo);
+						// XapianDatabase stored the language in English
+						docInfo.setLanguage(Languages::toLocale(docInfo.getLanguage()));
+						++foundCount;
+					}
+				}
+				catch (const Xapian::DocNotFoundError &error)
+				{
+#ifdef DEBUG
+					clog << "XapianIndex::getDocumentsInfo: no document " << *docIter << endl;
+#endif
+				}
+			}
+#ifdef DEBUG
+			clog << "XapianIndex::getDocumentsInfo: " << foundCount << "/" << docIds.size() << " documents" << endl;
+#endif
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't get documents properties: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+	catch (...)
+	{
+		clog << "Couldn't get documents properties, unknown exception occured" << endl;
+	}
+	pDatabase->unlock();
+
+	return foundCount;
+}
+
 /// Returns a document's terms count.
 unsigned int XapianIndex::getDocumentTermsCount(unsigned int docId) const
 {
@@ -1628,7 +1855,8 @@ unsigned int XapianIndex::hasDocument(const string &url) const
 
 	try
 	{
-		Xapian::Database *pIndex = pDatabase->readLock();
+		// Documents indexed but not yet committed must be found too
+		Xapian::Database *pIndex = pDatabase->readLock(true);
 		if (pIndex != NULL)
 		{
 			string term = string("U") + XapianDatabase::limitTermLength(Url::escapeUrl(Url::canonicalizeUrl(url)), true);
@@ -1660,6 +1888,62 @@ unsigned int XapianIndex::hasDocument(const string &url) const
 	return docId;
 }
 
+/// Checks which of the given URLs are in the index; returns the number found.
+unsigned int XapianIndex::hasDocuments(const set<string> &urls,
+	map<string, unsigned int> &docIds) const
+{
+	unsigned int foundCount = 0;
+
+	if (urls.empty() == true)
+	{
+		return 0;
+	}
+
+	XapianDatabase *pDatabase = XapianDatabaseFactory::getDatabase(m_databaseName);
+	if (pDatabase == NULL)
+	{
+		clog << "Couldn't get index " << m_databaseName << endl;
+		return 0;
+	}
+
+	try
+	{
+		// Documents indexed but not yet committed must be found too
+		Xapian::Database *pIndex = pDatabase->readLock(true);
+		if (pIndex != NULL)
+		{
+			for (set<string>::const_iterator urlIter = urls.begin();
+				urlIter != urls.end(); ++urlIter)
+			{
+				string term = string("U") + XapianDatabase::limitTermLength(Url::escapeUrl(Url::canonicalizeUrl(*urlIter)), true);
+
+				// Get documents that have this term
+				Xapian::PostingIterator postingIter = pIndex->postlist_begin(term);
+				if (postingIter != pIndex->postlist_end(term))
+				{
+					// This URL was indexed
+					docIds[*urlIter] = *postingIter;
+					++foundCount;
+				}
+			}
+#ifdef DEBUG
+			clog << "XapianIndex::hasDocuments: " << foundCount << "/" << urls.size() << " documents" << endl;
+#endif
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't look for documents: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+	catch (...)
+	{
+		clog << "Couldn't look for documents, unknown exception occured" << endl;
+	}
+	pDatabase->unlock();
+
+	return foundCount;
+}
+
 /// Gets terms with the same root.
 unsigned int XapianIndex::getCloseTerms(const string &term, set<string> &suggestions)
 {
@@ -1812,22 +2096,22 @@ unsigned int XapianIndex::listDocuments(set<unsigned int> &docIds,
 bool XapianIndex::listDocuments(const string &name, set<unsigned int> &docIds,
 	NameType type, unsigned int maxDocsCount, unsigned int startDoc) const
 {
-	string term;
+	return listDocumentsWithTerm(getNameTerm(name, type), docIds, maxDocsCount, startDoc);
+}
 
-	if (type == BY_LABEL)
-	{
-		term = string("XLABEL:") + XapianDatabase::limitTermLength(Url::escapeUrl(name));
-	}
-	else if (type == BY_DIRECTORY)
-	{
-		term = string("XDIR:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
-	}
-	else if (type == BY_FILE)
-	{
-		term = string("XFILE:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
-	}
+/// Lists documents that come after lastDocId, which is set to the last document listed.
+unsigned int XapianIndex::listDocumentsAfter(set<unsigned int> &docIds,
+	unsigned int &lastDocId, unsigned int maxDocsCount) const
+{
+	// All documents have the magic term
+	return listDocumentsWithTermAfter("", docIds, lastDocId, maxDocsCount);
+}
 
-	return listDocumentsWithTerm(term, docIds, maxDocsCount, startDoc);
+/// Lists documents that come after lastDocId, which is set to the last document listed.
+bool XapianIndex::listDocumentsAfter(const string &name, set<unsigned int> &docIds,
+	NameType type, unsigned int &lastDocId, unsigned int maxDocsCount) const
+{
+	return listDocumentsWithTermAfter(getNameTerm(name, type), docIds, lastDocId, maxDocsCount);
 }
 
 /// Indexes the given data.
@@ -1861,30 +2145,37 @@ bool XapianIndex::indexDocument(const Document &document, const std::set<std::st
 
 	try
 	{
-		Xapian::WritableDatabase *pIndex = pDatabase->writeLock();
-		if (pIndex != NULL)
-		{
-			Xapian::Document doc;
-			Xapian::termcount termPos = 0;
+		Xapian::Document doc;
+		map<string, Xapian::termcount> spellingTerms;
+		Xapian::termcount termPos = 0;
 
-			// Populate the Xapian document
-			addCommonTerms(docInfo, doc, *pIndex, termPos);
-			if ((pData != NULL) &&
-				(dataLength > 0))
-			{
-				Xapian::Utf8Iterator itor(pData, dataLength);
-				addPostingsToDocument(itor, doc, *pIndex, "",
-					false, m_doSpelling, termPos);
-			}
+		// Populate the Xapian document
+		// This is done before locking so that other threads can index or search meanwhile
+		addCommonTerms(docInfo, doc, spellingTerms, termPos);
+		if ((pData != NULL) &&
+			(dataLength > 0))
+		{
+			Xapian::Utf8Iterator itor(pData, dataLength);
+			addPostingsToDocument(itor, doc, spellingTerms, "",
+				false, m_doSpelling, termPos);
+		}
 #ifdef DEBUG
-			clog << "XapianIndex::indexDocument: " << labels.size() << " labels for URL " << docInfo.getLocation(true) << endl;
+		clog << "XapianIndex::indexDocument: " << labels.size() << " labels for URL " << docInfo.getLocation(true) << endl;
 #endif
 
-			// Add labels
-			addLabelsToDocument(doc, labels, false);
+		// Keep words in order for abstracts
+		AbstractGenerator::storeWords(doc);
 
-			// Set data
-			setDocumentData(docInfo, doc, m_stemLanguage);
+		// Add labels
+		addLabelsToDocument(doc, labels, false);
+
+		// Set data
+		setDocumentData(docInfo, doc, m_stemLanguage);
+
+		Xapian::WritableDatabase *pIndex = pDatabase->writeLock();
+		if (pIndex != NULL)
+		{
+			addSpelling(*pIndex, spellingTerms);
 
 			// Add this document to the Xapian index
 			docId = pIndex->add_document(doc);
@@ -1938,30 +2229,36 @@ bool XapianIndex::updateDocument(unsigned int docId, const Document &document)
 	{
 		set<string> labels;
 
+		Xapian::Document doc;
+		map<string, Xapian::termcount> spellingTerms;
+		Xapian::termcount termPos = 0;
+
 		// Get the document's labels
 		getDocumentLabels(docId, labels);
 
-		pIndex = pDatabase->writeLock();
-		if (pIndex != NULL)
+		// Populate the Xapian document before locking
+		addCommonTerms(docInfo, doc, spellingTerms, termPos);
+		if ((pData != NULL) &&
+			(dataLength > 0))
 		{
-			Xapian::Document doc;
-			Xapian::termcount termPos = 0;
+			Xapian::Utf8Iterator itor(pData, dataLength);
+			addPostingsToDocument(itor, doc, spellingTerms, "",
+				false, m_doSpelling, termPos);
+		}
 
-			// Populate the Xapian document
-			addCommonTerms(docInfo, doc, *pIndex, termPos);
-			if ((pData != NULL) &&
-				(dataLength > 0))
-			{
-				Xapian::Utf8Iterator itor(pData, dataLength);
-				addPostingsToDocument(itor, doc, *pIndex, "",
-					false, m_doSpelling, termPos);
-			}
+		// Keep words in order for abstracts
+		AbstractGenerator::storeWords(doc);
 
-			// Add labels
-			addLabelsToDocument(doc, labels, false);
+		// Add labels
+		addLabelsToDocument(doc, labels, false);
 
-			// Set data
-			setDocumentData(docInfo, doc, m_stemLanguage);
+		// Set data
+		setDocumentData(docInfo, doc, m_stemLanguage);
+
+		pIndex = pDatabase->writeLock();
+		if (pIndex != NULL)
+		{
+			addSpelling(*pIndex, spellingTerms);
 
 			// Update the document in the database
 			pIndex->replace_document(docId, doc);
@@ -2007,12 +2304,14 @@ bool XapianIndex::updateDocumentInfo(unsigned int docId, const DocumentInfo &doc
 		if (pIndex != NULL)
 		{
 			Xapian::Document doc = pIndex->get_document(docId);
+			map<string, Xapian::termcount> spellingTerms;
 			Xapian::termcount termPos = 0;
 
 			// Update the document data with the current language
 			m_stemLanguage = Languages::toEnglish(docInfo.getLanguage());
 			removeCommonTerms(doc, *pIndex);
-			addCommonTerms(docInfo, doc, *pIndex, termPos);
+			addCommonTerms(docInfo, doc, spellingTerms, termPos);
+			addSpelling(*pIndex, spellingTerms);
 			setDocumentData(docInfo, doc, m_stemLanguage);
 
 			pIndex->replace_document(docId, doc);
@@ -2032,6 +2331,162 @@ bool XapianIndex::updateDocumentInfo(unsigned int docId, const DocumentInfo &doc
 	return updated;
 }
 
+/// Moves a directory or file and the documents it holds to a new name.
+bool XapianIndex::moveDocuments(const string &previousName, const string &name,
+	NameType type)
+{
+	Xapian::WritableDatabase *pIndex = NULL;
+	string previousLocation, location, previousTerm, term;
+	bool moved = false, inTransaction = false;
+
+	if ((previousName.empty() == true) ||
+		(name.empty() == true))
+	{
+		return false;
+	}
+
+	// Names are the same as for listDocuments()
+	if (type == BY_DIRECTORY)
+	{
+		previousLocation = string("file://") + previousName;
+		location = string("file://") + name;
+		previousTerm = string("XDIR:") + XapianDatabase::limitTermLength(Url::escapeUrl(previousName), true);
+		term = string("XDIR:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
+	}
+	else if (type == BY_FILE)
+	{
+		previousLocation = previousName;
+		location = name;
+		previousTerm = string("XFILE:") + XapianDatabase::limitTermLength(Url::escapeUrl(previousName), true);
+		term = string("XFILE:") + XapianDatabase::limitTermLength(Url::escapeUrl(name), true);
+	}
+	else
+	{
+		return false;
+	}
+
+	XapianDatabase *pDatabase = XapianDatabaseFactory::getDatabase(m_databaseName, false);
+	if (pDatabase == NULL)
+	{
+		clog << "Couldn't get index " << m_databaseName << endl;
+		return false;
+	}
+
+	string previousUrlTerm(string("U") + XapianDatabase::limitTermLength(Url::escapeUrl(Url::canonicalizeUrl(previousLocation)), true));
+	string urlTerm(string("U") + XapianDatabase::limitTermLength(Url::escapeUrl(Url::canonicalizeUrl(location)), true));
+	Url previousUrlObj(previousLocation), urlObj(location);
+
+	try
+	{
+		pIndex = pDatabase->writeLock();
+		if (pIndex != NULL)
+		{
+			set<Xapian::docid> docIds;
+			Xapian::docid baseDocId = 0;
+
+			// The directory/file itself...
+			Xapian::PostingIterator postingIter = pIndex->postlist_begin(previousUrlTerm);
+			if (postingIter != pIndex->postlist_end(previousUrlTerm))
+			{
+				baseDocId = *postingIter;
+				docIds.insert(baseDocId);
+			}
+			// ...and all the documents it holds
+			for (postingIter = pIndex->postlist_begin(previousTerm);
+				postingIter != pIndex->postlist_end(previousTerm); ++postingIter)
+			{
+				docIds.insert(*postingIter);
+			}
+#ifdef DEBUG
+			clog << "XapianIndex::moveDocuments: " << docIds.size() << " documents in " << previousName << endl;
+#endif
+
+			if (docIds.empty() == false)
+			{
+				// Either all documents are moved or none is
+				pIndex->begin_transaction(false);
+				inTransaction = true;
+
+				// Whatever was at the destination is replaced
+				pIndex->delete_document(urlTerm);
+				pIndex->delete_document(term);
+
+				for (set<Xapian::docid>::const_iterator docIter = docIds.begin();
+					docIter != docIds.end(); ++docIter)
+				{
+					Xapian::Document doc = pIndex->get_document(*docIter);
+					map<string, Xapian::termcount> spellingTerms;
+					DocumentInfo docInfo;
+					string record(doc.get_data());
+					Xapian::termcount termPos = 0;
+
+					if (record.empty() == true)
+					{
+						continue;
+					}
+
+					// The record has the language in English
+					XapianDatabase::recordToProps(record, &docInfo);
+					m_stemLanguage = docInfo.getLanguage();
+
+					string newLocation(docInfo.getLocation());
+					if (newLocation.compare(0, previousLocation.length(), previousLocation) != 0)
+					{
+#ifdef DEBUG
+						clog << "XapianIndex::moveDocuments: skipping " << newLocation << endl;
+#endif
+						continue;
+					}
+					newLocation.replace(0, previousLocation.length(), location);
+
+					// Update the title if it was the directory/file name
+					if ((*docIter == baseDocId) &&
+						(docInfo.getTitle() == previousUrlObj.getFile()))
+					{
+						docInfo.setTitle(urlObj.getFile());
+					}
+
+					// Rewrite the U, XDIR and XPATH terms
+					removeCommonTerms(doc, *pIndex);
+					docInfo.setLocation(newLocation);
+					addCommonTerms(docInfo, doc, spellingTerms, termPos);
+					addSpelling(*pIndex, spellingTerms);
+					setDocumentData(docInfo, doc, m_stemLanguage);
+
+					pIndex->replace_document(*docIter, doc);
+					moved = true;
+				}
+
+				pIndex->commit_transaction();
+				inTransaction = false;
+			}
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't move documents: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+	catch (...)
+	{
+		clog << "Couldn't move documents, unknown exception occured" << endl;
+	}
+	if (inTransaction == true)
+	{
+		// Leave the index as it was
+		try
+		{
+			pIndex->cancel_transaction();
+		}
+		catch (...)
+		{
+		}
+		moved = false;
+	}
+	pDatabase->unlock();
+
+	return moved;
+}
+
 /// Unindexes the given document; true if success.
 bool XapianIndex::unindexDocument(unsigned int docId)
 {
@@ -2108,6 +2563,71 @@ bool XapianIndex::unindexAllDocuments(void)
 	return deleteDocuments(MAGIC_TERM);
 }
 
+/// Rewrites documents' data in the current record format; returns the number rewritten.
+unsigned int XapianIndex::upgradeRecords(void)
+{
+	unsigned int upgradedCount = 0;
+
+	XapianDatabase *pDatabase = XapianDatabaseFactory::getDatabase(m_databaseName, false);
+	if (pDatabase == NULL)
+	{
+		clog << "Couldn't get index " << m_databaseName << endl;
+		return 0;
+	}
+
+	try
+	{
+		Xapian::WritableDatabase *pIndex = pDatabase->writeLock();
+		if (pIndex != NULL)
+		{
+			vector<Xapian::docid> docIds;
+
+			// Documents are replaced after the postlist was read
+			docIds.reserve(pIndex->get_doccount());
+			for (Xapian::PostingIterator postingIter = pIndex->postlist_begin("");
+				postingIter != pIndex->postlist_end(""); ++postingIter)
+			{
+				docIds.push_back(*postingIter);
+			}
+
+			for (vector<Xapian::docid>::const_iterator docIter = docIds.begin();
+				docIter != docIds.end(); ++docIter)
+			{
+				Xapian::Document doc = pIndex->get_document(*docIter);
+				string record(doc.get_data());
+
+				if ((record.empty() == true) ||
+					(XapianDatabase::isBinaryRecord(record) == true))
+				{
+					continue;
+				}
+
+				DocumentInfo docInfo;
+
+				// Only the data changes, terms and values are left alone
+				XapianDatabase::recordToProps(record, &docInfo);
+				doc.set_data(XapianDatabase::propsToRecord(&docInfo));
+				pIndex->replace_document(*docIter, doc);
+				++upgradedCount;
+			}
+#ifdef DEBUG
+			clog << "XapianIndex::upgradeRecords: upgraded " << upgradedCount << "/" << docIds.size() << " documents" << endl;
+#endif
+		}
+	}
+	catch (const Xapian::Error &error)
+	{
+		clog << "Couldn't upgrade documents: " << error.get_type() << ": " << error.get_msg() << endl;
+	}
+	catch (...)
+	{
+		clog << "Couldn't upgrade documents, unknown exception occured" << endl;
+	}
+	pDatabase->unlock();
+
+	return upgradedCount;
+}
+
 /// Flushes recent changes to the disk.
 bool XapianIndex::flush(void)
 {
@@ -2126,6 +2646,7 @@ bool XapianIndex::flush(void)
 		if (pIndex != NULL)
 		{
 			pIndex->flush();
+			pDatabase->markCommitted();
 			flushed = true;
 		}
 	}
@@ -19,6 +19,7 @@
 #ifndef _XAPIAN_INDEX_H
 #define _XAPIAN_INDEX_H
 
+#include <pthread.h>
 #include <string>
 #include <set>
 #include <map>
@@ -28,15 +29,6 @@
 #include "XapianDatabase.h"
 #include "IndexInterface.h"
 
-#if !ENABLE_XAPIAN_DB_METADATA
-// Database metadata is only available in Xapian > 1.0.2
-#if XAPIAN_NUM_VERSION > 1000002
-#define ENABLE_XAPIAN_DB_METADATA 1
-#else
-#define ENABLE_XAPIAN_DB_METADATA 0
-#endif
-#endif
-
 /// A Xapian-based index.
 class XapianIndex : public IndexInterface
 {
@@ -62,6 +54,10 @@ class XapianIndex : public IndexInterface
 		/// Returns a document's properties.
 		virtual bool getDocumentInfo(unsigned int docId, DocumentInfo &docInfo) const;
 
+		/// Returns the properties of the given documents; returns the number found.
+		virtual unsigned int getDocumentsInfo(const std::set<unsigned int> &docIds,
+			std::map<unsigned int, DocumentInfo> &docsInfo) const;
+
 		/// Returns a document's terms count.
 		virtual unsigned int getDocumentTermsCount(unsigned int docId) const;
 
@@ -98,6 +94,10 @@ class XapianIndex : public IndexInterface
 		/// Checks whether the given URL is in the index.
 		virtual unsigned int hasDocument(const std::string &url) const;
 
+		/// Checks which of the given URLs are in the index; returns the number found.
+		virtual unsigned int hasDocuments(const std::set<std::string> &urls,
+			std::map<std::string, unsigned int> &docIds) const;
+
 		/// Gets terms with the same root.
 		virtual unsigned int getCloseTerms(const std::string &term, std::set<std::string> &suggestions);
 
@@ -115,6 +115,14 @@ class XapianIndex : public IndexInterface
 		virtual bool listDocuments(const std::string &name, std::set<unsigned int> &docIds,
 			NameType type, unsigned int maxDocsCount = 0, unsigned int startDoc = 0) const;
 
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual unsigned int listDocumentsAfter(std::set<unsigned int> &docIds,
+			unsigned int &lastDocId, unsigned int maxDocsCount = 0) const;
+
+		/// Lists documents that come after lastDocId, which is set to the last document listed.
+		virtual bool listDocumentsAfter(const std::string &name, std::set<unsigned int> &docIds,
+			NameType type, unsigned int &lastDocId, unsigned int maxDocsCount = 0) const;
+
 		/// Indexes the given data.
 		virtual bool indexDocument(const Document &doc, const std::set<std::string> &labels,
 			unsigned int &docId);
@@ -125,6 +133,10 @@ class XapianIndex : public IndexInterface
 		/// Updates a document's properties.
 		virtual bool updateDocumentInfo(unsigned int docId, const DocumentInfo &docInfo);
 
+		/// Moves a directory or file and the documents it holds to a new name.
+		virtual bool moveDocuments(const std::string &previousName, const std::string &name,
+			NameType type);
+
 		/// Unindexes the given document.
 		virtual bool unindexDocument(unsigned int docId);
 
@@ -137,6 +149,9 @@ class XapianIndex : public IndexInterface
 		/// Unindexes all documents.
 		virtual bool unindexAllDocuments(void);
 
+		/// Rewrites documents' data in the current record format; returns the number rewritten.
+		virtual unsigned int upgradeRecords(void);
+
 		/// Flushes recent changes to the disk.
 		virtual bool flush(void);
 
@@ -147,21 +162,35 @@ class XapianIndex : public IndexInterface
 		virtual bool reset(void);
 
 	protected:
+		static pthread_key_t m_stemmersKey;
+		static pthread_once_t m_stemmersKeyOnce;
 		std::string m_databaseName;
 		bool m_goodIndex;
 		bool m_doSpelling;
 		std::string m_stemLanguage;
 
+		static void createStemmersKey(void);
+
+		static void deleteStemmers(void *pStemmers);
+
+		/// Returns the calling thread's stemmer for the language, NULL if not supported.
+		static Xapian::Stem *getStemmer(const std::string &language);
+
+		static std::string getNameTerm(const std::string &name, NameType type);
+
 		bool listDocumentsWithTerm(const std::string &term, std::set<unsigned int> &docIds,
 			unsigned int maxDocsCount = 0, unsigned int startDoc = 0) const;
 
+		bool listDocumentsWithTermAfter(const std::string &term, std::set<unsigned int> &docIds,
+			unsigned int &lastDocId, unsigned int maxDocsCount = 0) const;
+
 		void addPostingsToDocument(const Xapian::Utf8Iterator &itor, Xapian::Document &doc,
-			const Xapian::WritableDatabase &db, const std::string &prefix,
+			std::map<std::string, Xapian::termcount> &spellingTerms, const std::string &prefix,
 			bool noStemming, bool &doSpelling,  Xapian::termcount &termPos) const;
 
 		void addPostingsToDocument(Dijon::CJKVTokenizer &tokenizer, Xapian::Stem *pStemmer,
-			const std::string &text, Xapian::Document &doc,
-			const Xapian::WritableDatabase &db, const std::string &prefix,
+			const char *pText, unsigned int textLength, Xapian::Document &doc,
+			std::map<std::string, Xapian::termcount> &spellingTerms, const std::string &prefix,
 			bool &doSpelling, Xapian::termcount &termPos) const;
 
 		static void addLabelsToDocument(Xapian::Document &doc,
@@ -172,10 +201,13 @@ class XapianIndex : public IndexInterface
 			bool noStemming, bool &doSpelling) const;
 
 		void addCommonTerms(const DocumentInfo &info, Xapian::Document &doc,
-			const Xapian::WritableDatabase &db, Xapian::termcount &termPos);
+			std::map<std::string, Xapian::termcount> &spellingTerms, Xapian::termcount &termPos);
 
 		void removeCommonTerms(Xapian::Document &doc, const Xapian::WritableDatabase &db);
 
+		void addSpelling(const Xapian::WritableDatabase &db,
+			const std::map<std::string, Xapian::termcount> &spellingTerms);
+
 		std::string scanDocument(const std::string &suggestedLanguage,
 			const char *pData, off_t dataLength);
 
@@ -18,6 +18,7 @@
  */
 
 #include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 #include <string.h>
 #include <iostream>
@@ -152,6 +153,72 @@ static inline unsigned char *_unicode_to_char(gunichar &uchar,
 	return p;
 }
 
+/// How split() and tokenize() see each ASCII character.
+class ASCIITable
+{
+	public:
+		ASCIITable()
+		{
+			unsigned char p[sizeof(gunichar) + 1];
+
+			for (gunichar uchar = 0; uchar < 0x80; ++uchar)
+			{
+				m_chars[uchar] = (char)_unicode_to_char(uchar, p)[0];
+				m_isSpace[uchar] = (isspace((int)p[0]) != 0);
+				m_isAlnum[uchar] = (isalnum((int)p[0]) != 0);
+			}
+		}
+
+		char m_chars[0x80];
+		bool m_isSpace[0x80];
+		bool m_isAlnum[0x80];
+
+};
+
+static ASCIITable ascii_table;
+
+// Scans a word at a time for the first NUL and for any byte that's not ASCII
+static unsigned int _scan_ascii(const char *str, unsigned int length,
+	bool &is_ascii)
+{
+	const uint64_t low_bits = 0x0101010101010101ULL;
+	const uint64_t high_bits = 0x8080808080808080ULL;
+	unsigned int pos = 0;
+
+	is_ascii = true;
+	while (pos + sizeof(uint64_t) <= length)
+	{
+		uint64_t word;
+
+		memcpy(&word, str + pos, sizeof(uint64_t));
+		if (((word & high_bits) != 0) ||
+			(((word - low_bits) & ~word & high_bits) != 0))
+		{
+			// Look closer
+			break;
+		}
+		pos += sizeof(uint64_t);
+	}
+	while (pos < length)
+	{
+		unsigned char c = (unsigned char)str[pos];
+
+		if (c == '\0')
+		{
+			break;
+		}
+		if (c >= 0x80)
+		{
+			// Where the text ends doesn't matter any more
+			is_ascii = false;
+			break;
+		}
+		++pos;
+	}
+
+	return pos;
+}
+
 class VectorTokensHandler : public CJKVTokenizer::TokensHandler
 {
 	public:
@@ -295,13 +362,29 @@ void CJKVTokenizer::tokenize(const string &str, vector<string> &token_list,
 
 void CJKVTokenizer::tokenize(const string &str, TokensHandler &handler,
 	bool break_ascii_only_on_space)
+{
+	tokenize(str.c_str(), str.length(), handler, break_ascii_only_on_space);
+}
+
+void CJKVTokenizer::tokenize(const char *str, unsigned int length,
+	TokensHandler &handler, bool break_ascii_only_on_space)
 {
 	string token_str;
 	vector<string> temp_token_list;
 	vector<gunichar> temp_uchar_list;
 	unsigned int tokens_count = 0;
+	bool is_ascii = false;
+	unsigned int ascii_length = _scan_ascii(str, length, is_ascii);
 
-	split(str, temp_token_list, temp_uchar_list);
+	if (is_ascii == true)
+	{
+		// There's nothing to decode, normalize or n-gram
+		tokenize_ascii(str, min(ascii_length, m_maxTextSize), handler,
+			break_ascii_only_on_space);
+		return;
+	}
+
+	split(str, length, temp_token_list, temp_uchar_list);
 
 	for (unsigned int i = 0; i < temp_token_list.size();)
 	{
@@ -396,13 +479,75 @@ void CJKVTokenizer::tokenize(const string &str, TokensHandler &handler,
 	}
 }
 
+void CJKVTokenizer::tokenize_ascii(const char *str, unsigned int length,
+	TokensHandler &handler, bool break_ascii_only_on_space)
+{
+	string token_str;
+	unsigned int tokens_count = 0;
+
+	for (unsigned int i = 0; i < length;)
+	{
+		if ((m_maxTokenCount > 0) &&
+			(tokens_count >= m_maxTokenCount))
+		{
+			break;
+		}
+		token_str.resize(0);
+
+		// Same rules as for non-CJKV characters in tokenize()
+		unsigned int j = i;
+		while (j < length)
+		{
+			unsigned char c = (unsigned char)str[j];
+			bool break_ascii = false;
+
+			if (break_ascii_only_on_space == true)
+			{
+				break_ascii = ascii_table.m_isSpace[c];
+			}
+			else
+			{
+				break_ascii = !ascii_table.m_isAlnum[c];
+			}
+
+			++j;
+			if (break_ascii == true)
+			{
+				break;
+			}
+			token_str += ascii_table.m_chars[c];
+		}
+		i = j;
+
+		// ASCII is already normalized
+		if ((token_str.empty() == false) &&
+			(handler.handle_token(token_str, false) == true))
+		{
+			++tokens_count;
+		}
+	}
+}
+
 void CJKVTokenizer::split(const string &str,
 	vector<string> &string_list,
 	vector<gunichar> &unicode_list)
+{
+	split(str.c_str(), str.length(), string_list, unicode_list);
+}
+
+void CJKVTokenizer::split(const char *str, unsigned int length,
+	vector<string> &string_list,
+	vector<gunichar> &unicode_list)
 {
 	gunichar uchar;
-	const char *str_ptr = str.c_str();
-	glong str_utf8_len = g_utf8_strlen(str_ptr, str.length());
+	const char *str_ptr = str;
+
+	if (str == NULL)
+	{
+		return;
+	}
+
+	glong str_utf8_len = g_utf8_strlen(str_ptr, length);
 	unsigned char p[sizeof(gunichar) + 1];
 
 	for (glong i = 0; i < str_utf8_len; i++)
@@ -440,11 +585,28 @@ void CJKVTokenizer::segment(const string &str, vector<string> &token_segment)
 }
 
 bool CJKVTokenizer::has_cjkv(const string &str)
+{
+	return has_cjkv(str.c_str(), str.length());
+}
+
+bool CJKVTokenizer::has_cjkv(const char *str, unsigned int length)
 {
 	vector<string> temp_token_list;
 	vector<gunichar> temp_uchar_list;
+	bool is_ascii = false;
 
-	split(str, temp_token_list, temp_uchar_list);
+	if (str == NULL)
+	{
+		return false;
+	}
+
+	_scan_ascii(str, length, is_ascii);
+	if (is_ascii == true)
+	{
+		return false;
+	}
+
+	split(str, length, temp_token_list, temp_uchar_list);
 
 	for (unsigned int i = 0; i < temp_uchar_list.size(); i++)
 	{
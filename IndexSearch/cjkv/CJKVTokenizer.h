@@ -74,15 +74,25 @@ namespace Dijon
 				TokensHandler &handler,
 				bool break_ascii_only_on_space = false);
 
+			void tokenize(const char *str, unsigned int length,
+				TokensHandler &handler,
+				bool break_ascii_only_on_space = false);
+
 			void split(const std::string &str,
 				std::vector<std::string> &string_list,
 				std::vector<gunichar> &unicode_list);
 
+			void split(const char *str, unsigned int length,
+				std::vector<std::string> &string_list,
+				std::vector<gunichar> &unicode_list);
+
 			void segment(const std::string &str,
 				std::vector<std::string> &token_segment);
 
 			bool has_cjkv(const std::string &str);
 
+			bool has_cjkv(const char *str, unsigned int length);
+
 			bool has_cjkv_only(const std::string &str);
 
 		protected:
@@ -90,6 +100,9 @@ namespace Dijon
 			unsigned int m_maxTokenCount;
 			unsigned int m_maxTextSize;
 
+			void tokenize_ascii(const char *str, unsigned int length,
+				TokensHandler &handler, bool break_ascii_only_on_space);
+
 	};
 };
 
@@ -0,0 +1,399 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <iostream>
+
+#include "EventCoalescer.h"
+
+using std::clog;
+using std::endl;
+using std::string;
+using std::map;
+using std::multimap;
+using std::pair;
+using std::queue;
+
+EventCoalescer::PendingEvent::PendingEvent() :
+	m_sequence(0),
+	m_firstTime(0)
+{
+}
+
+EventCoalescer::PendingEvent::PendingEvent(const MonitorEvent &event, unsigned long sequence) :
+	m_event(event),
+	m_sequence(sequence),
+	m_firstTime(event.m_time)
+{
+}
+
+EventCoalescer::PendingEvent::PendingEvent(const PendingEvent &other) :
+	m_event(other.m_event),
+	m_sequence(other.m_sequence),
+	m_firstTime(other.m_firstTime),
+	m_deadlineIter(other.m_deadlineIter)
+{
+}
+
+EventCoalescer::PendingEvent::~PendingEvent()
+{
+}
+
+EventCoalescer::PendingEvent &EventCoalescer::PendingEvent::operator=(const PendingEvent &other)
+{
+	if (this != &other)
+	{
+		m_event = other.m_event;
+		m_sequence = other.m_sequence;
+		m_firstTime = other.m_firstTime;
+		m_deadlineIter = other.m_deadlineIter;
+	}
+
+	return *this;
+}
+
+EventCoalescer::EventCoalescer(unsigned int quietPeriod, unsigned int maxDelay) :
+	m_quietPeriod(quietPeriod),
+	m_maxDelay(maxDelay),
+	m_sequence(0),
+	m_eventsInCount(0),
+	m_eventsOutCount(0)
+{
+	if (m_maxDelay < m_quietPeriod)
+	{
+		m_maxDelay = m_quietPeriod;
+	}
+}
+
+EventCoalescer::~EventCoalescer()
+{
+}
+
+time_t EventCoalescer::getDeadline(const PendingEvent &pendingEvent) const
+{
+	time_t readyTime = pendingEvent.m_event.m_time + (time_t)m_quietPeriod;
+
+	// Quiet for long enough, or held back for too long
+	if (pendingEvent.m_firstTime + (time_t)m_maxDelay < readyTime)
+	{
+		readyTime = pendingEvent.m_firstTime + (time_t)m_maxDelay;
+	}
+
+	return readyTime;
+}
+
+void EventCoalescer::forget(map<string, PendingEvent>::iterator pendingIter)
+{
+	m_deadlines.erase(pendingIter->second.m_deadlineIter);
+	m_pendingEvents.erase(pendingIter);
+}
+
+void EventCoalescer::release(map<string, PendingEvent>::iterator pendingIter)
+{
+	m_readyEvents.push(pendingIter->second.m_event);
+	forget(pendingIter);
+}
+
+void EventCoalescer::hold(const MonitorEvent &event, time_t firstTime)
+{
+	PendingEvent pendingEvent(event, ++m_sequence);
+
+	pendingEvent.m_firstTime = firstTime;
+	pendingEvent.m_deadlineIter = m_deadlines.insert(pair<time_t, string>(getDeadline(pendingEvent), event.m_location));
+	m_pendingEvents[event.m_location] = pendingEvent;
+}
+
+void EventCoalescer::touch(map<string, PendingEvent>::iterator pendingIter, time_t eventTime)
+{
+	PendingEvent &pendingEvent = pendingIter->second;
+
+	// The deadline moves on
+	pendingEvent.m_event.m_time = eventTime;
+	m_deadlines.erase(pendingEvent.m_deadlineIter);
+	pendingEvent.m_deadlineIter = m_deadlines.insert(pair<time_t, string>(getDeadline(pendingEvent), pendingIter->first));
+}
+
+void EventCoalescer::pushFileEvent(const MonitorEvent &event)
+{
+	MonitorEvent newEvent(event);
+
+	if (newEvent.m_type == MonitorEvent::MOVED)
+	{
+		// Is there anything pending on the source ?
+		map<string, PendingEvent>::iterator sourceIter = m_pendingEvents.find(newEvent.m_previousLocation);
+		if (sourceIter != m_pendingEvents.end())
+		{
+			MonitorEvent &sourceEvent = sourceIter->second.m_event;
+
+			if (sourceEvent.m_type == MonitorEvent::CREATED)
+			{
+				// The source was never reported, so report the destination as new
+				forget(sourceIter);
+				newEvent.m_type = MonitorEvent::CREATED;
+				newEvent.m_previousLocation.clear();
+			}
+			else if (sourceEvent.m_type == MonitorEvent::MOVED)
+			{
+				string originalLocation(sourceEvent.m_previousLocation);
+
+				// Merge the chain of moves
+				forget(sourceIter);
+				if (originalLocation == newEvent.m_location)
+				{
+#ifdef DEBUG
+					clog << "EventCoalescer::pushFileEvent: " << newEvent.m_location
+						<< " moved back to where it was" << endl;
+#endif
+					return;
+				}
+				newEvent.m_previousLocation = originalLocation;
+			}
+			else
+			{
+				release(sourceIter);
+			}
+		}
+	}
+
+	map<string, PendingEvent>::iterator pendingIter = m_pendingEvents.find(newEvent.m_location);
+	if (pendingIter == m_pendingEvents.end())
+	{
+		hold(newEvent, newEvent.m_time);
+		return;
+	}
+
+	MonitorEvent &pendingEvent = pendingIter->second.m_event;
+	time_t firstTime = pendingIter->second.m_firstTime;
+
+	switch (newEvent.m_type)
+	{
+		case MonitorEvent::EXISTS:
+			// Whatever is pending tells more
+			if (pendingEvent.m_type == MonitorEvent::EXISTS)
+			{
+				touch(pendingIter, newEvent.m_time);
+			}
+			break;
+		case MonitorEvent::CREATED:
+			if (pendingEvent.m_type == MonitorEvent::DELETED)
+			{
+				// Deleted then created again, it was modified
+				forget(pendingIter);
+				newEvent.m_type = MonitorEvent::WRITE_CLOSED;
+				hold(newEvent, firstTime);
+			}
+			else if (pendingEvent.m_type == MonitorEvent::CREATED)
+			{
+				touch(pendingIter, newEvent.m_time);
+			}
+			else if ((pendingEvent.m_type == MonitorEvent::WRITE_CLOSED) ||
+				(pendingEvent.m_type == MonitorEvent::EXISTS))
+			{
+				// Replaced, typically by a temporary file that was renamed
+				forget(pendingIter);
+				hold(newEvent, firstTime);
+			}
+			else
+			{
+				release(pendingIter);
+				hold(newEvent, newEvent.m_time);
+			}
+			break;
+		case MonitorEvent::WRITE_CLOSED:
+			if ((pendingEvent.m_type == MonitorEvent::CREATED) ||
+				(pendingEvent.m_type == MonitorEvent::WRITE_CLOSED))
+			{
+				// Collapse repeated writes
+				touch(pendingIter, newEvent.m_time);
+			}
+			else if (pendingEvent.m_type == MonitorEvent::EXISTS)
+			{
+				forget(pendingIter);
+				hold(newEvent, firstTime);
+			}
+			else
+			{
+				release(pendingIter);
+				hold(newEvent, newEvent.m_time);
+			}
+			break;
+		case MonitorEvent::DELETED:
+			if (pendingEvent.m_type == MonitorEvent::CREATED)
+			{
+				// Created then deleted, there's nothing to report
+				forget(pendingIter);
+			}
+			else if (pendingEvent.m_type == MonitorEvent::MOVED)
+			{
+				// What was deleted is known under the original location
+				newEvent.m_location = pendingEvent.m_previousLocation;
+				forget(pendingIter);
+				pushFileEvent(newEvent);
+			}
+			else
+			{
+				forget(pendingIter);
+				hold(newEvent, firstTime);
+			}
+			break;
+		default:
+			// The destination was overwritten
+			release(pendingIter);
+			hold(newEvent, newEvent.m_time);
+			break;
+	}
+}
+
+void EventCoalescer::pushDirectoryEvent(const MonitorEvent &event)
+{
+	if ((event.m_type == MonitorEvent::MOVED) ||
+		(event.m_type == MonitorEvent::DELETED))
+	{
+		string dirName(event.m_location + "/");
+		string previousDirName(event.m_previousLocation + "/");
+
+		// Events below this directory must be reported first
+		map<string, PendingEvent>::iterator pendingIter = m_pendingEvents.begin();
+		while (pendingIter != m_pendingEvents.end())
+		{
+			map<string, PendingEvent>::iterator nextIter = pendingIter;
+			++nextIter;
+
+			if ((pendingIter->first.compare(0, dirName.length(), dirName) == 0) ||
+				((event.m_type == MonitorEvent::MOVED) &&
+				(pendingIter->first.compare(0, previousDirName.length(), previousDirName) == 0)))
+			{
+				release(pendingIter);
+			}
+
+			pendingIter = nextIter;
+		}
+	}
+
+	m_readyEvents.push(event);
+}
+
+/// Adds an event, merging it with pending events if possible.
+void EventCoalescer::push(const MonitorEvent &event)
+{
+	++m_eventsInCount;
+
+	if ((event.m_location.empty() == true) ||
+		(event.m_type == MonitorEvent::UNKNOWN))
+	{
+		return;
+	}
+
+	if (event.m_isDirectory == true)
+	{
+		pushDirectoryEvent(event);
+	}
+	else
+	{
+		pushFileEvent(event);
+	}
+}
+
+/// Moves events that are ready, or all pending events, to the queue.
+void EventCoalescer::pop(queue<MonitorEvent> &events, time_t timeNow, bool all)
+{
+	map<unsigned long, MonitorEvent> readyEvents;
+
+	while (m_readyEvents.empty() == false)
+	{
+		events.push(m_readyEvents.front());
+		m_readyEvents.pop();
+		++m_eventsOutCount;
+	}
+
+	if (all == true)
+	{
+		for (map<string, PendingEvent>::const_iterator pendingIter = m_pendingEvents.begin();
+			pendingIter != m_pendingEvents.end(); ++pendingIter)
+		{
+			readyEvents[pendingIter->second.m_sequence] = pendingIter->second.m_event;
+		}
+		m_pendingEvents.clear();
+		m_deadlines.clear();
+	}
+	else
+	{
+		// Deadlines are sorted, stop at the first one that's still ahead
+		while ((m_deadlines.empty() == false) &&
+			(m_deadlines.begin()->first <= timeNow))
+		{
+			map<string, PendingEvent>::iterator pendingIter = m_pendingEvents.find(m_deadlines.begin()->second);
+
+			if (pendingIter == m_pendingEvents.end())
+			{
+				m_deadlines.erase(m_deadlines.begin());
+				continue;
+			}
+
+			readyEvents[pendingIter->second.m_sequence] = pendingIter->second.m_event;
+			forget(pendingIter);
+		}
+	}
+
+	// In the order they were first held
+	for (map<unsigned long, MonitorEvent>::const_iterator readyIter = readyEvents.begin();
+		readyIter != readyEvents.end(); ++readyIter)
+	{
+		events.push(readyIter->second);
+		++m_eventsOutCount;
+	}
+}
+
+/// Returns the number of seconds until the next event is ready.
+int EventCoalescer::getTimeout(time_t timeNow) const
+{
+	int timeout = -1;
+
+	if (m_readyEvents.empty() == false)
+	{
+		return 0;
+	}
+
+	if (m_deadlines.empty() == false)
+	{
+		time_t readyTime = m_deadlines.begin()->first;
+
+		if (readyTime <= timeNow)
+		{
+			return 0;
+		}
+		timeout = (int)(readyTime - timeNow);
+	}
+
+	return timeout;
+}
+
+/// Returns the number of pending events.
+unsigned int EventCoalescer::getPendingCount(void) const
+{
+	return m_pendingEvents.size() + m_readyEvents.size();
+}
+
+/// Returns the number of events pushed so far.
+unsigned long EventCoalescer::getEventsInCount(void) const
+{
+	return m_eventsInCount;
+}
+
+/// Returns the number of events popped so far.
+unsigned long EventCoalescer::getEventsOutCount(void) const
+{
+	return m_eventsOutCount;
+}
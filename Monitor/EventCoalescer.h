@@ -0,0 +1,100 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _EVENT_COALESCER_H
+#define _EVENT_COALESCER_H
+
+#include <time.h>
+#include <string>
+#include <map>
+#include <queue>
+
+#include "MonitorEvent.h"
+
+/// Holds file events until their location has been quiet for a while.
+class EventCoalescer
+{
+	public:
+		EventCoalescer(unsigned int quietPeriod = 5, unsigned int maxDelay = 60);
+		virtual ~EventCoalescer();
+
+		/// Adds an event, merging it with pending events if possible.
+		void push(const MonitorEvent &event);
+
+		/// Moves events that are ready, or all pending events, to the queue.
+		void pop(std::queue<MonitorEvent> &events, time_t timeNow, bool all = false);
+
+		/// Returns the number of seconds until the next event is ready.
+		int getTimeout(time_t timeNow) const;
+
+		/// Returns the number of pending events.
+		unsigned int getPendingCount(void) const;
+
+		/// Returns the number of events pushed so far.
+		unsigned long getEventsInCount(void) const;
+
+		/// Returns the number of events popped so far.
+		unsigned long getEventsOutCount(void) const;
+
+	protected:
+		/// A pending event.
+		class PendingEvent
+		{
+			public:
+				PendingEvent();
+				PendingEvent(const MonitorEvent &event, unsigned long sequence);
+				PendingEvent(const PendingEvent &other);
+				~PendingEvent();
+
+				PendingEvent &operator=(const PendingEvent &other);
+
+				MonitorEvent m_event;
+				unsigned long m_sequence;
+				time_t m_firstTime;
+				std::multimap<time_t, std::string>::iterator m_deadlineIter;
+
+		};
+
+		unsigned int m_quietPeriod;
+		unsigned int m_maxDelay;
+		std::map<std::string, PendingEvent> m_pendingEvents;
+		std::multimap<time_t, std::string> m_deadlines;
+		std::queue<MonitorEvent> m_readyEvents;
+		unsigned long m_sequence;
+		unsigned long m_eventsInCount;
+		unsigned long m_eventsOutCount;
+
+		time_t getDeadline(const PendingEvent &pendingEvent) const;
+
+		void forget(std::map<std::string, PendingEvent>::iterator pendingIter);
+
+		void release(std::map<std::string, PendingEvent>::iterator pendingIter);
+
+		void hold(const MonitorEvent &event, time_t firstTime);
+
+		void touch(std::map<std::string, PendingEvent>::iterator pendingIter, time_t eventTime);
+
+		void pushFileEvent(const MonitorEvent &event);
+
+		void pushDirectoryEvent(const MonitorEvent &event);
+
+	private:
+		EventCoalescer(const EventCoalescer &other);
+		EventCoalescer &operator=(const EventCoalescer &other);
+
+};
+
+#endif // _EVENT_COALESCER_H
@@ -52,6 +52,9 @@ ActionQueue::ActionQueue(const string &database, const string queueId) :
 	prepareStatement("select-oldest-url",
 		"SELECT Type, Info FROM ActionQueue "
 		"WHERE QueueId=? ORDER BY Date DESC LIMIT 1;");
+	prepareStatement("select-oldest-urls",
+		"SELECT Info FROM ActionQueue "
+		"WHERE QueueId=? AND Type=? ORDER BY Date DESC LIMIT ?;");
 	prepareStatement("expire-items",
 		"DELETE FROM ActionQueue WHERE QueueId=? AND Date<?;");
 }
@@ -124,6 +127,45 @@ bool ActionQueue::create(const string &database)
 
 /// Pushes an item.
 bool ActionQueue::pushItem(ActionType type, const DocumentInfo &docInfo)
+{
+	return insertItem(type, docInfo);
+}
+
+/// Pushes items in one transaction.
+bool ActionQueue::pushItems(ActionType type, const vector<DocumentInfo> &docsInfo)
+{
+	bool success = true;
+
+	if (docsInfo.empty() == true)
+	{
+		return true;
+	}
+
+	if (beginTransaction() == false)
+	{
+		return false;
+	}
+
+	for (vector<DocumentInfo>::const_iterator docIter = docsInfo.begin();
+		docIter != docsInfo.end(); ++docIter)
+	{
+		if (insertItem(type, *docIter) == false)
+		{
+			success = false;
+			break;
+		}
+	}
+
+	if (success == false)
+	{
+		rollbackTransaction();
+		return false;
+	}
+
+	return endTransaction();
+}
+
+bool ActionQueue::insertItem(ActionType type, const DocumentInfo &docInfo)
 {
 	vector<string> values;
 	string url(docInfo.getLocation());
@@ -141,7 +183,7 @@ bool ActionQueue::pushItem(ActionType type, const DocumentInfo &docInfo)
 		if (row != NULL)
 		{
 #ifdef DEBUG
-			clog << "ActionQueue::pushItem: item "
+			clog << "ActionQueue::insertItem: item "
 				<< Url::unescapeUrl(row->getColumn(0)) << " exists" << endl;
 #endif
 			update = true;
@@ -176,7 +218,7 @@ bool ActionQueue::pushItem(ActionType type, const DocumentInfo &docInfo)
 	if (results != NULL)
 	{
 #ifdef DEBUG
-		clog << "ActionQueue::pushItem: queue " << m_queueId
+		clog << "ActionQueue::insertItem: queue " << m_queueId
 			<< ": " << type << " on " << url << ", " << update << endl;
 #endif
 		success = true;
@@ -218,6 +260,82 @@ bool ActionQueue::popItem(ActionType &type, DocumentInfo &docInfo)
 	return success;
 }
 
+/// Pops and deletes up to maxCount of the oldest items of a particular type.
+bool ActionQueue::popItems(ActionType type, unsigned int maxCount,
+	vector<DocumentInfo> &docsInfo)
+{
+	vector<string> values;
+	stringstream numStr;
+	unsigned int docsCount = docsInfo.size();
+	bool success = true;
+
+	if (beginTransaction() == false)
+	{
+		return false;
+	}
+
+	numStr << maxCount;
+	values.push_back(m_queueId);
+	values.push_back(typeToText(type));
+	values.push_back(numStr.str());
+
+	SQLResults *results = executePreparedStatement("select-oldest-urls", values);
+	if (results != NULL)
+	{
+		SQLRow *row = results->nextRow();
+		while (row != NULL)
+		{
+			DocumentInfo docInfo;
+
+			// Deserialize DocumentInfo
+			docInfo.deserialize(row->getColumn(0));
+			docsInfo.push_back(docInfo);
+
+			delete row;
+
+			row = results->nextRow();
+		}
+
+		delete results;
+	}
+
+	// Delete what was selected
+	for (vector<DocumentInfo>::const_iterator docIter = docsInfo.begin() + docsCount;
+		docIter != docsInfo.end(); ++docIter)
+	{
+		values.clear();
+		values.push_back(m_queueId);
+		values.push_back(Url::escapeUrl(docIter->getLocation()));
+
+		results = executePreparedStatement("pop-item", values);
+		if (results == NULL)
+		{
+			success = false;
+			break;
+		}
+		delete results;
+	}
+
+	if (success == false)
+	{
+		rollbackTransaction();
+		docsInfo.resize(docsCount);
+		return false;
+	}
+
+	if (endTransaction() == false)
+	{
+		docsInfo.resize(docsCount);
+		return false;
+	}
+#ifdef DEBUG
+	clog << "ActionQueue::popItems: queue " << m_queueId
+		<< ": popped " << docsInfo.size() - docsCount << " items" << endl;
+#endif
+
+	return (docsInfo.size() > docsCount);
+}
+
 bool ActionQueue::getOldestItem(ActionType &type, DocumentInfo &docInfo)
 {
 	vector<string> values;
@@ -21,6 +21,7 @@
 
 #include <time.h>
 #include <string>
+#include <vector>
 
 #include "DocumentInfo.h"
 #include "SQLiteBase.h"
@@ -40,9 +41,16 @@ class ActionQueue : public SQLiteBase
 		/// Pushes an item.
 		bool pushItem(ActionType type, const DocumentInfo &docInfo);
 
+		/// Pushes items in one transaction.
+		bool pushItems(ActionType type, const std::vector<DocumentInfo> &docsInfo);
+
 		/// Pops and deletes the oldest item.
 		bool popItem(ActionType &type, DocumentInfo &docInfo);
 
+		/// Pops and deletes up to maxCount of the oldest items of a particular type.
+		bool popItems(ActionType type, unsigned int maxCount,
+			std::vector<DocumentInfo> &docsInfo);
+
 		/// Returns the number of items of a particular type.
 		unsigned int getItemsCount(ActionType type);
 
@@ -55,6 +63,8 @@ class ActionQueue : public SQLiteBase
         protected:
 		std::string m_queueId;
 
+		bool insertItem(ActionType type, const DocumentInfo &docInfo);
+
 		bool getOldestItem(ActionType &type, DocumentInfo &docInfo);
 
 		static std::string typeToText(ActionType type);
@@ -45,6 +45,8 @@ CrawlHistory::CrawlHistory(const string &database) :
 		"INSERT INTO CrawlHistory VALUES(?, ?, ?, ?, ?);");
 	prepareStatement("has-item",
 		"SELECT Status, Date FROM CrawlHistory WHERE Url=?;");
+	prepareStatement("get-directory-items",
+		"SELECT Url, Status, Date, ErrorNum FROM CrawlHistory WHERE Url>=? AND Url<?;");
 	prepareStatement("update-item",
 		"UPDATE CrawlHistory SET Status=?, Date=?, ErrorNum=? WHERE Url=?;");
 	prepareStatement("update-items-status1",
@@ -312,6 +314,34 @@ bool CrawlHistory::insertItem(const string &url, CrawlStatus status, unsigned in
 	return success;
 }
 
+/// Inserts URLs.
+bool CrawlHistory::insertItems(const map<string, CrawlItem> &items, unsigned int sourceId)
+{
+	bool success = false;
+
+	if (beginTransaction() == false)
+	{
+		return false;
+	}
+
+	for (map<string, CrawlItem>::const_iterator insertIter = items.begin();
+		insertIter != items.end(); ++insertIter)
+	{
+		if (insertItem(insertIter->first, insertIter->second.m_itemStatus,
+			sourceId, insertIter->second.m_itemDate, insertIter->second.m_errNum) == true)
+		{
+			success = true;
+		}
+	}
+
+	if (endTransaction() == false)
+	{
+		return false;
+	}
+
+	return success;
+}
+
 /// Checks if an URL is in the history.
 bool CrawlHistory::hasItem(const string &url, CrawlStatus &status, time_t &date)
 {
@@ -339,6 +369,60 @@ bool CrawlHistory::hasItem(const string &url, CrawlStatus &status, time_t &date)
 	return success;
 }
 
+/// Returns the items directly under a directory URL.
+unsigned int CrawlHistory::getDirectoryItems(const string &dirUrl,
+	map<string, CrawlItem> &items)
+{
+	vector<string> values;
+	string escapedDirUrl(Url::escapeUrl(dirUrl));
+	unsigned int count = 0;
+
+	if (escapedDirUrl.empty() == true)
+	{
+		return 0;
+	}
+	if (escapedDirUrl[escapedDirUrl.length() - 1] == '/')
+	{
+		escapedDirUrl.resize(escapedDirUrl.length() - 1);
+	}
+
+	// Everything in [dir/, dir0[ is under this directory since '0' follows '/'
+	values.push_back(escapedDirUrl + "/");
+	values.push_back(escapedDirUrl + "0");
+
+	SQLResults *results = executePreparedStatement("get-directory-items", values);
+	if (results != NULL)
+	{
+		while (results->hasMoreRows() == true)
+		{
+			SQLRow *row = results->nextRow();
+			if (row == NULL)
+			{
+				break;
+			}
+
+			string escapedUrl(row->getColumn(0));
+
+			// Skip items in sub-directories
+			if (escapedUrl.find('/', escapedDirUrl.length() + 1) == string::npos)
+			{
+				items[Url::unescapeUrl(escapedUrl)] = CrawlItem(textToStatus(row->getColumn(1)),
+					(time_t)atoi(row->getColumn(2).c_str()), atoi(row->getColumn(3).c_str()));
+				++count;
+			}
+
+			delete row;
+		}
+
+		delete results;
+	}
+#ifdef DEBUG
+	clog << "CrawlHistory::getDirectoryItems: " << count << " items under " << dirUrl << endl;
+#endif
+
+	return count;
+}
+
 /// Updates an URL.
 bool CrawlHistory::updateItem(const string &url, CrawlStatus status, time_t date, int errNum)
 {
@@ -624,6 +708,42 @@ bool CrawlHistory::deleteItems(const string &url)
 	return success;
 }
 
+/// Moves an URL and all items under it to a new URL.
+bool CrawlHistory::moveItems(const string &previousUrl, const string &url)
+{
+	string escapedPreviousUrl(Url::escapeUrl(previousUrl));
+	bool success = false;
+
+	if (escapedPreviousUrl.empty() == true)
+	{
+		return false;
+	}
+
+	if (beginTransaction() == false)
+	{
+		return false;
+	}
+
+	// Rewrite the prefix of all items at once, replacing those already at the destination
+	// Items under the URL are in [url/, url0[ so that the index on Url can be used
+	SQLResults *results = executeStatement("UPDATE OR REPLACE CrawlHistory \
+		SET Url='%q' || substr(Url, %u) WHERE Url='%q' OR (Url >= '%q/' AND Url < '%q0');",
+		Url::escapeUrl(url).c_str(), (unsigned int)escapedPreviousUrl.length() + 1,
+		escapedPreviousUrl.c_str(), escapedPreviousUrl.c_str(), escapedPreviousUrl.c_str());
+	if (results != NULL)
+	{
+		success = true;
+		delete results;
+	}
+
+	if (endTransaction() == false)
+	{
+		return false;
+	}
+
+	return success;
+}
+
 /// Deletes URLs belonging to a source.
 bool CrawlHistory::deleteItems(unsigned int sourceId, CrawlStatus status)
 {
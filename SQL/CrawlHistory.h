@@ -56,9 +56,16 @@ class CrawlHistory : public SQLiteBase
 		bool insertItem(const std::string &url, CrawlStatus status, unsigned int sourceId,
 			time_t date, int errNum = 0);
 
+		/// Inserts URLs.
+		bool insertItems(const std::map<std::string, class CrawlItem> &items, unsigned int sourceId);
+
 		/// Checks if an URL is in the history.
 		bool hasItem(const std::string &url, CrawlStatus &status, time_t &date);
 
+		/// Returns the items directly under a directory URL.
+		unsigned int getDirectoryItems(const std::string &dirUrl,
+			std::map<std::string, class CrawlItem> &items);
+
 		/// Updates an URL.
 		bool updateItem(const std::string &url, CrawlStatus status, time_t date, int errNum = 0);
 
@@ -90,6 +97,9 @@ class CrawlHistory : public SQLiteBase
 		/// Deletes all items under a given URL.
 		bool deleteItems(const std::string &url);
 
+		/// Moves an URL and all items under it to a new URL.
+		bool moveItems(const std::string &previousUrl, const std::string &url);
+
 		/// Deletes URLs belonging to a source.
 		bool deleteItems(unsigned int sourceId, CrawlStatus status = UNKNOWN);
 
@@ -23,7 +23,6 @@
 #include <time.h>
 #include <iostream>
 
-#include "TimeConverter.h"
 #include "Url.h"
 #include "QueryHistory.h"
 
@@ -196,7 +195,7 @@ bool QueryHistory::getItems(const string &queryName, const string &engineName,
 			result.setExtract(row->getColumn(2));
 			result.setScore((float)atof(row->getColumn(3).c_str()));
 			int runDate = atoi(row->getColumn(4).c_str());
-			result.setTimestamp(TimeConverter::toTimestamp((time_t)runDate));
+			result.setTime((time_t)runDate);
 
 			resultsList.push_back(result);
 			success = true;
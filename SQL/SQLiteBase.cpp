@@ -19,9 +19,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <algorithm>
 #include <iostream>
+#include <sstream>
 
 #include "config.h"
 #include "NLS.h"
@@ -32,8 +36,25 @@ using std::endl;
 using std::string;
 using std::vector;
 using std::map;
+using std::set;
 using std::pair;
 using std::for_each;
+using std::stringstream;
+
+static bool isJournalMode(const string &journalMode)
+{
+	const char *pModes[] = { "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF", NULL };
+
+	for (unsigned int modeNum = 0; pModes[modeNum] != NULL; ++modeNum)
+	{
+		if (strcasecmp(journalMode.c_str(), pModes[modeNum]) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
 
 static int busyHandler(void *pData, int lockNum)
 {
@@ -304,6 +325,19 @@ bool SQLiteResults::rewind(void)
 	return true;
 }
 
+// Several threads write to the history database at once
+// With WAL, readers don't block writers and writers don't block readers
+const string SQLiteBase::m_journalMode("WAL");
+const string SQLiteBase::m_synchronousMode("NORMAL");
+const long long SQLiteBase::m_mmapSize = 64 * 1024 * 1024;
+// Negative sizes are in KiB
+const int SQLiteBase::m_cacheSize = -8192;
+// In pages
+const int SQLiteBase::m_autoCheckpoint = 1000;
+// Databases whose journal mode was set by this process
+pthread_mutex_t SQLiteBase::m_journalMutex = PTHREAD_MUTEX_INITIALIZER;
+set<string> SQLiteBase::m_journaledDatabases;
+
 SQLiteBase::SQLiteBase(const string &databaseName,
 	bool readOnly, bool onDemand) :
 	SQLDB(databaseName, readOnly),
@@ -344,6 +378,118 @@ void SQLiteBase::executeSimpleStatement(const string &sql, int &execError)
 	}
 }
 
+void SQLiteBase::applyProfile(void)
+{
+	string journalMode(m_journalMode);
+	string synchronousMode(m_synchronousMode);
+	bool setJournalMode = false;
+	int execError = SQLITE_OK;
+
+	// The journal mode is persistent, it only needs to be set once
+	if ((m_readOnly == false) &&
+		(pthread_mutex_lock(&m_journalMutex) == 0))
+	{
+		if (m_journaledDatabases.find(m_databaseName) == m_journaledDatabases.end())
+		{
+			setJournalMode = true;
+		}
+
+		pthread_mutex_unlock(&m_journalMutex);
+	}
+	if (setJournalMode == true)
+	{
+		char *pEnvVar = getenv("PINOT_SQLITE_JOURNAL_MODE");
+		if ((pEnvVar != NULL) &&
+			(strlen(pEnvVar) > 0))
+		{
+			if (isJournalMode(pEnvVar) == true)
+			{
+				journalMode = pEnvVar;
+			}
+			else
+			{
+				clog << "Couldn't use journal mode " << pEnvVar << endl;
+			}
+		}
+
+		// This can only be changed when nothing else is using the database
+		executeSimpleStatement(string("PRAGMA journal_mode=") + journalMode + ";", execError);
+		if ((execError == SQLITE_OK) &&
+			(pthread_mutex_lock(&m_journalMutex) == 0))
+		{
+			m_journaledDatabases.insert(m_databaseName);
+
+			pthread_mutex_unlock(&m_journalMutex);
+		}
+	}
+
+	// Other settings only last as long as the connection, don't slow down short-lived ones
+	if (m_onDemand == true)
+	{
+		return;
+	}
+
+	// Each pragma is run on its own so that one failing doesn't prevent the others
+	// Pragmas this version of SQLite doesn't know about are ignored
+	if (synchronousMode == "NORMAL")
+	{
+		sqlite3_stmt *pStatement = NULL;
+		bool inWALMode = false;
+
+		// Check what mode the database is actually in
+		if (sqlite3_prepare_v2(m_pDatabase, "PRAGMA journal_mode;", -1, &pStatement, NULL) == SQLITE_OK)
+		{
+			if (sqlite3_step(pStatement) == SQLITE_ROW)
+			{
+				const char *pMode = (const char *)sqlite3_column_text(pStatement, 0);
+
+				if ((pMode != NULL) &&
+					(strncasecmp(pMode, "wal", 3) == 0))
+				{
+					inWALMode = true;
+				}
+			}
+			sqlite3_finalize(pStatement);
+		}
+
+		// NORMAL is only safe from corruption in WAL mode
+		if (inWALMode == false)
+		{
+			synchronousMode = "FULL";
+		}
+	}
+	if (synchronousMode.empty() == false)
+	{
+		executeSimpleStatement(string("PRAGMA synchronous=") + synchronousMode + ";", execError);
+	}
+	if (m_mmapSize > 0)
+	{
+		stringstream pragma;
+
+		pragma << "PRAGMA mmap_size=" << m_mmapSize << ";";
+		executeSimpleStatement(pragma.str(), execError);
+	}
+	if (m_cacheSize != 0)
+	{
+		stringstream pragma;
+
+		pragma << "PRAGMA cache_size=" << m_cacheSize << ";";
+		executeSimpleStatement(pragma.str(), execError);
+	}
+	if ((m_readOnly == false) &&
+		(m_autoCheckpoint > 0))
+	{
+		stringstream pragma;
+
+		pragma << "PRAGMA wal_autocheckpoint=" << m_autoCheckpoint << ";";
+		executeSimpleStatement(pragma.str(), execError);
+	}
+#ifdef DEBUG
+	clog << "SQLiteBase::applyProfile: journal mode " << journalMode
+		<< ", synchronous mode " << synchronousMode << endl;
+#endif
+}
+
 void SQLiteBase::open(void)
 {
 	int openFlags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE;
@@ -370,6 +516,8 @@ void SQLiteBase::open(void)
 	{
 		// Set up a busy handler
 		sqlite3_busy_handler(m_pDatabase, busyHandler, NULL);
+
+		applyProfile();
 	}
 	else
 	{
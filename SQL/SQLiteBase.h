@@ -19,8 +19,10 @@
 #ifndef _SQLITE_BASE_H
 #define _SQLITE_BASE_H
 
+#include <pthread.h>
 #include <string>
 #include <map>
+#include <set>
 #include <vector>
 #include <utility>
 
@@ -122,6 +124,13 @@ class SQLiteBase : public SQLDB
 			const std::vector<std::pair<std::string, SQLRow::SQLType> > &values);
 
 	protected:
+		static const std::string m_journalMode;
+		static const std::string m_synchronousMode;
+		static const long long m_mmapSize;
+		static const int m_cacheSize;
+		static const int m_autoCheckpoint;
+		static pthread_mutex_t m_journalMutex;
+		static std::set<std::string> m_journaledDatabases;
 		bool m_onDemand;
 		bool m_inTransaction;
 		sqlite3 *m_pDatabase;
@@ -129,6 +138,8 @@ class SQLiteBase : public SQLDB
 
 		void executeSimpleStatement(const std::string &sql, int &execError);
 
+		void applyProfile(void);
+
 		void open(void);
 
 		void close(void);
@@ -305,7 +305,15 @@ bool FilterUtils::feedFilter(const Document &doc, Dijon::Filter *pFilter)
 			if ((dataLength > 0) &&
 				(pData != NULL))
 			{
-				fedInput = pFilter->set_document_data(pData, dataLength);
+				// The copy goes away before the filter does, so it can't be borrowed
+				if (pFilter->is_data_input_ok(Dijon::Filter::DOCUMENT_STRING) == true)
+				{
+					fedInput = pFilter->set_document_string(string(pData, dataLength));
+				}
+				else
+				{
+					fedInput = pFilter->set_document_data(pData, dataLength);
+				}
 			}
 			// Else, the file may be empty
 		}
@@ -432,8 +440,10 @@ bool FilterUtils::populateDocument(Document &doc, Dijon::Filter *pFilter)
 		doc.setTitle(string(utf8Data.c_str(), utf8Data.length()));
 	}
 
-	const dstring &content = pFilter->get_content();
-	if (content.empty() == false)
+	off_t contentLength = 0;
+	const char *pContent = pFilter->get_content_data(contentLength);
+	if ((pContent != NULL) &&
+		(contentLength > 0))
 	{
 		// Scan for the MIME type ?
 		if (checkFileType == true)
@@ -454,11 +464,13 @@ bool FilterUtils::populateDocument(Document &doc, Dijon::Filter *pFilter)
 		}
 		if (checkDataType == true)
 		{
-			doc.setType(MIMEScanner::scanData(content.c_str(), content.length()));
+			doc.setType(MIMEScanner::scanData(pContent, contentLength));
 		}
 
-		if (doc.getType().substr(0, 10) == "text/plain")
+		if ((doc.getType().substr(0, 10) == "text/plain") &&
+			(converter.needsConversion(charset) == true))
 		{
+			dstring content(pContent, contentLength);
 			dstring utf8Data(converter.toUTF8(content, charset));
 
 			if (converter.getErrorsCount() > 0)
@@ -469,14 +481,15 @@ bool FilterUtils::populateDocument(Document &doc, Dijon::Filter *pFilter)
 		}
 		else
 		{
-			doc.setData(content.c_str(), content.length());
+			// The content is only needed until the filter moves on
+			doc.borrowData(pContent, contentLength);
 		}
 	}
 
 	// If the document is big'ish, try and reclaim memory
 	int inUse = Memory::getUsage();
 	if ((size > SIZE_THRESHOLD) ||
-		(content.length() > SIZE_THRESHOLD))
+		(contentLength > SIZE_THRESHOLD))
 	{
 		Memory::reclaim();
 	}
@@ -638,7 +651,12 @@ bool FilterUtils::reduceDocument(const Document &doc, ReducedAction &action)
 {
 	string originalType(doc.getType());
 
-	return filterDocument(doc, originalType, action);
+	bool reducedDoc = filterDocument(doc, originalType, action);
+
+	// Let go of the blocks filters needed for this document
+	Memory::releaseArena();
+
+	return reducedDoc;
 }
 
 string FilterUtils::stripMarkup(const string &text)
@@ -60,6 +60,7 @@ class PINOT_EXPORT FilterUtils
 		static bool feedFilter(const Document &doc, Dijon::Filter *pFilter);
 
 		/// Populates a document based on metadata extracted by the filter.
+		/// The document may reference the filter's content until the filter moves on.
 		static bool populateDocument(Document &doc, Dijon::Filter *pFilter);
 
 		/// Filters a document until reduced to the minimum.
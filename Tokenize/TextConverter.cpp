@@ -142,6 +142,24 @@ dstring TextConverter::convert(const dstring &text,
 	return outputText;
 }
 
+bool TextConverter::needsConversion(const string &charset) const
+{
+	string textCharset(StringManip::toLowerCase(charset));
+
+	if (textCharset == "utf-8")
+	{
+		return false;
+	}
+	if ((textCharset.empty() == true) &&
+		(m_utf8Locale == true))
+	{
+		// The current locale uses UTF-8
+		return false;
+	}
+
+	return true;
+}
+
 dstring TextConverter::toUTF8(const dstring &text,
 	string &charset)
 {
@@ -150,7 +168,7 @@ dstring TextConverter::toUTF8(const dstring &text,
 	m_conversionErrors = 0;
 
 	if ((text.empty() == true) ||
-		(textCharset == "utf-8"))
+		(needsConversion(charset) == false))
 	{
 		// No conversion necessary
 		return text;
@@ -158,12 +176,6 @@ dstring TextConverter::toUTF8(const dstring &text,
 
 	if (textCharset.empty() == true)
 	{
-		if (m_utf8Locale == true)
-		{
-			// The current locale uses UTF-8
-			return text;
-		}
-
 		textCharset = m_localeCharset;
 	}
 
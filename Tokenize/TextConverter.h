@@ -30,6 +30,9 @@ class PINOT_EXPORT TextConverter
 		TextConverter(unsigned int maxErrors = 10);
 		virtual ~TextConverter();
 
+		/// Returns true if text in this charset has to be converted to UTF-8.
+		bool needsConversion(const std::string &charset) const;
+
 		/// Converts to UTF-8.
 		dstring toUTF8(const dstring &text,
 			std::string &charset);
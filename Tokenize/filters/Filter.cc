@@ -34,6 +34,8 @@ using namespace Dijon;
 
 Filter::Filter(const string &mime_type) :
 	m_mimeType(mime_type),
+	m_pBorrowedContent(NULL),
+	m_borrowedLength(0),
 	m_deleteInputFile(false)
 {
 }
@@ -69,13 +71,35 @@ const map<string, std::string> &Filter::get_meta_data(void) const
 
 const dstring &Filter::get_content(void) const
 {
+	if ((m_pBorrowedContent != NULL) &&
+		(m_content.empty() == true))
+	{
+		// This caller needs a copy
+		const_cast<Filter *>(this)->m_content.assign(m_pBorrowedContent, m_borrowedLength);
+	}
+
 	return m_content;
 }
 
+const char *Filter::get_content_data(off_t &data_length) const
+{
+	if ((m_pBorrowedContent != NULL) &&
+		(m_content.empty() == true))
+	{
+		data_length = m_borrowedLength;
+		return m_pBorrowedContent;
+	}
+
+	data_length = (off_t)m_content.length();
+	return m_content.c_str();
+}
+
 void Filter::rewind(void)
 {
 	m_metaData.clear();
 	m_content.clear();
+	m_pBorrowedContent = NULL;
+	m_borrowedLength = 0;
 	deleteInputFile();
 	m_filePath.clear();
 	m_deleteInputFile = false;
@@ -180,6 +180,11 @@ namespace Dijon
 	/// Returns content.
 	const dstring &get_content(void) const;
 
+	/** Returns content, without copying it if it was borrowed from the input data.
+	 * The pointer is only valid until the filter moves to another document.
+	 */
+	const char *get_content_data(off_t &data_length) const;
+
     protected:
 	/// The MIME type handled by the filter.
 	std::string m_mimeType;
@@ -187,6 +192,10 @@ namespace Dijon
 	std::map<std::string, std::string> m_metaData;
 	/// Content.
 	dstring m_content;
+	/// Content borrowed from the input data, if any.
+	const char *m_pBorrowedContent;
+	/// Length of the borrowed content.
+	off_t m_borrowedLength;
 	/// The name of the input file, if any.
 	std::string m_filePath;
 
@@ -60,8 +60,18 @@ bool TextFilter::set_document_data(const char *data_ptr, off_t data_length)
 		return false;
 	}
 
-	string text_doc(data_ptr, data_length);
-	return set_document_string(text_doc);
+	rewind();
+
+#ifdef DEBUG
+	clog << "TextFilter::set_document_data: " << data_length << " bytes of text" << endl;
+#endif
+	// The caller keeps the data valid, there's no need to copy it
+	m_pBorrowedContent = data_ptr;
+	m_borrowedLength = data_length;
+	m_metaData["ipath"] = "";
+	m_metaData["mimetype"] = "text/plain";
+
+	return true;
 }
 
 bool TextFilter::set_document_string(const string &data_str)
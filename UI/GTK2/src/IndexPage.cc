@@ -262,6 +262,11 @@ unsigned int IndexPage::getDocumentsCount(void) const
 //
 void IndexPage::setDocumentsCount(unsigned int docsCount)
 {
+	if (docsCount != m_docsCount)
+	{
+		// Positions have changed
+		m_lastDocIds.clear();
+	}
 	m_docsCount = docsCount;
 }
 
@@ -281,6 +286,33 @@ void IndexPage::setFirstDocument(unsigned int startDoc)
 	m_firstDoc = startDoc;
 }
 
+//
+// Gets the ID of the document listed right before the given position, 0 if unknown.
+//
+unsigned int IndexPage::getLastDocumentId(unsigned int startDoc) const
+{
+	map<unsigned int, unsigned int>::const_iterator docIter = m_lastDocIds.find(startDoc);
+
+	if (docIter == m_lastDocIds.end())
+	{
+		return 0;
+	}
+
+	return docIter->second;
+}
+
+//
+// Sets the ID of the document listed right before the given position.
+//
+void IndexPage::setLastDocumentId(unsigned int startDoc, unsigned int docId)
+{
+	if ((startDoc > 0) &&
+		(docId > 0))
+	{
+		m_lastDocIds[startDoc] = docId;
+	}
+}
+
 //
 // Returns the changed query signal.
 //
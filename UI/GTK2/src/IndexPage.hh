@@ -20,6 +20,7 @@
 #define _INDEXPAGE_HH
 
 #include <string>
+#include <map>
 #include <vector>
 #include <sigc++/sigc++.h>
 #include <glibmm/refptr.h>
@@ -66,6 +67,12 @@ class IndexPage : public NotebookPageBox
 		/// Sets the first document.
 		void setFirstDocument(unsigned int startDoc);
 
+		/// Gets the ID of the document listed right before the given position, 0 if unknown.
+		unsigned int getLastDocumentId(unsigned int startDoc) const;
+
+		/// Sets the ID of the document listed right before the given position.
+		void setLastDocumentId(unsigned int startDoc, unsigned int docId);
+
 		/// Returns the changed query signal.
 		sigc::signal2<void, Glib::ustring, Glib::ustring>& getQueryChangedSignal(void);
 
@@ -83,6 +90,7 @@ class IndexPage : public NotebookPageBox
 		Gtk::Button *m_pForwardButton;
 		unsigned int m_docsCount;
 		unsigned int m_firstDoc;
+		std::map<unsigned int, unsigned int> m_lastDocIds;
 		sigc::signal2<void, Glib::ustring, Glib::ustring> m_signalQueryChanged;
 		sigc::signal1<void, Glib::ustring> m_signalBackClicked;
 		sigc::signal1<void, Glib::ustring> m_signalForwardClicked;
@@ -24,6 +24,7 @@
 #include <signal.h>
 #include <exception>
 #include <iostream>
+#include <map>
 
 #include "config.h"
 #include "NLS.h"
@@ -36,9 +37,10 @@ using namespace Glib;
 using namespace std;
 
 IndexBrowserThread::IndexBrowserThread(const PinotSettings::IndexProperties &indexProps,
-	unsigned int maxDocsCount, unsigned int startDoc) :
+	unsigned int maxDocsCount, unsigned int startDoc, unsigned int lastDocId) :
 	ListerThread(indexProps, startDoc),
-	m_maxDocsCount(maxDocsCount)
+	m_maxDocsCount(maxDocsCount),
+	m_lastDocId(lastDocId)
 {
 }
 
@@ -46,11 +48,15 @@ IndexBrowserThread::~IndexBrowserThread()
 {
 }
 
+unsigned int IndexBrowserThread::getLastDocumentId(void) const
+{
+	return m_lastDocId;
+}
+
 void IndexBrowserThread::doWork(void)
 {
 	set<unsigned int> docIDList;
-	set<string> docLabels;
-	unsigned int numDocs = 0;
+	map<unsigned int, DocumentInfo> docsInfo;
 
 	if (m_indexProps.m_location.empty() == true)
 	{
@@ -84,41 +90,52 @@ void IndexBrowserThread::doWork(void)
 
 #ifdef DEBUG
 	clog << "IndexBrowserThread::doWork: " << m_maxDocsCount << " off " << m_documentsCount
-		<< " documents to browse, starting at position " << m_startDoc << endl;
+		<< " documents to browse, starting at position " << m_startDoc
+		<< " after document " << m_lastDocId << endl;
 #endif
-	pIndex->listDocuments(docIDList, m_maxDocsCount, m_startDoc);
+	if ((m_startDoc > 0) &&
+		(m_lastDocId > 0))
+	{
+		// Resume from where the previous page ended
+		pIndex->listDocumentsAfter(docIDList, m_lastDocId, m_maxDocsCount);
+	}
+	else
+	{
+		pIndex->listDocuments(docIDList, m_maxDocsCount, m_startDoc);
+		if (docIDList.empty() == false)
+		{
+			m_lastDocId = *docIDList.rbegin();
+		}
+	}
+
+	// Get all documents in one go
+	pIndex->getDocumentsInfo(docIDList, docsInfo);
 
 	m_documentsList.clear();
-	m_documentsList.reserve(m_maxDocsCount);
+	m_documentsList.reserve(docsInfo.size());
 
-	for (set<unsigned int>::iterator iter = docIDList.begin(); iter != docIDList.end(); ++iter)
+	for (map<unsigned int, DocumentInfo>::iterator docIter = docsInfo.begin();
+		docIter != docsInfo.end(); ++docIter)
 	{
-		unsigned int docId = (*iter);
+		DocumentInfo &docInfo = docIter->second;
+		string type(docInfo.getType());
 
-		if (m_done == true)
+		if (type.empty() == true)
 		{
-			break;
+			docInfo.setType("text/html");
 		}
+		docInfo.setIsIndexed(m_indexProps.m_id, docIter->first);
 
-		DocumentInfo docInfo;
-		if (pIndex->getDocumentInfo(docId, docInfo) == true)
-		{
-			string type(docInfo.getType());
-
-			if (type.empty() == true)
-			{
-				docInfo.setType("text/html");
-			}
-			docInfo.setIsIndexed(m_indexProps.m_id, docId);
-
-			// Insert that document
-			m_documentsList.push_back(docInfo);
-			++numDocs;
-		}
+		// Insert that document
+		m_documentsList.push_back(docInfo);
+	}
 #ifdef DEBUG
-		else clog << "IndexBrowserThread::doWork: couldn't retrieve document " << docId << endl;
-#endif
+	if (docsInfo.size() < docIDList.size())
+	{
+		clog << "IndexBrowserThread::doWork: couldn't retrieve " << docIDList.size() - docsInfo.size()
+			<< " documents" << endl;
 	}
+#endif
 	delete pIndex;
 }
 
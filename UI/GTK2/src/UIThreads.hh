@@ -31,13 +31,17 @@ class IndexBrowserThread : public ListerThread
 {
 	public:
 		IndexBrowserThread(const PinotSettings::IndexProperties &indexProps,
-			unsigned int maxDocsCount, unsigned int startDoc = 0);
+			unsigned int maxDocsCount, unsigned int startDoc = 0,
+			unsigned int lastDocId = 0);
 		~IndexBrowserThread();
 
 		std::string getLabelName(void) const;
 
+		unsigned int getLastDocumentId(void) const;
+
 	protected:
 		unsigned int m_maxDocsCount;
+		unsigned int m_lastDocId;
 
 		virtual void doWork(void);
 
@@ -1441,6 +1441,14 @@ void mainWindow::on_thread_end(WorkerThread *pThread)
 				pIndexPage->setDocumentsCount(pListThread->getDocumentsCount());
 				pIndexPage->updateButtonsState(m_maxDocsCount);
 
+				IndexBrowserThread *pBrowseThread = dynamic_cast<IndexBrowserThread *>(pThread);
+				if (pBrowseThread != NULL)
+				{
+					// Remember where the next page starts
+					pIndexPage->setLastDocumentId(pIndexPage->getFirstDocument() + m_maxDocsCount,
+						pBrowseThread->getLastDocumentId());
+				}
+
 				status = _("Showing");
 				status += " ";
 				snprintf(docsCountStr, 64, "%u", pIndexPage->getFirstDocument());
@@ -3598,6 +3606,7 @@ void mainWindow::browse_index(const ustring &indexName, const ustring &queryName
 	}
 	m_state.m_browsingIndex = true;
 
+	unsigned int lastDocId = 0;
 	IndexPage *pIndexPage = dynamic_cast<IndexPage*>(get_page(indexName, NotebookPageBox::INDEX_PAGE));
 	if (pIndexPage != NULL)
 	{
@@ -3608,6 +3617,7 @@ void mainWindow::browse_index(const ustring &indexName, const ustring &queryName
 			pResultsTree->clear();
 		}
 		pIndexPage->setFirstDocument(startDoc);
+		lastDocId = pIndexPage->getLastDocumentId(startDoc);
 
 		if (changePage == true)
 		{
@@ -3628,7 +3638,7 @@ void mainWindow::browse_index(const ustring &indexName, const ustring &queryName
 	// Spawn a new thread to browse the index
 	if (queryName.empty() == true)
 	{
-		start_thread(new IndexBrowserThread(indexProps, m_maxDocsCount, startDoc));
+		start_thread(new IndexBrowserThread(indexProps, m_maxDocsCount, startDoc, lastDocId));
 	}
 	else
 	{
@@ -359,8 +359,25 @@ int main(int argc, char **argv)
 	// ...and the daemon index in read-only mode
 	// If it can't be open, it just means the daemon has not yet created it
 	ModuleFactory::openOrCreateIndex(settings.m_defaultBackend, settings.m_daemonIndexLocation, wasObsoleteFormat, true);
-	// Merge these two, this will be useful later
-	ModuleFactory::mergeIndexes(settings.m_defaultBackend, "MERGED", settings.m_docsIndexLocation, settings.m_daemonIndexLocation);
+	// Merge these two and any other index, this will be useful later
+	vector<string> mergedIndexes;
+	mergedIndexes.push_back(settings.m_docsIndexLocation);
+	mergedIndexes.push_back(settings.m_daemonIndexLocation);
+	for (set<PinotSettings::IndexProperties>::const_iterator indexIter = settings.getIndexes().begin();
+		indexIter != settings.getIndexes().end(); ++indexIter)
+	{
+		if ((indexIter->m_location == settings.m_docsIndexLocation) ||
+			(indexIter->m_location == settings.m_daemonIndexLocation))
+		{
+			continue;
+		}
+
+		if (ModuleFactory::openOrCreateIndex(settings.m_defaultBackend, indexIter->m_location, wasObsoleteFormat, true) == true)
+		{
+			mergedIndexes.push_back(indexIter->m_location);
+		}
+	}
+	ModuleFactory::mergeIndexes(settings.m_defaultBackend, "MERGED", mergedIndexes);
 
 	// Do the same for the history database
 	string historyDatabase(settings.getHistoryDatabaseName());
@@ -35,7 +35,6 @@
 #include <set>
 
 #include "Document.h"
-#include "TimeConverter.h"
 #include "Memory.h"
 
 using std::clog;
@@ -67,7 +66,8 @@ Document::Document() :
 	DocumentInfo(),
 	m_pData(NULL),
 	m_dataLength(0),
-	m_isMapped(false)
+	m_isMapped(false),
+	m_isBorrowed(false)
 {
 }
 
@@ -76,7 +76,8 @@ Document::Document(const string &title, const string &location,
 	DocumentInfo(title, location, type, language),
 	m_pData(NULL),
 	m_dataLength(0),
-	m_isMapped(false)
+	m_isMapped(false),
+	m_isBorrowed(false)
 {
 }
 
@@ -84,7 +85,8 @@ Document::Document(const DocumentInfo &info) :
 	DocumentInfo(info),
 	m_pData(NULL),
 	m_dataLength(0),
-	m_isMapped(false)
+	m_isMapped(false),
+	m_isBorrowed(false)
 {
 }
 
@@ -92,7 +94,8 @@ Document::Document(const Document &other) :
 	DocumentInfo(other),
 	m_pData(NULL),
 	m_dataLength(0),
-	m_isMapped(false)
+	m_isMapped(false),
+	m_isBorrowed(false)
 {
 	// Copying does a deep copy
 	setData(other.m_pData, other.m_dataLength);
@@ -156,6 +159,44 @@ bool Document::setData(const char *data, off_t length)
 	return false;
 }
 
+/// Takes ownership of data allocated with Memory::allocateBuffer(length + 1).
+bool Document::adoptData(char *data, off_t length)
+{
+	if ((data == NULL) ||
+		(length == 0))
+	{
+		return false;
+	}
+
+	// Discard existing data
+	resetData();
+
+	m_pData = data;
+	m_pData[length] = '\0';
+	m_dataLength = length;
+
+	return true;
+}
+
+/// References the given data, which must remain valid while the document uses it.
+bool Document::borrowData(const char *data, off_t length)
+{
+	if ((data == NULL) ||
+		(length == 0))
+	{
+		return false;
+	}
+
+	// Discard existing data
+	resetData();
+
+	m_pData = const_cast<char *>(data);
+	m_dataLength = length;
+	m_isBorrowed = true;
+
+	return true;
+}
+
 /// Maps the given file.
 bool Document::setDataFromFile(const string &fileName)
 {
@@ -261,7 +302,7 @@ bool Document::setDataFromFile(const string &fileName)
 	else clog << "Document::setDataFromFile: reading failed" << endl;
 #endif
 
-	setTimestamp(TimeConverter::toTimestamp(fileStat.st_mtime));
+	setTime(fileStat.st_mtime);
 	setSize(fileStat.st_size);
 
 #ifdef HAVE_ATTR_XATTR_H
@@ -345,7 +386,8 @@ const char *Document::getData(off_t &length) const
 /// Resets the document's data.
 void Document::resetData(void)
 {
-	if (m_pData != NULL)
+	if ((m_pData != NULL) &&
+		(m_isBorrowed == false))
 	{
 		if (m_isMapped == false)
 		{
@@ -372,6 +414,7 @@ void Document::resetData(void)
 	m_pData = NULL;
 	m_dataLength = 0;
 	m_isMapped = false;
+	m_isBorrowed = false;
 }
 
 /// Checks whether the document is binary.
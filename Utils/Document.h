@@ -42,6 +42,12 @@ class PINOT_EXPORT Document : public DocumentInfo
 		/// Copies the given data in the document.
 		virtual bool setData(const char *data, off_t length);
 
+		/// Takes ownership of data allocated with Memory::allocateBuffer(length + 1).
+		virtual bool adoptData(char *data, off_t length);
+
+		/// References the given data, which must remain valid while the document uses it.
+		virtual bool borrowData(const char *data, off_t length);
+
 		/// Maps the given file.
 		virtual bool setDataFromFile(const std::string &fileName);
 
@@ -58,6 +64,7 @@ class PINOT_EXPORT Document : public DocumentInfo
 		char *m_pData;
 		off_t m_dataLength;
 		bool m_isMapped;
+		bool m_isBorrowed;
 
 };
 
@@ -20,7 +20,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <sstream>
 #include <algorithm>
 
 #include "StringManip.h"
@@ -29,34 +28,49 @@
 #include "Url.h"
 
 using std::string;
-using std::stringstream;
 using std::map;
 using std::set;
 using std::copy;
 using std::inserter;
 
 DocumentInfo::DocumentInfo() :
+	m_time(time(NULL)),
+	m_hasTimestamp(false),
+	m_hasTime(true),
+	m_size(0),
 	m_score(0.0),
 	m_indexId(0),
 	m_docId(0)
 {
-	setField("modtime", TimeConverter::toTimestamp(time(NULL)));
 }
 
 DocumentInfo::DocumentInfo(const string &title, const string &location,
 	const string &type, const string &language) :
+	m_title(title),
+	m_location(location),
+	m_type(type),
+	m_language(language),
+	m_time(time(NULL)),
+	m_hasTimestamp(false),
+	m_hasTime(true),
+	m_size(0),
 	m_score(0.0),
 	m_indexId(0),
 	m_docId(0)
 {
-	setField("caption", title);
-	setField("url", location);
-	setField("type", type);
-	setField("language", language);
-	setField("modtime", TimeConverter::toTimestamp(time(NULL)));
 }
 
 DocumentInfo::DocumentInfo(const DocumentInfo &other) :
+	m_title(other.m_title),
+	m_location(other.m_location),
+	m_internalPath(other.m_internalPath),
+	m_type(other.m_type),
+	m_language(other.m_language),
+	m_timestamp(other.m_timestamp),
+	m_time(other.m_time),
+	m_hasTimestamp(other.m_hasTimestamp),
+	m_hasTime(other.m_hasTime),
+	m_size(other.m_size),
 	m_fields(other.m_fields),
 	m_extract(other.m_extract),
 	m_score(other.m_score),
@@ -74,6 +88,16 @@ DocumentInfo& DocumentInfo::operator=(const DocumentInfo& other)
 {
 	if (this != &other)
 	{
+		m_title = other.m_title;
+		m_location = other.m_location;
+		m_internalPath = other.m_internalPath;
+		m_type = other.m_type;
+		m_language = other.m_language;
+		m_timestamp = other.m_timestamp;
+		m_time = other.m_time;
+		m_hasTimestamp = other.m_hasTimestamp;
+		m_hasTime = other.m_hasTime;
+		m_size = other.m_size;
 		m_fields = other.m_fields;
 		m_extract = other.m_extract;
 		m_score = other.m_score;
@@ -87,16 +111,13 @@ DocumentInfo& DocumentInfo::operator=(const DocumentInfo& other)
 
 bool DocumentInfo::operator<(const DocumentInfo& other) const
 {
-	string thisUrl(getField("url"));
-	string otherUrl(other.getField("url"));
-
-	if (thisUrl < otherUrl)
+	if (m_location < other.m_location)
 	{
 		return true;
 	}
-	else if (thisUrl == otherUrl)
+	else if (m_location == other.m_location)
 	{
-		if (getField("ipath") < other.getField("ipath"))
+		if (m_internalPath < other.m_internalPath)
 		{
 			return true;
 		}
@@ -115,6 +136,21 @@ string DocumentInfo::serialize(SerialExtent extent) const
 	if ((extent == SERIAL_ALL) ||
 		(extent == SERIAL_FIELDS))
 	{
+		info += "\ncaption=";
+		info += m_title;
+		info += "\nipath=";
+		info += m_internalPath;
+		info += "\nlanguage=";
+		info += m_language;
+		info += "\nmodtime=";
+		info += getTimestamp();
+		info += "\nsize=";
+		snprintf(numStr, 64, "%lld", (long long)m_size);
+		info += numStr;
+		info += "\ntype=";
+		info += m_type;
+		info += "\nurl=";
+		info += m_location;
 		for (map<string, string>::const_iterator fieldIter = m_fields.begin();
 			fieldIter != m_fields.end(); ++fieldIter)
 		{
@@ -164,13 +200,13 @@ void DocumentInfo::deserialize(const string &info, SerialExtent extent)
 	if ((extent == SERIAL_ALL) ||
 		(extent == SERIAL_FIELDS))
 	{
-		setField("caption", StringManip::extractField(unescapedInfo, "caption=", "\n"));
-		setField("url", StringManip::extractField(unescapedInfo, "url=", "\n"));
-		setField("ipath", StringManip::extractField(unescapedInfo, "ipath=", "\n"));
-		setField("type", StringManip::extractField(unescapedInfo, "type=", "\n"));
-		setField("language", StringManip::extractField(unescapedInfo, "language=", "\n"));
-		setField("modtime", StringManip::extractField(unescapedInfo, "modtime=", "\n"));
-		setField("size", StringManip::extractField(unescapedInfo, "size=", "\n"));
+		m_title = StringManip::extractField(unescapedInfo, "caption=", "\n");
+		m_location = StringManip::extractField(unescapedInfo, "url=", "\n");
+		m_internalPath = StringManip::extractField(unescapedInfo, "ipath=", "\n");
+		m_type = StringManip::extractField(unescapedInfo, "type=", "\n");
+		m_language = StringManip::extractField(unescapedInfo, "language=", "\n");
+		setTimestamp(StringManip::extractField(unescapedInfo, "modtime=", "\n"));
+		m_size = (off_t)atoll(StringManip::extractField(unescapedInfo, "size=", "\n").c_str());
 	}
 	if ((extent == SERIAL_ALL) ||
 		(extent == SERIAL_LABELS))
@@ -208,38 +244,34 @@ void DocumentInfo::deserialize(const string &info, SerialExtent extent)
 /// Sets the title of the document.
 void DocumentInfo::setTitle(const string &title)
 {
-	setField("caption", title);
+	m_title = title;
 }
 
 /// Returns the title of the document.
 string DocumentInfo::getTitle(void) const
 {
-	return getField("caption");
+	return m_title;
 }
 
 /// Sets the original location of the document.
 void DocumentInfo::setLocation(const string &location)
 {
-	setField("url", location);
+	m_location = location;
 }
 
 /// Returns the original location of the document.
 string DocumentInfo::getLocation(bool withIPath) const
 {
-	string url(getField("url"));
-
-	if (withIPath == false)
+	if ((withIPath == false) ||
+		(m_internalPath.empty() == true))
 	{
-		return url;
+		return m_location;
 	}
 
-	string ipath(getField("ipath"));
+	string url(m_location);
 
-	if (ipath.empty() == false)
-	{
-		url += "?";
-		url += ipath;
-	}
+	url += "?";
+	url += m_internalPath;
 
 	return url;
 }
@@ -247,71 +279,90 @@ string DocumentInfo::getLocation(bool withIPath) const
 /// Sets the internal path to the document.
 void DocumentInfo::setInternalPath(const string &ipath)
 {
-	setField("ipath", ipath);
+	m_internalPath = ipath;
 }
 
 /// Returns the internal path to the document.
 string DocumentInfo::getInternalPath(void) const
 {
-	return getField("ipath");
+	return m_internalPath;
 }
 
 /// Sets the type of the document.
 void DocumentInfo::setType(const string &type)
 {
-	setField("type", type);
+	m_type = type;
 }
 
 /// Returns the type of the document.
 string DocumentInfo::getType(void) const
 {
-	return getField("type");
+	return m_type;
 }
 
 /// Sets the language of the document.
 void DocumentInfo::setLanguage(const string &language)
 {
-	setField("language", language);
+	m_language = language;
 }
 
 /// Returns the document's language.
 string DocumentInfo::getLanguage(void) const
 {
-	return getField("language");
+	return m_language;
 }
 
 /// Sets the document's timestamp.
 void DocumentInfo::setTimestamp(const string &timestamp)
 {
-	setField("modtime", timestamp);
+	// The time is parsed when it's asked for
+	m_timestamp = timestamp;
+	m_hasTimestamp = true;
+	m_hasTime = false;
 }
 
 /// Returns the document's timestamp.
 string DocumentInfo::getTimestamp(void) const
 {
-	return getField("modtime");
+	// Nothing is cached here so that concurrent readers don't write
+	if (m_hasTimestamp == false)
+	{
+		return TimeConverter::toTimestamp(m_time);
+	}
+
+	return m_timestamp;
+}
+
+/// Sets the document's modification time.
+void DocumentInfo::setTime(time_t timeT)
+{
+	// The timestamp is formatted when it's asked for
+	m_time = timeT;
+	m_hasTime = true;
+	m_hasTimestamp = false;
+}
+
+/// Returns the document's modification time.
+time_t DocumentInfo::getTime(void) const
+{
+	if (m_hasTime == false)
+	{
+		return TimeConverter::fromTimestamp(m_timestamp);
+	}
+
+	return m_time;
 }
 
 /// Sets the document's size in bytes.
 void DocumentInfo::setSize(off_t size)
 {
-	stringstream sizeStr;
-
-	sizeStr << size;
-	setField("size", sizeStr.str());
+	m_size = size;
 }
 
 /// Returns the document's size in bytes.
 off_t DocumentInfo::getSize(void) const
 {
-	string sizeStr(getField("size"));
-
-	if (sizeStr.empty() == true)
-	{
-		return 0;
-	}
-
-	return (off_t)atoll(sizeStr.c_str());
+	return m_size;
 }
 
 /// Sets the document's extract.
@@ -399,11 +450,75 @@ unsigned int DocumentInfo::getIsIndexed(unsigned int &indexId) const
 
 void DocumentInfo::setField(const string &name, const string &value)
 {
-	m_fields[name] = value;
+	// Common fields have members of their own
+	if (name == "caption")
+	{
+		m_title = value;
+	}
+	else if (name == "url")
+	{
+		m_location = value;
+	}
+	else if (name == "ipath")
+	{
+		m_internalPath = value;
+	}
+	else if (name == "type")
+	{
+		m_type = value;
+	}
+	else if (name == "language")
+	{
+		m_language = value;
+	}
+	else if (name == "modtime")
+	{
+		setTimestamp(value);
+	}
+	else if (name == "size")
+	{
+		m_size = (off_t)atoll(value.c_str());
+	}
+	else
+	{
+		m_fields[name] = value;
+	}
 }
 
 string DocumentInfo::getField(const string &name) const
 {
+	if (name == "caption")
+	{
+		return m_title;
+	}
+	else if (name == "url")
+	{
+		return m_location;
+	}
+	else if (name == "ipath")
+	{
+		return m_internalPath;
+	}
+	else if (name == "type")
+	{
+		return m_type;
+	}
+	else if (name == "language")
+	{
+		return m_language;
+	}
+	else if (name == "modtime")
+	{
+		return getTimestamp();
+	}
+	else if (name == "size")
+	{
+		char numStr[64];
+
+		snprintf(numStr, 64, "%lld", (long long)m_size);
+		return numStr;
+	}
+
 	map<string, string>::const_iterator fieldIter = m_fields.find(name);
 	if (fieldIter != m_fields.end())
 	{
@@ -20,6 +20,7 @@
 #define _DOCUMENT_INFO_H
 
 #include <sys/types.h>
+#include <time.h>
 #include <string>
 #include <map>
 #include <set>
@@ -84,6 +85,12 @@ class PINOT_EXPORT DocumentInfo
 		/// Returns the document's timestamp.
 		virtual std::string getTimestamp(void) const;
 
+		/// Sets the document's modification time.
+		virtual void setTime(time_t timeT);
+
+		/// Returns the document's modification time.
+		virtual time_t getTime(void) const;
+
 		/// Sets the document's size in bytes.
 		virtual void setSize(off_t size);
 
@@ -128,6 +135,16 @@ class PINOT_EXPORT DocumentInfo
 		unsigned int getIsIndexed(unsigned int &indexId) const;
 
 	protected:
+		std::string m_title;
+		std::string m_location;
+		std::string m_internalPath;
+		std::string m_type;
+		std::string m_language;
+		std::string m_timestamp;
+		time_t m_time;
+		bool m_hasTimestamp;
+		bool m_hasTime;
+		off_t m_size;
 		std::map<std::string, std::string> m_fields;
 		std::string m_extract;
 		float m_score;
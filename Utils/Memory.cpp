@@ -24,55 +24,239 @@
 #include <malloc.h>
 #endif
 #endif
+#include <stdlib.h>
+#include <vector>
 
 #include "Memory.h"
 
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-#ifdef HAVE_UMEM_H
-// Memory pool with umem
-typedef boost::singleton_pool<umem_allocator_tag,
-	sizeof(char), umem_allocator,
-	boost::details::pool::default_mutex, 131072> filter_pool;
-#else
-// Memory pool with malloc (glibc's or any other implementation)
-// The tag is actually ignored
-typedef boost::singleton_pool<boost::pool_allocator_tag,
-	sizeof(char), boost::default_user_allocator_malloc_free,
-	boost::details::pool::default_mutex, 131072> filter_pool;
-#endif
-#endif
+// Blocks of up to 256 KB come in size classes, from 32 bytes up
+#define ARENA_MIN_SHIFT 5
+#define ARENA_CLASSES_COUNT 14
+// How much free memory a thread's arena may hold on to
+#define ARENA_MAX_CACHED_SIZE 2097152
+#define ARENA_RETAINED_SIZE 524288
 
 using std::clog;
 using std::endl;
 using std::string;
+using std::vector;
 
-Memory::Memory()
+static void *allocateRaw(size_t size)
 {
+#ifdef HAVE_UMEM_H
+	return umem_alloc(size, UMEM_DEFAULT);
+#else
+	return malloc(size);
+#endif
 }
 
-char *Memory::allocateBuffer(off_t length)
+static void freeRaw(void *pBlock, size_t size)
 {
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-	return static_cast<char*>(filter_pool::ordered_malloc(length));
-#else
 #ifdef HAVE_UMEM_H
-	return static_cast<char*>(umem_alloc(sizeof(char) * length, UMEM_DEFAULT));
+	umem_free(pBlock, size);
 #else
-	return static_cast<char*>(malloc(sizeof(char) * length));
+	// The heap knows how large the block is
+	(void)size;
+	free(pBlock);
+#endif
+}
+
+#ifdef ENABLE_MEMPOOL
+static int getSizeClass(size_t size, size_t &classSize)
+{
+	int sizeClass = 0;
+
+	classSize = ((size_t)1) << ARENA_MIN_SHIFT;
+	while (classSize < size)
+	{
+		++sizeClass;
+		if (sizeClass >= ARENA_CLASSES_COUNT)
+		{
+			classSize = size;
+			return -1;
+		}
+		classSize <<= 1;
+	}
+
+	return sizeClass;
+}
 #endif
+
+/// Free blocks held by a thread.
+class ThreadArena
+{
+	public:
+		ThreadArena(unsigned int generation) :
+			m_cachedSize(0),
+			m_generation(generation)
+		{
+		}
+		~ThreadArena()
+		{
+			release(0);
+		}
+
+		/// Frees blocks, largest first, until no more than retainedSize is held.
+		void release(size_t retainedSize)
+		{
+			for (int sizeClass = ARENA_CLASSES_COUNT - 1;
+				(sizeClass >= 0) && (m_cachedSize > retainedSize); --sizeClass)
+			{
+				size_t classSize = ((size_t)1) << (sizeClass + ARENA_MIN_SHIFT);
+
+				while ((m_freeBlocks[sizeClass].empty() == false) &&
+					(m_cachedSize > retainedSize))
+				{
+					freeRaw(m_freeBlocks[sizeClass].back(), classSize);
+					m_freeBlocks[sizeClass].pop_back();
+					m_cachedSize -= classSize;
+				}
+			}
+		}
+
+		vector<void *> m_freeBlocks[ARENA_CLASSES_COUNT];
+		size_t m_cachedSize;
+		unsigned int m_generation;
+
+	private:
+		ThreadArena(const ThreadArena &other);
+		ThreadArena &operator=(const ThreadArena &other);
+
+};
+
+pthread_key_t Memory::m_arenaKey;
+pthread_once_t Memory::m_arenaKeyOnce = PTHREAD_ONCE_INIT;
+// Any thread may reclaim, arenas only read the generation
+pthread_mutex_t Memory::m_arenaMutex = PTHREAD_MUTEX_INITIALIZER;
+volatile unsigned int Memory::m_arenaGeneration = 0;
+
+#ifdef ENABLE_MEMPOOL
+static ThreadArena *getArena(pthread_key_t arenaKey, unsigned int generation)
+{
+	ThreadArena *pArena = (ThreadArena *)pthread_getspecific(arenaKey);
+
+	if (pArena == NULL)
+	{
+		pArena = new ThreadArena(generation);
+		if (pthread_setspecific(arenaKey, (void *)pArena) != 0)
+		{
+			delete pArena;
+			return NULL;
+		}
+	}
+	else if (pArena->m_generation != generation)
+	{
+		// Memory was reclaimed since this thread last looked
+		pArena->release(0);
+		pArena->m_generation = generation;
+	}
+
+	return pArena;
+}
 #endif
+
+Memory::Memory()
+{
 }
 
-void Memory::freeBuffer(char *pBuffer, off_t length)
+void Memory::createArenaKey(void)
 {
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-	filter_pool::ordered_free(static_cast<void*>(pBuffer), length);
+	pthread_key_create(&m_arenaKey, Memory::deleteArena);
+}
+
+void Memory::deleteArena(void *pArena)
+{
+	if (pArena != NULL)
+	{
+		delete (ThreadArena *)pArena;
+	}
+}
+
+void *Memory::allocateBlock(size_t size)
+{
+#ifndef ENABLE_MEMPOOL
+	return allocateRaw(size);
 #else
-#ifdef HAVE_UMEM_H
-	umem_free(static_cast<void*>(pBuffer), n * sizeof(char));
+	size_t classSize = 0;
+	int sizeClass = getSizeClass(size, classSize);
+
+	if (sizeClass < 0)
+	{
+		// Too large to be worth recycling
+		return allocateRaw(size);
+	}
+
+	pthread_once(&m_arenaKeyOnce, Memory::createArenaKey);
+
+	ThreadArena *pArena = getArena(m_arenaKey, m_arenaGeneration);
+	if ((pArena != NULL) &&
+		(pArena->m_freeBlocks[sizeClass].empty() == false))
+	{
+		void *pBlock = pArena->m_freeBlocks[sizeClass].back();
+
+		pArena->m_freeBlocks[sizeClass].pop_back();
+		pArena->m_cachedSize -= classSize;
+
+		return pBlock;
+	}
+
+	return allocateRaw(classSize);
+#endif
+}
+
+void Memory::freeBlock(void *pBlock, size_t size)
+{
+	if (pBlock == NULL)
+	{
+		return;
+	}
+#ifndef ENABLE_MEMPOOL
+	freeRaw(pBlock, size);
 #else
-	free(pBuffer);
+	size_t classSize = 0;
+	int sizeClass = getSizeClass(size, classSize);
+	if (sizeClass < 0)
+	{
+		freeRaw(pBlock, size);
+		return;
+	}
+
+	pthread_once(&m_arenaKeyOnce, Memory::createArenaKey);
+
+	// Blocks are plain heap blocks, so any thread may keep the ones it frees
+	ThreadArena *pArena = getArena(m_arenaKey, m_arenaGeneration);
+	if ((pArena == NULL) ||
+		(pArena->m_cachedSize + classSize > ARENA_MAX_CACHED_SIZE))
+	{
+		freeRaw(pBlock, classSize);
+		return;
+	}
+
+	pArena->m_freeBlocks[sizeClass].push_back(pBlock);
+	pArena->m_cachedSize += classSize;
 #endif
+}
+
+char *Memory::allocateBuffer(off_t length)
+{
+	return static_cast<char*>(allocateBlock((size_t)length));
+}
+
+void Memory::freeBuffer(char *pBuffer, off_t length)
+{
+	freeBlock(static_cast<void*>(pBuffer), (size_t)length);
+}
+
+void Memory::releaseArena(void)
+{
+#ifdef ENABLE_MEMPOOL
+	pthread_once(&m_arenaKeyOnce, Memory::createArenaKey);
+
+	ThreadArena *pArena = getArena(m_arenaKey, m_arenaGeneration);
+	if (pArena != NULL)
+	{
+		pArena->release(ARENA_RETAINED_SIZE);
+	}
 #endif
 }
 
@@ -104,10 +288,20 @@ int Memory::getUsage(void)
 
 void Memory::reclaim(void)
 {
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-	bool releasedMemory = filter_pool::release_memory();
+#ifdef ENABLE_MEMPOOL
+	unsigned int generation = 0;
+
+	// Other threads will empty their arena next time they use it
+	if (pthread_mutex_lock(&m_arenaMutex) == 0)
+	{
+		generation = ++m_arenaGeneration;
+
+		pthread_mutex_unlock(&m_arenaMutex);
+	}
+	pthread_once(&m_arenaKeyOnce, Memory::createArenaKey);
+	getArena(m_arenaKey, generation);
 #ifdef DEBUG
-	clog << "Memory::reclaim: released allocated memory pool (" << releasedMemory << ")" << endl;
+	clog << "Memory::reclaim: released arena, generation " << generation << endl;
 #endif
 #endif
 
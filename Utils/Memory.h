@@ -20,9 +20,13 @@
 #define _MEMORY_H
 
 #include "config.h"
+#include <sys/types.h>
+#include <pthread.h>
 #include <execinfo.h>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <new>
 #ifdef HAVE_UMEM_H
 #include <umem.h>
 
@@ -151,53 +155,28 @@ class umem_allocator<void>
 #include <ext/malloc_allocator.h>
 #endif
 #endif
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-// This header should be available if poolfwd.hpp is
-#include <boost/pool/pool_alloc.hpp>
-#endif
 
 #include "Visibility.h"
 
-#ifdef HAVE_BOOST_POOL_POOLFWD_HPP
-#ifdef HAVE_UMEM_H
-// Memory pool with umem
-typedef boost::pool_allocator<char,
-	umem_allocator> filter_allocator;
-#else
-// Memory pool with malloc (glibc's or any other implementation)
-typedef boost::pool_allocator<char,
-	boost::default_user_allocator_malloc_free,
-	boost::details::pool::default_mutex, 131072> filter_allocator;
-#endif
-typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
-#else
-#ifdef HAVE_UMEM_H
-// No memory pool, plain umem
-typedef umem_allocator<char> filter_allocator;
-typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
-#else
-#ifdef HAVE_EXT_MALLOC_ALLOCATOR_H
-// No memory pool, plain malloc (glibc's or any other implementation)
-typedef __gnu_cxx::malloc_allocator<char> filter_allocator;
-typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
-#else
-// No memory pool, default STL allocator
-typedef std::allocator<char> filter_allocator;
-typedef std::string dstring;
-#endif
-#endif
-#endif
-
 /// Memory usage related utilities.
 class PINOT_EXPORT Memory
 {
 	public:
+		/// Allocates a block from the calling thread's arena.
+		static void *allocateBlock(size_t size);
+
+		/// Returns a block to the calling thread's arena.
+		static void freeBlock(void *pBlock, size_t size);
+
 		/// Allocates a buffer.
 		static char *allocateBuffer(off_t length);
 
 		/// Frees a buffer.
 		static void freeBuffer(char *pBuffer, off_t length);
 
+		/// Releases most of what the calling thread's arena holds.
+		static void releaseArena(void);
+
 		/// Returns the number of bytes in use.
 		static int getUsage(void);
 
@@ -205,8 +184,134 @@ class PINOT_EXPORT Memory
 		static void reclaim(void);
 
 	protected:
+		static pthread_key_t m_arenaKey;
+		static pthread_once_t m_arenaKeyOnce;
+		static pthread_mutex_t m_arenaMutex;
+		static volatile unsigned int m_arenaGeneration;
+
 		Memory();
 
+		static void createArenaKey(void);
+
+		static void deleteArena(void *pArena);
+
+};
+
+/// An allocator that draws from the calling thread's arena.
+template <typename T>
+class arena_allocator
+{
+	public:
+		typedef T                 value_type;
+		typedef value_type*       pointer;
+		typedef const value_type* const_pointer;
+		typedef value_type&       reference;
+		typedef const value_type& const_reference;
+		typedef typename std::size_t size_type;
+		typedef typename std::ptrdiff_t difference_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef arena_allocator<U> other;
+		};
+
+		arena_allocator()
+		{
+		}
+		template <typename U>
+		arena_allocator(const arena_allocator<U> &)
+		{
+		}
+		~arena_allocator()
+		{
+		}
+
+		static pointer address(reference x)
+		{
+			return &x;
+		}
+
+		static const_pointer address(const_reference x)
+		{
+			return &x;
+		}
+
+		static size_type max_size()
+		{
+			return (std::numeric_limits<size_type>::max)() / sizeof(T);
+		}
+
+		static void construct(pointer p, const value_type &t)
+		{
+			new(p) T(t);
+		}
+
+		static void destroy(pointer p)
+		{
+			p->~T();
+			// Avoid unused variable warning
+			(void)p;
+		}
+
+		bool operator==(const arena_allocator &) const
+		{
+			return true;
+		}
+
+		bool operator!=(const arena_allocator &) const
+		{
+			return false;
+		}
+
+		static pointer allocate(size_type n)
+		{
+			void *ret = Memory::allocateBlock(n * sizeof(T));
+			if (ret == NULL)
+			{
+				throw std::bad_alloc();
+			}
+			return static_cast<pointer>(ret);
+		}
+
+		static pointer allocate(const size_type n, const void *const)
+		{
+			return allocate(n);
+		}
+
+		static void deallocate(pointer p, size_type n)
+		{
+			if ((p == NULL) ||
+				(n == 0))
+			{
+				return;
+			}
+
+			Memory::freeBlock(static_cast<void*>(p), n * sizeof(T));
+		}
+
 };
 
+#ifdef ENABLE_MEMPOOL
+// Memory pool, blocks are recycled by each thread without locking
+typedef arena_allocator<char> filter_allocator;
+typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
+#else
+#ifdef HAVE_UMEM_H
+// No memory pool, plain umem
+typedef umem_allocator<char> filter_allocator;
+typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
+#else
+#ifdef HAVE_EXT_MALLOC_ALLOCATOR_H
+// No memory pool, plain malloc (glibc's or any other implementation)
+typedef __gnu_cxx::malloc_allocator<char> filter_allocator;
+typedef std::basic_string<char, std::char_traits<char>, filter_allocator > dstring;
+#else
+// No memory pool, default STL allocator
+typedef std::allocator<char> filter_allocator;
+typedef std::string dstring;
+#endif
+#endif
+#endif
+
 #endif // _MEMORY_H